@@ -0,0 +1,436 @@
+#include "ConcurrentQuadTree.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <new>
+
+namespace {
+
+// Where each thread starts looking for a free epoch slot, so threads that
+// take snapshots often keep landing on different slots
+std::atomic<unsigned> nextReaderHint{0};
+thread_local unsigned readerHint = nextReaderHint.fetch_add(1, std::memory_order_relaxed);
+
+} // namespace
+
+// Snapshot
+ConcurrentQuadTree::Snapshot::Snapshot(const ConcurrentQuadTree& tree)
+    : tree(&tree), slot(tree.pin()), root(tree.root.load()) {}
+
+ConcurrentQuadTree::Snapshot::Snapshot(Snapshot&& other) noexcept
+    : tree(other.tree), slot(other.slot), root(other.root) {
+    other.tree = nullptr;
+}
+
+ConcurrentQuadTree::Snapshot::~Snapshot() {
+    if (!tree) {
+        return;
+    }
+    if (slot >= 0) {
+        tree->slots[slot].epoch.store(0, std::memory_order_release);
+    } else {
+        tree->overflowReaders.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+std::vector<QuadPoint> ConcurrentQuadTree::Snapshot::query(const Rectangle& range) const {
+    std::vector<QuadPoint> result;
+    query(range, result);
+    return result;
+}
+
+void ConcurrentQuadTree::Snapshot::query(const Rectangle& range, std::vector<QuadPoint>& result) const {
+    query(range, [&result](const QuadPoint& point) { result.push_back(point); });
+}
+
+std::size_t ConcurrentQuadTree::Snapshot::count(const Rectangle& range) const {
+    const Node* stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root;
+    std::size_t total = 0;
+
+    while (top > 0) {
+        const Node* node = stack[--top];
+        if (node->total == 0 || !node->boundary.intersects(range)) {
+            continue;
+        }
+
+        // Covered nodes answer from their subtree total
+        if (range.contains(node->boundary)) {
+            total += node->total;
+            continue;
+        }
+
+        const QuadPoint* points = node->points();
+        for (uint32_t i = 0; i < node->count; i++) {
+            if (range.contains(points[i])) {
+                total++;
+            }
+        }
+        if (node->divided()) {
+            for (int i = 0; i < 4; i++) {
+                stack[top++] = node->children[i];
+            }
+        }
+    }
+    return total;
+}
+
+std::size_t ConcurrentQuadTree::Snapshot::size() const {
+    return root->total;
+}
+
+std::vector<QuadPoint> ConcurrentQuadTree::Snapshot::getAllPoints() const {
+    std::vector<QuadPoint> points;
+    points.reserve(root->total);
+    query(root->boundary, [&points](const QuadPoint& point) { points.push_back(point); });
+    return points;
+}
+
+std::vector<Rectangle> ConcurrentQuadTree::Snapshot::getBoundaries() const {
+    // Pre-order with NW first, matching QuadTree::getBoundaries()
+    std::vector<Rectangle> boundaries;
+    const Node* stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root;
+    while (top > 0) {
+        const Node* node = stack[--top];
+        boundaries.push_back(node->boundary);
+        if (node->divided()) {
+            for (int i = 3; i >= 0; i--) {
+                stack[top++] = node->children[i];
+            }
+        }
+    }
+    return boundaries;
+}
+
+uint64_t ConcurrentQuadTree::Snapshot::version() const {
+    return root->version;
+}
+
+// ConcurrentQuadTree constructor
+ConcurrentQuadTree::ConcurrentQuadTree(const Rectangle& boundary, uint32_t maxDepth, float minCellSize)
+    : boundary(boundary), maxDepth(std::min(maxDepth, MAX_DEPTH)), root(nullptr), epoch(1),
+      overflowReaders(0), writing(0) {
+    int depth = static_cast<int>(this->maxDepth);
+    minSplitWidth = std::max(std::ldexp(boundary.width, 1 - depth), 2.0f * minCellSize);
+    minSplitHeight = std::max(std::ldexp(boundary.height, 1 - depth), 2.0f * minCellSize);
+    root.store(allocate(boundary, 0, CAPACITY));
+}
+
+ConcurrentQuadTree::~ConcurrentQuadTree() {
+    // Retired nodes are no longer in the tree, so each is freed once
+    for (const Retired& entry : retired) {
+        release(entry.node);
+    }
+    std::vector<const Node*> stack(1, root.load());
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (node->divided()) {
+            stack.insert(stack.end(), node->children, node->children + 4);
+        }
+        release(node);
+    }
+}
+
+// ConcurrentQuadTree public methods
+bool ConcurrentQuadTree::insert(const QuadPoint& point) {
+    return insert(&point, 1) == 1;
+}
+
+std::size_t ConcurrentQuadTree::insert(const QuadPoint* points, std::size_t count) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    writing++;
+
+    const Node* next = root.load(std::memory_order_relaxed);
+    std::size_t inserted = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        if (boundary.contains(points[i])) {
+            next = insertInto(next, points[i]);
+            inserted++;
+        }
+    }
+
+    if (inserted == 0) {
+        writing--;
+        return 0;
+    }
+    publish(next);
+    return inserted;
+}
+
+std::size_t ConcurrentQuadTree::insert(const std::vector<QuadPoint>& points) {
+    return insert(points.data(), points.size());
+}
+
+bool ConcurrentQuadTree::remove(const QuadPoint& point) {
+    return remove(&point, 1) == 1;
+}
+
+std::size_t ConcurrentQuadTree::remove(const QuadPoint* points, std::size_t count) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    writing++;
+
+    const Node* next = root.load(std::memory_order_relaxed);
+    std::size_t removedCount = 0;
+    for (std::size_t i = 0; i < count; i++) {
+        bool removed = false;
+        if (boundary.contains(points[i])) {
+            next = removeFrom(next, points[i], removed);
+        }
+        removedCount += removed ? 1 : 0;
+    }
+
+    if (removedCount == 0) {
+        writing--;
+        return 0;
+    }
+    publish(next);
+    return removedCount;
+}
+
+void ConcurrentQuadTree::clear() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    writing++;
+    discardSubtree(root.load(std::memory_order_relaxed));
+    publish(allocate(boundary, 0, CAPACITY));
+}
+
+ConcurrentQuadTree::Snapshot ConcurrentQuadTree::snapshot() const {
+    return Snapshot(*this);
+}
+
+std::vector<QuadPoint> ConcurrentQuadTree::query(const Rectangle& range) const {
+    return snapshot().query(range);
+}
+
+std::size_t ConcurrentQuadTree::count(const Rectangle& range) const {
+    return snapshot().count(range);
+}
+
+std::size_t ConcurrentQuadTree::size() const {
+    return snapshot().size();
+}
+
+void ConcurrentQuadTree::reclaim() {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    reclaimLocked();
+}
+
+std::size_t ConcurrentQuadTree::retiredCount() const {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return retired.size();
+}
+
+// Writer helpers
+ConcurrentQuadTree::Node* ConcurrentQuadTree::allocate(const Rectangle& boundary, uint32_t depth,
+                                                       uint32_t capacity) {
+    void* memory = ::operator new(sizeof(Node) + capacity * sizeof(QuadPoint));
+    return new (memory) Node{boundary, {nullptr, nullptr, nullptr, nullptr}, writing, 0, capacity, 0, depth};
+}
+
+void ConcurrentQuadTree::release(const Node* node) {
+    ::operator delete(const_cast<Node*>(node));
+}
+
+ConcurrentQuadTree::Node* ConcurrentQuadTree::own(const Node* node, uint32_t capacity) {
+    if (node->version == writing && node->capacity >= capacity) {
+        return const_cast<Node*>(node);
+    }
+
+    // Overflow leaves grow by doubling, as in QuadTree
+    uint32_t room = node->divided() ? 0 : std::max<uint32_t>(CAPACITY, node->capacity);
+    while (room < capacity) {
+        room *= 2;
+    }
+    Node* copy = allocate(node->boundary, node->depth, room);
+    std::copy(node->children, node->children + 4, copy->children);
+    std::copy(node->points(), node->points() + node->count, copy->points());
+    copy->count = node->count;
+    copy->total = node->total;
+    discard(node);
+    return copy;
+}
+
+void ConcurrentQuadTree::discard(const Node* node) {
+    if (node->version == writing) {
+        release(node);
+    } else {
+        unlinked.push_back(node);
+    }
+}
+
+void ConcurrentQuadTree::discardSubtree(const Node* node) {
+    if (node->divided()) {
+        for (int i = 0; i < 4; i++) {
+            discardSubtree(node->children[i]);
+        }
+    }
+    discard(node);
+}
+
+void ConcurrentQuadTree::collect(const Node* node, std::vector<QuadPoint>& points) {
+    points.insert(points.end(), node->points(), node->points() + node->count);
+    if (node->divided()) {
+        for (int i = 0; i < 4; i++) {
+            collect(node->children[i], points);
+        }
+    }
+}
+
+bool ConcurrentQuadTree::canSplit(const Node& node) const {
+    const Rectangle& b = node.boundary;
+    return b.width >= minSplitWidth && b.height >= minSplitHeight &&
+           b.x + b.width / 2.0f > b.x && b.y + b.height / 2.0f > b.y;
+}
+
+uint32_t ConcurrentQuadTree::quadrant(const Node& node, const QuadPoint& point) {
+    // Compare against the children's own edges, as QuadTree::childFor does
+    uint32_t east = point.x >= node.children[1]->boundary.x ? 1 : 0;
+    uint32_t south = point.y >= node.children[2]->boundary.y ? 2 : 0;
+    return east + south;
+}
+
+ConcurrentQuadTree::Node* ConcurrentQuadTree::insertInto(const Node* node, const QuadPoint& point) {
+    if (node->divided()) {
+        Node* copy = own(node, 0);
+        uint32_t q = quadrant(*copy, point);
+        copy->children[q] = insertInto(copy->children[q], point);
+        copy->total++;
+        return copy;
+    }
+
+    // Room left, or a leaf that may not split: add the point here
+    if (node->count < CAPACITY || !canSplit(*node)) {
+        Node* copy = own(node, node->count + 1);
+        copy->points()[copy->count++] = point;
+        copy->total++;
+        return copy;
+    }
+
+    // Full leaf: split it and keep descending through the new node
+    return insertInto(subdivide(node), point);
+}
+
+const ConcurrentQuadTree::Node* ConcurrentQuadTree::removeFrom(const Node* node, const QuadPoint& point,
+                                                               bool& removed) {
+    if (!node->divided()) {
+        const QuadPoint* points = node->points();
+        uint32_t slot = 0;
+        while (slot < node->count && !(points[slot] == point)) {
+            slot++;
+        }
+        if (slot == node->count) {
+            return node;
+        }
+
+        Node* copy = own(node, node->count);
+        copy->points()[slot] = copy->points()[copy->count - 1];
+        copy->count--;
+        copy->total--;
+        removed = true;
+        return copy;
+    }
+
+    // A subtree about to drop to the merge threshold becomes one leaf
+    if (node->total <= MERGE_THRESHOLD + 1) {
+        std::vector<QuadPoint> rest;
+        collect(node, rest);
+        auto found = std::find(rest.begin(), rest.end(), point);
+        if (found == rest.end()) {
+            return node;
+        }
+        rest.erase(found);
+
+        Node* leaf = allocate(node->boundary, node->depth, CAPACITY);
+        std::copy(rest.begin(), rest.end(), leaf->points());
+        leaf->count = leaf->total = static_cast<uint32_t>(rest.size());
+        discardSubtree(node);
+        removed = true;
+        return leaf;
+    }
+
+    uint32_t q = quadrant(*node, point);
+    const Node* child = removeFrom(node->children[q], point, removed);
+    if (!removed) {
+        return node;
+    }
+    Node* copy = own(node, 0);
+    copy->children[q] = child;
+    copy->total--;
+    return copy;
+}
+
+ConcurrentQuadTree::Node* ConcurrentQuadTree::subdivide(const Node* leaf) {
+    const Rectangle& b = leaf->boundary;
+    float w = b.width / 2.0f;
+    float h = b.height / 2.0f;
+    const Rectangle quadrants[4] = {
+        Rectangle(b.x, b.y, w, h), Rectangle(b.x + w, b.y, w, h),
+        Rectangle(b.x, b.y + h, w, h), Rectangle(b.x + w, b.y + h, w, h)};
+
+    Node* node = allocate(b, leaf->depth, 0);
+    Node* children[4];
+    for (int i = 0; i < 4; i++) {
+        children[i] = allocate(quadrants[i], leaf->depth + 1, CAPACITY);
+        node->children[i] = children[i];
+    }
+
+    // A splittable leaf holds at most CAPACITY points, so any child has room
+    for (uint32_t i = 0; i < leaf->count; i++) {
+        Node* child = children[quadrant(*node, leaf->points()[i])];
+        child->points()[child->count++] = leaf->points()[i];
+        child->total++;
+    }
+    node->total = leaf->total;
+    discard(leaf);
+    return node;
+}
+
+void ConcurrentQuadTree::publish(const Node* next) {
+    // Readers that start after the epoch moves on load the new root, so
+    // only snapshots from this epoch or earlier can reach what it replaced
+    root.store(next);
+    uint64_t published = epoch.fetch_add(1);
+    for (const Node* node : unlinked) {
+        retired.push_back(Retired{published, node});
+    }
+    unlinked.clear();
+    reclaimLocked();
+}
+
+void ConcurrentQuadTree::reclaimLocked() {
+    if (retired.empty() || overflowReaders.load() != 0) {
+        return;
+    }
+
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const Slot& slot : slots) {
+        uint64_t pinned = slot.epoch.load();
+        if (pinned != 0) {
+            oldest = std::min(oldest, pinned);
+        }
+    }
+    while (!retired.empty() && retired.front().epoch < oldest) {
+        release(retired.front().node);
+        retired.pop_front();
+    }
+}
+
+int ConcurrentQuadTree::pin() const {
+    // The slot must hold our epoch before the root is loaded: a writer
+    // that misses it has already advanced the epoch past the root we load
+    uint64_t current = epoch.load();
+    for (int i = 0; i < MAX_READERS; i++) {
+        int slot = static_cast<int>((readerHint + i) % MAX_READERS);
+        uint64_t expected = 0;
+        if (slots[slot].epoch.load(std::memory_order_relaxed) == 0 &&
+            slots[slot].epoch.compare_exchange_strong(expected, current)) {
+            return slot;
+        }
+    }
+    overflowReaders.fetch_add(1);
+    return -1;
+}
@@ -0,0 +1,286 @@
+#ifndef CONCURRENT_QUADTREE_H
+#define CONCURRENT_QUADTREE_H
+
+#include "Point.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+// A quadtree that readers can query while a writer modifies it.
+//
+// Nodes are immutable once published. A write copies the nodes on the path
+// from the root to the leaf it changes (path copying), shares every other
+// subtree with the previous version, and publishes the new root with one
+// atomic store. Readers pin the current root in a Snapshot and walk it
+// without locks; they never wait for a writer and never see a half-applied
+// write. Writers are serialized by a mutex among themselves.
+//
+// Nodes replaced by a write are reclaimed by epochs: each snapshot records
+// the epoch it started in, each write retires the nodes it unlinked under
+// the epoch it was published in, and a retired node is freed once every
+// snapshot that could still reach it has been released.
+//
+// Splits, depth limits and overflow leaves follow QuadTree's rules.
+class ConcurrentQuadTree {
+    struct Node;
+
+public:
+    static const int CAPACITY = 4;
+    static constexpr uint32_t DEFAULT_MAX_DEPTH = 24;
+
+    // Snapshots held at once with their own epoch slot. Beyond this they
+    // still work, but reclamation pauses until they are released.
+    static constexpr int MAX_READERS = 64;
+
+    // A pinned, immutable version of the tree. Nodes it can reach are not
+    // freed while it is alive, so hold it for one query or one frame, not
+    // indefinitely. Not shared between threads; take one per thread.
+    class Snapshot {
+    public:
+        Snapshot(Snapshot&& other) noexcept;
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+        Snapshot& operator=(Snapshot&&) = delete;
+        ~Snapshot();
+
+        // Query points within a rectangular range
+        std::vector<QuadPoint> query(const Rectangle& range) const;
+
+        // Append points within range to a caller-owned buffer (not cleared first)
+        void query(const Rectangle& range, std::vector<QuadPoint>& result) const;
+
+        // Call visitor(const QuadPoint&) for every point within range. A
+        // visitor returning bool can return false to stop early; the result
+        // is false if the walk was stopped.
+        template <typename Visitor>
+        bool query(const Rectangle& range, Visitor&& visitor) const;
+
+        // Count points within range; covered nodes use their subtree totals
+        std::size_t count(const Rectangle& range) const;
+
+        // Total number of points in this version
+        std::size_t size() const;
+
+        // Get all points in this version
+        std::vector<QuadPoint> getAllPoints() const;
+
+        // Get all subdivision boundaries for visualization
+        std::vector<Rectangle> getBoundaries() const;
+
+        // Number of writes this version includes
+        uint64_t version() const;
+
+    private:
+        friend class ConcurrentQuadTree;
+
+        explicit Snapshot(const ConcurrentQuadTree& tree);
+
+        const ConcurrentQuadTree* tree;
+        int slot;           // Epoch slot held, or -1 for the shared overflow count
+        const Node* root;
+    };
+
+    ConcurrentQuadTree(const Rectangle& boundary, uint32_t maxDepth = DEFAULT_MAX_DEPTH,
+                       float minCellSize = 0.0f);
+
+    // No snapshot may outlive the tree
+    ~ConcurrentQuadTree();
+
+    ConcurrentQuadTree(const ConcurrentQuadTree&) = delete;
+    ConcurrentQuadTree& operator=(const ConcurrentQuadTree&) = delete;
+
+    // Insert a point and publish the result. Returns false if the point is
+    // outside the bounds.
+    bool insert(const QuadPoint& point);
+
+    // Insert several points and publish them as one version. Nodes created
+    // by the batch are updated in place until it is published, so a batch
+    // copies each path once rather than once per point. Returns the number
+    // of points inside the bounds.
+    std::size_t insert(const QuadPoint* points, std::size_t count);
+    std::size_t insert(const std::vector<QuadPoint>& points);
+
+    // Remove one point equal to the given one. Quadrants left underfull are
+    // merged back into their parent. Returns false if there is no such point.
+    bool remove(const QuadPoint& point);
+
+    // Remove one point equal to each given one and publish the result as
+    // one version. Returns the number of points found and removed.
+    std::size_t remove(const QuadPoint* points, std::size_t count);
+
+    // Publish an empty tree
+    void clear();
+
+    // Pin the current version for lock-free reads
+    Snapshot snapshot() const;
+
+    // One-off reads, each on a snapshot of its own
+    std::vector<QuadPoint> query(const Rectangle& range) const;
+    template <typename Visitor>
+    bool query(const Rectangle& range, Visitor&& visitor) const;
+    std::size_t count(const Rectangle& range) const;
+    std::size_t size() const;
+
+    // Get the root boundary
+    Rectangle getBoundary() const { return boundary; }
+
+    // Free retired nodes that no snapshot can reach any more. Writes do
+    // this themselves; call it after readers finish if no more writes come.
+    void reclaim();
+
+    // Retired nodes still waiting for snapshots to be released
+    std::size_t retiredCount() const;
+
+private:
+    // Traversals hold at most 3 entries per level plus the root
+    static constexpr int MAX_STACK = 512;
+    static constexpr uint32_t MAX_DEPTH = (MAX_STACK - 1) / 3;
+
+    // Same merge rule as QuadTree
+    static constexpr uint32_t MERGE_THRESHOLD = CAPACITY / 2;
+
+    // A node and, for leaves, its points in a trailing array of capacity
+    // entries, allocated together. Children are NW, NE, SW, SE.
+    struct Node {
+        Rectangle boundary;
+        const Node* children[4];  // All null while this is a leaf
+        uint64_t version;         // Write that created the node
+        uint32_t count;           // Points stored in this leaf
+        uint32_t capacity;        // Room in the point array
+        uint32_t total;           // Points in the whole subtree
+        uint32_t depth;
+
+        QuadPoint* points() { return reinterpret_cast<QuadPoint*>(this + 1); }
+        const QuadPoint* points() const { return reinterpret_cast<const QuadPoint*>(this + 1); }
+        bool divided() const { return children[0] != nullptr; }
+    };
+
+    struct Retired {
+        uint64_t epoch;  // Epoch the node was unlinked in
+        const Node* node;
+    };
+
+    // One cache line per reader slot so snapshots on different threads do
+    // not contend; 0 means free, otherwise the epoch the holder started in
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    Rectangle boundary;
+    uint32_t maxDepth;
+    float minSplitWidth;   // Narrowest node that may still split
+    float minSplitHeight;
+
+    // Reader side: all a snapshot touches
+    std::atomic<const Node*> root;
+    std::atomic<uint64_t> epoch;
+    mutable Slot slots[MAX_READERS];
+    mutable std::atomic<uint32_t> overflowReaders;
+
+    // Writer side, guarded by writeMutex
+    mutable std::mutex writeMutex;
+    uint64_t writing;                   // Version being built
+    std::vector<const Node*> unlinked;  // Nodes replaced by the write in progress
+    std::deque<Retired> retired;        // Oldest epoch first
+
+    // Call a visitor with a point and report whether the walk should continue
+    template <typename Visitor>
+    static bool visit(Visitor& visitor, const QuadPoint& point);
+
+    Node* allocate(const Rectangle& boundary, uint32_t depth, uint32_t capacity);
+    static void release(const Node* node);
+
+    // A writable copy of a node with room for capacity points. Nodes made by
+    // the write in progress are returned as they are when they have room.
+    Node* own(const Node* node, uint32_t capacity);
+
+    // Drop a node from the next version: freed now if it was never
+    // published, otherwise retired
+    void discard(const Node* node);
+    void discardSubtree(const Node* node);
+
+    // Append every point below a node
+    static void collect(const Node* node, std::vector<QuadPoint>& points);
+
+    bool canSplit(const Node& node) const;
+    static uint32_t quadrant(const Node& node, const QuadPoint& point);
+
+    // Path-copying insert and remove below a node; return the replacement
+    Node* insertInto(const Node* node, const QuadPoint& point);
+    const Node* removeFrom(const Node* node, const QuadPoint& point, bool& removed);
+
+    // Replace a full leaf with a divided node holding its points in children
+    Node* subdivide(const Node* leaf);
+
+    // Make the write in progress the current version and retire what it replaced
+    void publish(const Node* next);
+
+    // Free retired nodes older than every live snapshot; writeMutex held
+    void reclaimLocked();
+
+    // Claim an epoch slot for a new snapshot
+    int pin() const;
+};
+
+template <typename Visitor>
+bool ConcurrentQuadTree::visit(Visitor& visitor, const QuadPoint& point) {
+    if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const QuadPoint&>, void>) {
+        visitor(point);
+        return true;
+    } else {
+        return visitor(point);
+    }
+}
+
+template <typename Visitor>
+bool ConcurrentQuadTree::Snapshot::query(const Rectangle& range, Visitor&& visitor) const {
+    // Nodes inside the range are pushed with inside set, so their points
+    // are emitted without testing them
+    struct Entry {
+        const Node* node;
+        bool inside;
+    };
+    Entry stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = Entry{root, false};
+
+    while (top > 0) {
+        Entry entry = stack[--top];
+        const Node* node = entry.node;
+        bool inside = entry.inside;
+
+        if (!inside) {
+            if (node->total == 0 || !node->boundary.intersects(range)) {
+                continue;
+            }
+            inside = range.contains(node->boundary);
+        }
+
+        const QuadPoint* points = node->points();
+        for (uint32_t i = 0; i < node->count; i++) {
+            if ((inside || range.contains(points[i])) && !visit(visitor, points[i])) {
+                return false;
+            }
+        }
+
+        if (node->divided()) {
+            for (int i = 3; i >= 0; i--) {
+                if (node->children[i]->total != 0) {
+                    stack[top++] = Entry{node->children[i], inside};
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Visitor>
+bool ConcurrentQuadTree::query(const Rectangle& range, Visitor&& visitor) const {
+    return snapshot().query(range, visitor);
+}
+
+#endif // CONCURRENT_QUADTREE_H
@@ -0,0 +1,353 @@
+#include "LinearQuadTree.h"
+#include <algorithm>
+
+// LinearQuadTree constructor
+LinearQuadTree::LinearQuadTree(const Rectangle& boundary, uint32_t maxDepth, Storage storage)
+    : boundary(boundary), maxDepth(std::min(maxDepth, 32u)), storage(storage), indexLevel(0) {}
+
+// LinearQuadTree public methods
+bool LinearQuadTree::insert(const QuadPoint& point) {
+    if (!boundary.contains(point)) {
+        return false;
+    }
+
+    // After any equal keys, so points sharing a cell keep insertion order
+    uint64_t key = keyFor(point);
+    std::size_t at = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+    keys.insert(keys.begin() + at, key);
+    if (storage == STORAGE_FLOAT) {
+        xs.insert(xs.begin() + at, point.x);
+        ys.insert(ys.begin() + at, point.y);
+    }
+
+    // Runs of every later index cell start one point further on; the index
+    // is rebuilt one level deeper each time the tree outgrows it
+    if (indexLevel < MAX_INDEX_LEVEL &&
+        (static_cast<std::size_t>(CAPACITY) << (2 * indexLevel)) < keys.size()) {
+        rebuildIndex();
+    } else if (indexLevel > 0) {
+        std::size_t cell = static_cast<std::size_t>(key >> (64 - 2 * indexLevel));
+        for (std::size_t c = cell + 1; c < runStart.size(); c++) {
+            runStart[c]++;
+        }
+    }
+    return true;
+}
+
+std::size_t LinearQuadTree::build(const QuadPoint* points, std::size_t count) {
+    clear();
+
+    std::vector<Keyed> work = sortedByKey(points, count);
+    keys.resize(work.size());
+    for (std::size_t i = 0; i < work.size(); i++) {
+        keys[i] = work[i].key;
+    }
+    if (storage == STORAGE_FLOAT) {
+        xs.resize(work.size());
+        ys.resize(work.size());
+        for (std::size_t i = 0; i < work.size(); i++) {
+            xs[i] = work[i].x;
+            ys[i] = work[i].y;
+        }
+    }
+    keys.shrink_to_fit();
+    xs.shrink_to_fit();
+    ys.shrink_to_fit();
+    rebuildIndex();
+    return work.size();
+}
+
+std::size_t LinearQuadTree::build(const std::vector<QuadPoint>& points) {
+    return build(points.data(), points.size());
+}
+
+std::size_t LinearQuadTree::insertBatch(const QuadPoint* points, std::size_t count) {
+    std::vector<Keyed> batch = sortedByKey(points, count);
+    if (batch.empty()) {
+        return 0;
+    }
+
+    // Merge from the back into the grown arrays, each stored point moving
+    // at most once. A stored point goes before a batch point with the same
+    // key, as if the batch had been inserted after it.
+    std::size_t stored = keys.size();
+    std::size_t i = stored, j = batch.size(), k = stored + batch.size();
+    bool coordinates = storage == STORAGE_FLOAT;
+    keys.resize(k);
+    if (coordinates) {
+        xs.resize(k);
+        ys.resize(k);
+    }
+    while (j > 0) {
+        k--;
+        if (i > 0 && keys[i - 1] > batch[j - 1].key) {
+            i--;
+            keys[k] = keys[i];
+            if (coordinates) {
+                xs[k] = xs[i];
+                ys[k] = ys[i];
+            }
+        } else {
+            j--;
+            keys[k] = batch[j].key;
+            if (coordinates) {
+                xs[k] = batch[j].x;
+                ys[k] = batch[j].y;
+            }
+        }
+    }
+    rebuildIndex();
+    return batch.size();
+}
+
+std::size_t LinearQuadTree::insertBatch(const std::vector<QuadPoint>& points) {
+    return insertBatch(points.data(), points.size());
+}
+
+std::vector<QuadPoint> LinearQuadTree::query(const Rectangle& range) const {
+    std::vector<QuadPoint> result;
+    query(range, result);
+    return result;
+}
+
+void LinearQuadTree::query(const Rectangle& range, std::vector<QuadPoint>& result) const {
+    query(range, [&result](const QuadPoint& point) { result.push_back(point); });
+}
+
+std::size_t LinearQuadTree::count(const Rectangle& range) const {
+    Cell stack[MAX_STACK];
+    uint32_t hits[FILTER_CHUNK];
+    float bufferX[FILTER_CHUNK], bufferY[FILTER_CHUNK];
+    int top = 0;
+    stack[top++] = root();
+    std::size_t total = 0;
+
+    while (top > 0) {
+        Cell cell = stack[--top];
+        if (cell.begin == cell.end || !cell.boundary.intersects(range)) {
+            continue;
+        }
+
+        // Covered cells answer with their run length
+        if (range.contains(cell.boundary)) {
+            total += cell.end - cell.begin;
+            continue;
+        }
+
+        if (!isLeaf(cell)) {
+            Cell children[4];
+            split(cell, children);
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = children[q];
+            }
+            continue;
+        }
+
+        if (cell.end - cell.begin < FILTER_MIN) {
+            for (uint32_t i = cell.begin; i < cell.end; i++) {
+                if (range.contains(pointAt(i))) {
+                    total++;
+                }
+            }
+            continue;
+        }
+        for (uint32_t begin = cell.begin; begin < cell.end; begin += FILTER_CHUNK) {
+            uint32_t chunk = std::min(cell.end - begin, FILTER_CHUNK);
+            const float* x;
+            const float* y;
+            coordinates(begin, chunk, bufferX, bufferY, x, y);
+            total += RangeFilter::filter(x, y, chunk, range, hits);
+        }
+    }
+    return total;
+}
+
+std::vector<QuadPoint> LinearQuadTree::getAllPoints() const {
+    std::vector<QuadPoint> points;
+    points.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); i++) {
+        points.push_back(pointAt(static_cast<uint32_t>(i)));
+    }
+    return points;
+}
+
+std::vector<Rectangle> LinearQuadTree::getBoundaries() const {
+    std::vector<Rectangle> boundaries;
+    Cell stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root();
+
+    // Pre-order with NW first, the order QuadTree's recursion uses
+    while (top > 0) {
+        Cell cell = stack[--top];
+        boundaries.push_back(cell.boundary);
+        if (!isLeaf(cell)) {
+            Cell children[4];
+            split(cell, children);
+            for (int q = 3; q >= 0; q--) {
+                stack[top++] = children[q];
+            }
+        }
+    }
+    return boundaries;
+}
+
+Rectangle LinearQuadTree::leafBoundary(const QuadPoint& point) const {
+    if (!boundary.contains(point)) {
+        return boundary;
+    }
+
+    // Follow the point's own key, which is what placed it in its run
+    uint64_t key = keyFor(point);
+    Cell cell = root();
+    while (!isLeaf(cell)) {
+        Cell children[4];
+        split(cell, children);
+        cell = children[(key >> (64 - 2 * (cell.level + 1))) & 3];
+    }
+    return cell.boundary;
+}
+
+void LinearQuadTree::clear() {
+    keys.clear();
+    xs.clear();
+    ys.clear();
+    runStart.clear();
+    indexLevel = 0;
+}
+
+std::size_t LinearQuadTree::nodeCount() const {
+    Cell stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root();
+    std::size_t cells = 0;
+
+    while (top > 0) {
+        Cell cell = stack[--top];
+        cells++;
+        if (!isLeaf(cell)) {
+            Cell children[4];
+            split(cell, children);
+            for (int q = 0; q < 4; q++) {
+                stack[top++] = children[q];
+            }
+        }
+    }
+    return cells;
+}
+
+std::size_t LinearQuadTree::memoryUsage() const {
+    return keys.capacity() * sizeof(uint64_t) + (xs.capacity() + ys.capacity()) * sizeof(float) +
+           runStart.capacity() * sizeof(uint32_t);
+}
+
+// Key helpers
+uint64_t LinearQuadTree::keyFor(const QuadPoint& point) const {
+    // Divide in double so a point exactly on a split line lands on the same
+    // side as QuadTree's float comparisons against its halved boundaries
+    const double grid = 4294967296.0;
+    double gx = (static_cast<double>(point.x) - boundary.x) / boundary.width * grid;
+    double gy = (static_cast<double>(point.y) - boundary.y) / boundary.height * grid;
+    uint32_t qx = gx >= grid - 1 ? 0xFFFFFFFFu : static_cast<uint32_t>(std::max(gx, 0.0));
+    uint32_t qy = gy >= grid - 1 ? 0xFFFFFFFFu : static_cast<uint32_t>(std::max(gy, 0.0));
+
+    // x in the even bits and y in the odd ones, so the two bits of each
+    // level read east + 2 * south: the NW, NE, SW, SE child order
+    return spread(qx) | (spread(qy) << 1);
+}
+
+uint64_t LinearQuadTree::spread(uint32_t v) {
+    uint64_t x = v;
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFull;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFull;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0Full;
+    x = (x | (x << 2)) & 0x3333333333333333ull;
+    x = (x | (x << 1)) & 0x5555555555555555ull;
+    return x;
+}
+
+void LinearQuadTree::coordinates(uint32_t begin, uint32_t length, float* bufferX, float* bufferY,
+                                 const float*& x, const float*& y) const {
+    if (storage == STORAGE_FLOAT) {
+        x = xs.data() + begin;
+        y = ys.data() + begin;
+        return;
+    }
+    for (uint32_t i = 0; i < length; i++) {
+        QuadPoint point = decode(keys[begin + i]);
+        bufferX[i] = point.x;
+        bufferY[i] = point.y;
+    }
+    x = bufferX;
+    y = bufferY;
+}
+
+LinearQuadTree::Cell LinearQuadTree::root() const {
+    return Cell{boundary, 0, 0, 0, static_cast<uint32_t>(keys.size())};
+}
+
+void LinearQuadTree::split(const Cell& cell, Cell children[4]) const {
+    // Child boundaries are halved exactly as QuadTree::createChildren does
+    float x = cell.boundary.x;
+    float y = cell.boundary.y;
+    float w = cell.boundary.width / 2.0f;
+    float h = cell.boundary.height / 2.0f;
+    const Rectangle rects[4] = {Rectangle(x, y, w, h), Rectangle(x + w, y, w, h),
+                                Rectangle(x, y + h, w, h), Rectangle(x + w, y + h, w, h)};
+
+    uint32_t level = cell.level + 1;
+    uint64_t step = 1ull << (64 - 2 * level);
+    uint32_t bounds[5] = {cell.begin, 0, 0, 0, cell.end};
+    for (uint32_t q = 1; q < 4; q++) {
+        bounds[q] = lowerBound(cell.key + q * step, level, bounds[q - 1], cell.end);
+    }
+    for (uint32_t q = 0; q < 4; q++) {
+        children[q] = Cell{rects[q], cell.key + q * step, level, bounds[q], bounds[q + 1]};
+    }
+}
+
+std::vector<LinearQuadTree::Keyed> LinearQuadTree::sortedByKey(const QuadPoint* points, std::size_t count) const {
+    std::vector<Keyed> work;
+    work.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        if (boundary.contains(points[i])) {
+            work.push_back(Keyed{keyFor(points[i]), points[i].x, points[i].y});
+        }
+    }
+    std::stable_sort(work.begin(), work.end(), [](const Keyed& a, const Keyed& b) { return a.key < b.key; });
+    return work;
+}
+
+uint32_t LinearQuadTree::lowerBound(uint64_t key, uint32_t level, uint32_t begin, uint32_t end) const {
+    // Cells down to the index level start at a recorded run boundary
+    if (level <= indexLevel) {
+        return runStart[static_cast<std::size_t>(key >> (64 - 2 * indexLevel))];
+    }
+    return static_cast<uint32_t>(std::lower_bound(keys.begin() + begin, keys.begin() + end, key) -
+                                 keys.begin());
+}
+
+void LinearQuadTree::rebuildIndex() {
+    // About one index cell per CAPACITY points, capped at MAX_INDEX_LEVEL
+    indexLevel = 0;
+    while (indexLevel < MAX_INDEX_LEVEL &&
+           (static_cast<std::size_t>(CAPACITY) << (2 * indexLevel)) < keys.size()) {
+        indexLevel++;
+    }
+    if (indexLevel == 0) {
+        runStart.clear();
+        return;
+    }
+
+    std::size_t cells = static_cast<std::size_t>(1) << (2 * indexLevel);
+    uint32_t shift = 64 - 2 * indexLevel;
+    runStart.assign(cells + 1, 0);
+    std::size_t i = 0;
+    for (std::size_t c = 0; c < cells; c++) {
+        while (i < keys.size() && (keys[i] >> shift) < c) {
+            i++;
+        }
+        runStart[c] = static_cast<uint32_t>(i);
+    }
+    runStart[cells] = static_cast<uint32_t>(keys.size());
+}
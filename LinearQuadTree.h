@@ -0,0 +1,325 @@
+#ifndef LINEAR_QUADTREE_H
+#define LINEAR_QUADTREE_H
+
+#include "Point.h"
+#include "RangeFilter.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+
+// A pointerless quadtree over points kept sorted by 64-bit Morton key.
+//
+// Every point's coordinates are scaled to a 2^32 grid over the root and
+// their bits interleaved, so each quadtree cell is one contiguous key range
+// and its points one contiguous run of the sorted arrays. The tree is
+// implicit: a cell holding more than CAPACITY points is divided, exactly
+// like QuadTree, but no nodes are stored. Child runs are found by binary
+// search, or for the top levels by a table of run starts, and a cell
+// inside a query range is emitted with one sequential scan.
+//
+// Exposes the same insert/query/count/getAllPoints/getBoundaries surface as
+// QuadTree, so either can back the same code. Inserting shifts the arrays
+// and costs O(n); bulk loads should use build().
+//
+// With STORAGE_QUANTIZED only the keys are kept, halving the memory per
+// point; see Storage. The quantized mode is LinearQuadTree's alone:
+// QuadTree always stores float coordinates, ids and per-node bounds, so
+// code that needs the compact layout uses this class.
+class LinearQuadTree {
+public:
+    // Same split rule as QuadTree, so both trees produce the same cells
+    static const int CAPACITY = 4;
+    static constexpr uint32_t DEFAULT_MAX_DEPTH = 24;
+
+    // How points are stored. STORAGE_FLOAT keeps each point's coordinates
+    // beside its key, 16 bytes a point. STORAGE_QUANTIZED keeps the key
+    // alone, 8 bytes a point: the key already names the point's cell of the
+    // 2^32 x 2^32 grid over the root, and the point reads back as the float
+    // nearest that cell's center. That is the point itself wherever floats
+    // are coarser than the grid, which for a root at the origin is all but
+    // the first 1/256 of each axis, and within a grid cell of it elsewhere.
+    // Queries test the points as they read back, so where the two differ a
+    // point on a range's edge can be in the results of one storage and not
+    // the other.
+    enum Storage { STORAGE_FLOAT, STORAGE_QUANTIZED };
+
+    LinearQuadTree(const Rectangle& boundary, uint32_t maxDepth = DEFAULT_MAX_DEPTH,
+                   Storage storage = STORAGE_FLOAT);
+
+    // Insert a point into the tree
+    bool insert(const QuadPoint& point);
+
+    // Replace the contents with the given points, sorted once by key.
+    // Returns the number of points inside the boundary.
+    std::size_t build(const QuadPoint* points, std::size_t count);
+    std::size_t build(const std::vector<QuadPoint>& points);
+
+    // Insert many points at once: the batch is sorted by key and merged
+    // into the arrays in one pass from the back, so it shifts the stored
+    // points once rather than once per point. Points sharing a key keep
+    // insertion order, as with insert(). Returns the number inserted.
+    std::size_t insertBatch(const QuadPoint* points, std::size_t count);
+    std::size_t insertBatch(const std::vector<QuadPoint>& points);
+
+    // Query points within a rectangular range
+    std::vector<QuadPoint> query(const Rectangle& range) const;
+
+    // Append points within range to a caller-owned buffer (not cleared first)
+    void query(const Rectangle& range, std::vector<QuadPoint>& result) const;
+
+    // Call visitor(const QuadPoint&) for every point within range. A visitor
+    // returning bool can return false to stop early; the result is false if
+    // the walk was stopped.
+    template <typename Visitor>
+    bool query(const Rectangle& range, Visitor&& visitor) const;
+
+    // Count points within range; covered cells count their run length
+    std::size_t count(const Rectangle& range) const;
+
+    // Total number of points in the tree
+    std::size_t size() const { return keys.size(); }
+
+    // Get all points in Morton order
+    std::vector<QuadPoint> getAllPoints() const;
+
+    // Get all cell boundaries for visualization, in the same order as
+    // QuadTree::getBoundaries()
+    std::vector<Rectangle> getBoundaries() const;
+
+    // Level-of-detail walk, as QuadTree::queryLevelOfDetail(); a cell's
+    // point count is its run length
+    template <typename CellVisitor, typename PointVisitor, typename AggregateVisitor>
+    void queryLevelOfDetail(const Rectangle& range, float minSize, CellVisitor&& cell, PointVisitor&& point,
+                            AggregateVisitor&& aggregate) const;
+
+    // Boundary of the leaf cell holding point, or the root's if the point
+    // is outside
+    Rectangle leafBoundary(const QuadPoint& point) const;
+
+    // Clear all points, keeping the arrays' capacity
+    void clear();
+
+    // Get the root boundary
+    Rectangle getBoundary() const { return boundary; }
+
+    Storage getStorage() const { return storage; }
+
+    // Number of cells in the implicit tree, found by walking it
+    std::size_t nodeCount() const;
+
+    // Bytes reserved by the point arrays and the run index
+    std::size_t memoryUsage() const;
+
+private:
+    // Traversals hold at most 3 entries per level plus the root
+    static constexpr int MAX_STACK = 3 * 32 + 1;
+
+    // Top levels indexed by a table of run starts; 4^10 cells is 4 MB
+    static constexpr uint32_t MAX_INDEX_LEVEL = 10;
+
+    // Points per range filter call, and the run length below which points
+    // are tested inline, as in QuadTree
+    static constexpr uint32_t FILTER_CHUNK = 64;
+    static constexpr uint32_t FILTER_MIN = 8;
+
+    // A point and its key while a batch is sorted
+    struct Keyed {
+        uint64_t key;
+        float x, y;
+    };
+
+    // Keyed points inside the boundary, sorted by key; stable, so points
+    // sharing a key keep their input order
+    std::vector<Keyed> sortedByKey(const QuadPoint* points, std::size_t count) const;
+
+    // One cell of the implicit tree and its run [begin, end) of points
+    struct Cell {
+        Rectangle boundary;
+        uint64_t key;      // Lowest Morton key in the cell
+        uint32_t level;    // Depth, 0 for the root
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    Rectangle boundary;
+    uint32_t maxDepth;  // At most 32, the grid's resolution
+    Storage storage;
+
+    // Points sorted by key, structure-of-arrays like QuadTree's slabs;
+    // xs and ys stay empty with STORAGE_QUANTIZED
+    std::vector<uint64_t> keys;
+    std::vector<float> xs;
+    std::vector<float> ys;
+
+    // runStart[c] is the first point whose key lies in cell c of level
+    // indexLevel, with one extra entry for the end
+    std::vector<uint32_t> runStart;
+    uint32_t indexLevel;
+
+    // Morton key of a point inside the boundary
+    uint64_t keyFor(const QuadPoint& point) const;
+
+    // Spread the 32 bits of v over the even bits of a 64-bit word, and
+    // gather them back
+    static uint64_t spread(uint32_t v);
+    static uint32_t compact(uint64_t v) {
+        uint64_t x = v & 0x5555555555555555ull;
+        x = (x | (x >> 1)) & 0x3333333333333333ull;
+        x = (x | (x >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | (x >> 4)) & 0x00FF00FF00FF00FFull;
+        x = (x | (x >> 8)) & 0x0000FFFF0000FFFFull;
+        x = (x | (x >> 16)) & 0x00000000FFFFFFFFull;
+        return static_cast<uint32_t>(x);
+    }
+
+    // Point a quantized key reads back as: the center of its grid cell,
+    // which rounds to the point that was keyed wherever floats are coarser
+    // than the grid
+    QuadPoint decode(uint64_t key) const {
+        const double step = 1.0 / 4294967296.0;
+        double x = boundary.x + (compact(key) + 0.5) * step * boundary.width;
+        double y = boundary.y + (compact(key >> 1) + 0.5) * step * boundary.height;
+        return QuadPoint(static_cast<float>(x), static_cast<float>(y));
+    }
+
+    // Point i, stored or decoded
+    QuadPoint pointAt(uint32_t i) const {
+        return storage == STORAGE_FLOAT ? QuadPoint(xs[i], ys[i]) : decode(keys[i]);
+    }
+
+    // Coordinate arrays of points [begin, begin + length) for the range
+    // filter: the stored ones, or the points decoded into bufferX/bufferY
+    void coordinates(uint32_t begin, uint32_t length, float* bufferX, float* bufferY, const float*& x,
+                     const float*& y) const;
+
+    // Root cell covering every point
+    Cell root() const;
+
+    // Whether a cell is stored as one leaf run rather than divided. As in
+    // QuadTree::canSplit(), a cell so small that halving it no longer
+    // moves the split line is a leaf whatever maxDepth allows; away from
+    // the origin that comes well before level 32.
+    bool isLeaf(const Cell& cell) const {
+        const Rectangle& b = cell.boundary;
+        return cell.end - cell.begin <= CAPACITY || cell.level >= maxDepth || !(b.x + b.width / 2.0f > b.x) ||
+               !(b.y + b.height / 2.0f > b.y);
+    }
+
+    // The four children of a divided cell, NW, NE, SW, SE
+    void split(const Cell& cell, Cell children[4]) const;
+
+    // Index of the first point with key >= the start of a cell at level
+    uint32_t lowerBound(uint64_t key, uint32_t level, uint32_t begin, uint32_t end) const;
+
+    // Recompute the run index, choosing its level from the point count
+    void rebuildIndex();
+};
+
+template <typename Visitor>
+bool LinearQuadTree::query(const Rectangle& range, Visitor&& visitor) const {
+    auto visit = [&visitor](const QuadPoint& point) {
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const QuadPoint&>, void>) {
+            visitor(point);
+            return true;
+        } else {
+            return static_cast<bool>(visitor(point));
+        }
+    };
+
+    Cell stack[MAX_STACK];
+    uint32_t hits[FILTER_CHUNK];
+    float bufferX[FILTER_CHUNK], bufferY[FILTER_CHUNK];
+    int top = 0;
+    stack[top++] = root();
+
+    while (top > 0) {
+        Cell cell = stack[--top];
+        if (cell.begin == cell.end || !cell.boundary.intersects(range)) {
+            continue;
+        }
+
+        // A covered cell is one sequential run, whatever lies below it
+        if (range.contains(cell.boundary)) {
+            for (uint32_t i = cell.begin; i < cell.end; i++) {
+                if (!visit(pointAt(i))) {
+                    return false;
+                }
+            }
+            continue;
+        }
+
+        if (!isLeaf(cell)) {
+            Cell children[4];
+            split(cell, children);
+            for (int q = 3; q >= 0; q--) {
+                stack[top++] = children[q];
+            }
+            continue;
+        }
+
+        uint32_t length = cell.end - cell.begin;
+        if (length < FILTER_MIN) {
+            for (uint32_t i = cell.begin; i < cell.end; i++) {
+                QuadPoint point = pointAt(i);
+                if (range.contains(point) && !visit(point)) {
+                    return false;
+                }
+            }
+            continue;
+        }
+        for (uint32_t begin = cell.begin; begin < cell.end; begin += FILTER_CHUNK) {
+            uint32_t chunk = std::min(cell.end - begin, FILTER_CHUNK);
+            const float* x;
+            const float* y;
+            coordinates(begin, chunk, bufferX, bufferY, x, y);
+            uint32_t found = RangeFilter::filter(x, y, chunk, range, hits);
+            for (uint32_t i = 0; i < found; i++) {
+                if (!visit(QuadPoint(x[hits[i]], y[hits[i]]))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <typename CellVisitor, typename PointVisitor, typename AggregateVisitor>
+void LinearQuadTree::queryLevelOfDetail(const Rectangle& range, float minSize, CellVisitor&& cell,
+                                        PointVisitor&& point, AggregateVisitor&& aggregate) const {
+    Cell stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = root();
+
+    while (top > 0) {
+        Cell c = stack[--top];
+        if (!c.boundary.intersects(range)) {
+            continue;
+        }
+        if (std::max(c.boundary.width, c.boundary.height) < minSize) {
+            if (c.end > c.begin) {
+                aggregate(c.boundary, static_cast<std::size_t>(c.end - c.begin));
+            }
+            continue;
+        }
+
+        cell(c.boundary);
+        if (isLeaf(c)) {
+            for (uint32_t i = c.begin; i < c.end; i++) {
+                QuadPoint p = pointAt(i);
+                if (range.contains(p)) {
+                    point(p);
+                }
+            }
+        } else {
+            Cell children[4];
+            split(c, children);
+            for (int q = 3; q >= 0; q--) {
+                stack[top++] = children[q];
+            }
+        }
+    }
+}
+
+#endif // LINEAR_QUADTREE_H
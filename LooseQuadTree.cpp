@@ -0,0 +1,288 @@
+#include "LooseQuadTree.h"
+#include <algorithm>
+
+// LooseQuadTree constructor
+LooseQuadTree::LooseQuadTree(const Rectangle& boundary, float looseness, uint32_t maxDepth)
+    : looseness(std::max(looseness, 1.0f)), maxDepth(std::min(maxDepth, MAX_DEPTH)) {
+    nodes.push_back(makeNode(boundary, NONE, 0));
+}
+
+// LooseQuadTree public methods
+bool LooseQuadTree::insert(const Rectangle& box) {
+    return insert(box, static_cast<Id>(locations.size()));
+}
+
+bool LooseQuadTree::insert(const Rectangle& box, Id id) {
+    if (!nodes[0].loose.contains(box) || id == INVALID_ID || contains(id) ||
+        static_cast<std::size_t>(id) >= 2 * locations.size() + ID_HEADROOM) {
+        return false;
+    }
+
+    if (id >= locations.size()) {
+        locations.resize(static_cast<std::size_t>(id) + 1, Location{NONE, 0});
+    }
+    uint32_t target = nodeFor(0, box);
+    for (uint32_t index = target; index != NONE; index = nodes[index].parent) {
+        nodes[index].total++;
+    }
+    addItem(target, Item{box, id});
+
+    if (!nodes[target].divided() && nodes[target].items.size() > CAPACITY && canSplit(nodes[target])) {
+        subdivide(target);
+    }
+    return true;
+}
+
+bool LooseQuadTree::remove(Id id) {
+    if (!contains(id)) {
+        return false;
+    }
+
+    uint32_t nodeIndex = locations[id].node;
+    removeItem(nodeIndex, locations[id].slot);
+    for (uint32_t index = nodeIndex; index != NONE; index = nodes[index].parent) {
+        nodes[index].total--;
+    }
+    mergeUp(nodeIndex);
+    return true;
+}
+
+bool LooseQuadTree::update(Id id, const Rectangle& box) {
+    if (!contains(id) || !nodes[0].loose.contains(box)) {
+        return false;
+    }
+
+    // Still the deepest node that takes it: overwrite in place
+    const Location& location = locations[id];
+    const Node& node = nodes[location.node];
+    if (node.loose.contains(box) &&
+        (!node.divided() || !nodes[childFor(node, box.center())].loose.contains(box))) {
+        nodes[location.node].items[location.slot].box = box;
+        return true;
+    }
+
+    remove(id);
+    insert(box, id);
+    return true;
+}
+
+bool LooseQuadTree::contains(Id id) const {
+    return id < locations.size() && locations[id].node != NONE;
+}
+
+Rectangle LooseQuadTree::getBox(Id id) const {
+    const Location& location = locations[id];
+    return nodes[location.node].items[location.slot].box;
+}
+
+std::vector<LooseQuadTree::Id> LooseQuadTree::query(const Rectangle& range) const {
+    std::vector<Id> result;
+    query(range, [&result](Id id, const Rectangle&) { result.push_back(id); });
+    return result;
+}
+
+std::vector<LooseQuadTree::Id> LooseQuadTree::queryPoint(const QuadPoint& point) const {
+    std::vector<Id> result;
+    queryPoint(point, [&result](Id id, const Rectangle&) { result.push_back(id); });
+    return result;
+}
+
+std::size_t LooseQuadTree::count(const Rectangle& range) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    std::size_t total = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.total == 0 || !touches(range, node.loose)) {
+            continue;
+        }
+
+        // Covered loose bounds answer from their subtree total
+        if (range.contains(node.loose)) {
+            total += node.total;
+            continue;
+        }
+
+        for (const Item& item : node.items) {
+            if (overlaps(range, item.box)) {
+                total++;
+            }
+        }
+        if (node.divided()) {
+            for (uint32_t i = 0; i < 4; i++) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return total;
+}
+
+std::vector<Rectangle> LooseQuadTree::getBoundaries() const {
+    // Pre-order with NW first, matching QuadTree::getBoundaries()
+    std::vector<Rectangle> boundaries;
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        boundaries.push_back(node.boundary);
+        if (node.divided()) {
+            for (int i = 3; i >= 0; i--) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return boundaries;
+}
+
+void LooseQuadTree::clear() {
+    Rectangle boundary = nodes[0].boundary;
+    nodes.clear();
+    locations.clear();
+    freeBlocks.clear();
+    nodes.push_back(makeNode(boundary, NONE, 0));
+}
+
+std::size_t LooseQuadTree::memoryUsage() const {
+    std::size_t bytes = nodes.capacity() * sizeof(Node) + locations.capacity() * sizeof(Location) +
+                        freeBlocks.capacity() * sizeof(uint32_t);
+    for (const Node& node : nodes) {
+        bytes += node.items.capacity() * sizeof(Item);
+    }
+    return bytes;
+}
+
+// Tree helpers
+LooseQuadTree::Node LooseQuadTree::makeNode(const Rectangle& cell, uint32_t parent, uint32_t depth) const {
+    float marginX = cell.width * (looseness - 1.0f) / 2.0f;
+    float marginY = cell.height * (looseness - 1.0f) / 2.0f;
+    Node node;
+    node.boundary = cell;
+    node.loose = Rectangle(cell.x - marginX, cell.y - marginY, cell.width + 2.0f * marginX,
+                           cell.height + 2.0f * marginY);
+    node.firstChild = NONE;
+    node.parent = parent;
+    node.depth = depth;
+    node.total = 0;
+    return node;
+}
+
+uint32_t LooseQuadTree::childFor(const Node& node, const QuadPoint& point) const {
+    // Compare against the children's own edges, as QuadTree::childFor does
+    uint32_t child = node.firstChild;
+    uint32_t east = point.x >= nodes[child + 1].boundary.x ? 1 : 0;
+    uint32_t south = point.y >= nodes[child + 2].boundary.y ? 2 : 0;
+    return child + east + south;
+}
+
+uint32_t LooseQuadTree::nodeFor(uint32_t nodeIndex, const Rectangle& box) const {
+    // Follow the box's center; loose bounds overlap, so a neighbouring
+    // child might take the box too, but the center's child is the one
+    // whose margin is most likely to
+    QuadPoint center = box.center();
+    uint32_t index = nodeIndex;
+    while (nodes[index].divided()) {
+        uint32_t child = childFor(nodes[index], center);
+        if (!nodes[child].loose.contains(box)) {
+            break;
+        }
+        index = child;
+    }
+    return index;
+}
+
+void LooseQuadTree::addItem(uint32_t nodeIndex, const Item& item) {
+    std::vector<Item>& items = nodes[nodeIndex].items;
+    locations[item.id] = Location{nodeIndex, static_cast<uint32_t>(items.size())};
+    items.push_back(item);
+}
+
+void LooseQuadTree::removeItem(uint32_t nodeIndex, uint32_t slot) {
+    // Swap the last box into the gap and repoint its location
+    std::vector<Item>& items = nodes[nodeIndex].items;
+    locations[items[slot].id].node = NONE;
+    if (slot + 1 != items.size()) {
+        items[slot] = items.back();
+        locations[items[slot].id].slot = slot;
+    }
+    items.pop_back();
+}
+
+bool LooseQuadTree::canSplit(const Node& node) const {
+    const Rectangle& b = node.boundary;
+    return node.depth < maxDepth && b.x + b.width / 2.0f > b.x && b.y + b.height / 2.0f > b.y;
+}
+
+void LooseQuadTree::subdivide(uint32_t nodeIndex) {
+    Rectangle b = nodes[nodeIndex].boundary;
+    uint32_t depth = nodes[nodeIndex].depth + 1;
+    float w = b.width / 2.0f;
+    float h = b.height / 2.0f;
+    const Rectangle cells[4] = {Rectangle(b.x, b.y, w, h), Rectangle(b.x + w, b.y, w, h),
+                                Rectangle(b.x, b.y + h, w, h), Rectangle(b.x + w, b.y + h, w, h)};
+
+    // Reuse a block freed by a merge when there is one. Growing may
+    // reallocate the arena, so no references into it are held across this.
+    uint32_t child;
+    if (!freeBlocks.empty()) {
+        child = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        child = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 4);
+    }
+    for (uint32_t q = 0; q < 4; q++) {
+        nodes[child + q] = makeNode(cells[q], nodeIndex, depth);
+    }
+    nodes[nodeIndex].firstChild = child;
+
+    // Move every box that fits a child's loose bound down, keep the rest
+    std::vector<Item> items;
+    items.swap(nodes[nodeIndex].items);
+    for (const Item& item : items) {
+        uint32_t target = childFor(nodes[nodeIndex], item.box.center());
+        if (!nodes[target].loose.contains(item.box)) {
+            target = nodeIndex;
+        } else {
+            nodes[target].total++;
+        }
+        addItem(target, item);
+    }
+
+    for (uint32_t q = 0; q < 4; q++) {
+        if (nodes[child + q].items.size() > CAPACITY && canSplit(nodes[child + q])) {
+            subdivide(child + q);
+        }
+    }
+}
+
+void LooseQuadTree::mergeUp(uint32_t nodeIndex) {
+    // Collapse the highest underfull ancestor; everything below it goes too
+    uint32_t highest = NONE;
+    for (uint32_t index = nodeIndex; index != NONE; index = nodes[index].parent) {
+        if (nodes[index].divided() && nodes[index].total <= MERGE_THRESHOLD) {
+            highest = index;
+        }
+    }
+    if (highest != NONE) {
+        collapse(highest);
+    }
+}
+
+void LooseQuadTree::collapse(uint32_t nodeIndex) {
+    uint32_t child = nodes[nodeIndex].firstChild;
+    nodes[nodeIndex].firstChild = NONE;
+    for (uint32_t q = 0; q < 4; q++) {
+        if (nodes[child + q].divided()) {
+            collapse(child + q);
+        }
+        std::vector<Item> items;
+        items.swap(nodes[child + q].items);
+        for (const Item& item : items) {
+            addItem(nodeIndex, item);
+        }
+    }
+    freeBlocks.push_back(child);
+}
@@ -0,0 +1,268 @@
+#ifndef LOOSE_QUADTREE_H
+#define LOOSE_QUADTREE_H
+
+#include "Point.h"
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+// A loose quadtree over rectangles (bounding boxes) rather than points.
+//
+// Each node has its cell, split in four like QuadTree's, and a loose bound:
+// the cell grown by (looseness - 1) / 2 of its size on every side. A box is
+// stored in the deepest node whose loose bound contains it, found by
+// following the box's center. With looseness 1 this is a plain region
+// quadtree, where a small box straddling a split line stays at the node
+// that split; looseness 2 (the default) lets any box no larger than a cell
+// sink to that cell's level wherever it lies.
+//
+// Nodes hold up to CAPACITY boxes before they split; boxes that fit a
+// child's loose bound move down and the rest stay. Queries prune by loose
+// bound, so they visit the nodes of their own region plus a margin.
+class LooseQuadTree {
+public:
+    typedef uint32_t Id;
+    static constexpr Id INVALID_ID = 0xFFFFFFFFu;
+
+    // How far past twice the id table's length a caller-chosen id may lie,
+    // as QuadTree::ID_HEADROOM
+    static constexpr Id ID_HEADROOM = 1u << 20;
+
+    static const int CAPACITY = 8;
+    static constexpr uint32_t DEFAULT_MAX_DEPTH = 16;
+    static constexpr float DEFAULT_LOOSENESS = 2.0f;
+
+    // looseness below 1 is treated as 1
+    LooseQuadTree(const Rectangle& boundary, float looseness = DEFAULT_LOOSENESS,
+                  uint32_t maxDepth = DEFAULT_MAX_DEPTH);
+
+    // Insert a box under the next id past every id used so far, or under a
+    // caller-chosen one. Returns false if the box does not fit the root's
+    // loose bound, the id is taken, or it is too far past the ids in use
+    // (see ID_HEADROOM).
+    bool insert(const Rectangle& box);
+    bool insert(const Rectangle& box, Id id);
+
+    // Remove the box with an id. Quadrants left underfull are merged back
+    // into their parent. Returns false if there is no such box.
+    bool remove(Id id);
+
+    // Move or resize the box with an id. A box that still belongs to its
+    // node is overwritten in place. Returns false (and changes nothing) if
+    // the id is missing or the new box does not fit the root.
+    bool update(Id id, const Rectangle& box);
+
+    // Whether a box with this id is stored
+    bool contains(Id id) const;
+
+    // Current box of a stored id; the id must be present
+    Rectangle getBox(Id id) const;
+
+    // Call visitor(const Rectangle&) or visitor(Id, const Rectangle&) for
+    // every box overlapping range. A box overlaps if it intersects the range
+    // or lies inside it. A visitor returning bool can return false to stop
+    // early; the result is false if the walk was stopped.
+    template <typename Visitor>
+    bool query(const Rectangle& range, Visitor&& visitor) const;
+
+    // Ids of the boxes overlapping range
+    std::vector<Id> query(const Rectangle& range) const;
+
+    // Call a visitor as above for every box containing point
+    template <typename Visitor>
+    bool queryPoint(const QuadPoint& point, Visitor&& visitor) const;
+
+    // Ids of the boxes containing point
+    std::vector<Id> queryPoint(const QuadPoint& point) const;
+
+    // Count boxes overlapping range. Nodes whose loose bound lies inside
+    // the range contribute their cached subtree total.
+    std::size_t count(const Rectangle& range) const;
+
+    // Total number of boxes in the tree
+    std::size_t size() const { return nodes[0].total; }
+
+    // Get all cell boundaries (not loose bounds) for visualization
+    std::vector<Rectangle> getBoundaries() const;
+
+    // Remove every box
+    void clear();
+
+    // Get the root cell
+    Rectangle getBoundary() const { return nodes[0].boundary; }
+
+    float getLooseness() const { return looseness; }
+
+    // Boxes stored at the root, which every query has to test; a measure
+    // of how much straddling the looseness leaves
+    std::size_t rootCount() const { return nodes[0].items.size(); }
+
+    // Number of nodes currently in the tree
+    std::size_t nodeCount() const { return nodes.size() - 4 * freeBlocks.size(); }
+
+    // Bytes reserved by nodes, their box lists and the id index
+    std::size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;
+    static constexpr int MAX_STACK = 512;
+    static constexpr uint32_t MAX_DEPTH = (MAX_STACK - 1) / 3;
+    static constexpr uint32_t INSIDE = 0x80000000u;
+
+    // As in QuadTree, kept below CAPACITY so a box moving back and forth
+    // does not split and merge a node every time
+    static constexpr uint32_t MERGE_THRESHOLD = CAPACITY / 2;
+
+    struct Item {
+        Rectangle box;
+        Id id;
+    };
+
+    // The four children of a node are allocated together: NW, NE, SW, SE
+    // follow firstChild
+    struct Node {
+        Rectangle boundary;       // Cell
+        Rectangle loose;          // Cell grown by the looseness margin
+        uint32_t firstChild;      // NONE while this is a leaf
+        uint32_t parent;          // NONE for the root
+        uint32_t depth;
+        uint32_t total;           // Boxes in the whole subtree
+        std::vector<Item> items;  // Boxes stored at this node
+
+        bool divided() const { return firstChild != NONE; }
+    };
+
+    struct Location {
+        uint32_t node;  // NONE if the id is unused
+        uint32_t slot;  // Index in the node's items
+    };
+
+    std::vector<Node> nodes;  // nodes[0] is the root
+    std::vector<Location> locations;
+    std::vector<uint32_t> freeBlocks;
+    float looseness;
+    uint32_t maxDepth;
+
+    // Call a visitor with (id, box) or just (box), whichever it takes
+    template <typename Visitor>
+    static bool visit(Visitor& visitor, Id id, const Rectangle& box);
+
+    static bool overlaps(const Rectangle& range, const Rectangle& box) {
+        return range.intersects(box) || range.contains(box);
+    }
+
+    // Closed-interval overlap, for pruning: unlike intersects() it keeps
+    // nodes that only touch the range, where a zero-size box may sit
+    static bool touches(const Rectangle& a, const Rectangle& b) {
+        return !(b.x > a.x + a.width || b.x + b.width < a.x ||
+                 b.y > a.y + a.height || b.y + b.height < a.y);
+    }
+
+    Node makeNode(const Rectangle& cell, uint32_t parent, uint32_t depth) const;
+
+    // Child of a divided node whose quadrant holds the point
+    uint32_t childFor(const Node& node, const QuadPoint& point) const;
+
+    // Deepest node below nodeIndex whose loose bound takes the box
+    uint32_t nodeFor(uint32_t nodeIndex, const Rectangle& box) const;
+
+    void addItem(uint32_t nodeIndex, const Item& item);
+    void removeItem(uint32_t nodeIndex, uint32_t slot);
+
+    bool canSplit(const Node& node) const;
+
+    // Give a leaf children and move down every box that fits one
+    void subdivide(uint32_t nodeIndex);
+
+    // Collapse the highest underfull divided ancestor of nodeIndex
+    void mergeUp(uint32_t nodeIndex);
+
+    // Pull every box below a node into it and free its descendants
+    void collapse(uint32_t nodeIndex);
+};
+
+template <typename Visitor>
+bool LooseQuadTree::visit(Visitor& visitor, Id id, const Rectangle& box) {
+    if constexpr (std::is_invocable_v<Visitor&, Id, const Rectangle&>) {
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, Id, const Rectangle&>, void>) {
+            visitor(id, box);
+            return true;
+        } else {
+            return visitor(id, box);
+        }
+    } else if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const Rectangle&>, void>) {
+        visitor(box);
+        return true;
+    } else {
+        return visitor(box);
+    }
+}
+
+template <typename Visitor>
+bool LooseQuadTree::query(const Rectangle& range, Visitor&& visitor) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        const Node& node = nodes[entry & ~INSIDE];
+        bool inside = (entry & INSIDE) != 0;
+
+        // Every box lies within its node's loose bound, so a covered loose
+        // bound means every box below overlaps
+        if (!inside) {
+            if (node.total == 0 || !touches(range, node.loose)) {
+                continue;
+            }
+            inside = range.contains(node.loose);
+        }
+
+        for (const Item& item : node.items) {
+            if ((inside || overlaps(range, item.box)) && !visit(visitor, item.id, item.box)) {
+                return false;
+            }
+        }
+
+        if (node.divided()) {
+            uint32_t flag = inside ? INSIDE : 0;
+            for (int i = 3; i >= 0; i--) {
+                if (nodes[node.firstChild + i].total != 0) {
+                    stack[top++] = (node.firstChild + i) | flag;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <typename Visitor>
+bool LooseQuadTree::queryPoint(const QuadPoint& point, Visitor&& visitor) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        if (node.total == 0 || !node.loose.contains(point)) {
+            continue;
+        }
+
+        for (const Item& item : node.items) {
+            if (item.box.contains(point) && !visit(visitor, item.id, item.box)) {
+                return false;
+            }
+        }
+
+        // Loose bounds overlap, so the point may lie in several children's
+        if (node.divided()) {
+            for (int i = 3; i >= 0; i--) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return true;
+}
+
+#endif // LOOSE_QUADTREE_H
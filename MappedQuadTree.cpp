@@ -0,0 +1,221 @@
+#include "MappedQuadTree.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// MappedQuadTree constructor
+MappedQuadTree::MappedQuadTree()
+    : mapping(nullptr), mappedSize(0), nodes(nullptr), xs(nullptr), ys(nullptr), ids(nullptr),
+      nodeTotal(0), pointCount(0) {}
+
+MappedQuadTree::~MappedQuadTree() {
+    close();
+}
+
+// MappedQuadTree public methods
+bool MappedQuadTree::open(const std::string& path) {
+    namespace Snapshot = QuadTreeSnapshot;
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(Snapshot::Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    // The mapping keeps the file alive on its own
+    std::size_t length = static_cast<std::size_t>(info.st_size);
+    void* base = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        return false;
+    }
+
+    // Check that the header describes arrays lying inside this file
+    Snapshot::Header header;
+    std::memcpy(&header, base, sizeof(header));
+    auto fits = [&](uint64_t offset, uint64_t count, uint64_t size) {
+        return offset % Snapshot::ALIGNMENT == 0 && offset <= length && count <= (length - offset) / size;
+    };
+    bool valid = std::memcmp(header.magic, Snapshot::MAGIC, sizeof(header.magic)) == 0 &&
+                 header.version == Snapshot::VERSION &&
+                 header.byteOrder == Snapshot::BYTE_ORDER_MARK &&
+                 header.fileSize == length && header.nodeCount > 0 &&
+                 header.nodeCount < Snapshot::NONE && header.pointCount < Snapshot::NONE &&
+                 fits(header.nodesOffset, header.nodeCount, sizeof(Node)) &&
+                 fits(header.xsOffset, header.pointCount, sizeof(float)) &&
+                 fits(header.ysOffset, header.pointCount, sizeof(float)) &&
+                 fits(header.idsOffset, header.pointCount, sizeof(Id));
+    if (!valid) {
+        munmap(base, length);
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(base);
+    mapping = base;
+    mappedSize = length;
+    nodes = reinterpret_cast<const Node*>(bytes + header.nodesOffset);
+    xs = reinterpret_cast<const float*>(bytes + header.xsOffset);
+    ys = reinterpret_cast<const float*>(bytes + header.ysOffset);
+    ids = reinterpret_cast<const Id*>(bytes + header.idsOffset);
+    nodeTotal = static_cast<std::size_t>(header.nodeCount);
+    pointCount = static_cast<std::size_t>(header.pointCount);
+    return true;
+}
+
+void MappedQuadTree::close() {
+    if (mapping) {
+        munmap(mapping, mappedSize);
+    }
+    mapping = nullptr;
+    mappedSize = 0;
+    nodes = nullptr;
+    xs = ys = nullptr;
+    ids = nullptr;
+    nodeTotal = 0;
+    pointCount = 0;
+}
+
+bool MappedQuadTree::verify() const {
+    if (!mapping) {
+        return false;
+    }
+
+    // save() numbers nodes breadth-first, so the k-th divided node's
+    // children are the block at 1 + 4k. Holding every node to that rules
+    // out cycles and shared or overlapping blocks, so each node has one
+    // parent and one depth, which is capped by the query stack.
+    std::vector<uint8_t> depth(nodeTotal, 0);
+    uint64_t nextChild = 1;
+    for (std::size_t i = 0; i < nodeTotal; i++) {
+        const Node& node = nodes[i];
+        if (node.count > pointCount || node.bucket > pointCount - node.count) {
+            return false;
+        }
+        if (node.firstChild == QuadTreeSnapshot::NONE) {
+            if (node.total != node.count) {
+                return false;
+            }
+            continue;
+        }
+        if (node.firstChild != nextChild || nextChild + 4 > nodeTotal || depth[i] + 1 > (MAX_STACK - 1) / 3) {
+            return false;
+        }
+        nextChild += 4;
+        uint64_t total = node.count;
+        for (uint32_t q = 0; q < 4; q++) {
+            total += nodes[node.firstChild + q].total;
+            depth[node.firstChild + q] = static_cast<uint8_t>(depth[i] + 1);
+        }
+        if (total != node.total) {
+            return false;
+        }
+    }
+    return nextChild == nodeTotal && nodes[0].total == pointCount;
+}
+
+std::vector<QuadPoint> MappedQuadTree::query(const Rectangle& range) const {
+    std::vector<QuadPoint> result;
+    query(range, result);
+    return result;
+}
+
+void MappedQuadTree::query(const Rectangle& range, std::vector<QuadPoint>& result) const {
+    query(range, [&result](const QuadPoint& point) { result.push_back(point); });
+}
+
+std::vector<MappedQuadTree::Id> MappedQuadTree::queryIds(const Rectangle& range) const {
+    std::vector<Id> result;
+    query(range, [&result](Id id, const QuadPoint&) { result.push_back(id); });
+    return result;
+}
+
+std::size_t MappedQuadTree::count(const Rectangle& range) const {
+    if (!mapping) {
+        return 0;
+    }
+
+    uint32_t stack[MAX_STACK];
+    uint32_t hits[FILTER_CHUNK];
+    int top = 0;
+    stack[top++] = 0;
+    std::size_t total = 0;
+
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        Rectangle boundary = boundaryOf(node);
+
+        if (node.total == 0 || !boundary.intersects(range)) {
+            continue;
+        }
+
+        // Covered nodes answer from their stored subtree total
+        if (range.contains(boundary)) {
+            total += node.total;
+            continue;
+        }
+
+        if (node.count < FILTER_MIN) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                if (range.contains(QuadPoint(xs[node.bucket + i], ys[node.bucket + i]))) {
+                    total++;
+                }
+            }
+        } else {
+            for (uint32_t begin = 0; begin < node.count; begin += FILTER_CHUNK) {
+                uint32_t chunk = std::min(node.count - begin, FILTER_CHUNK);
+                total += RangeFilter::filter(xs + node.bucket + begin, ys + node.bucket + begin,
+                                             chunk, range, hits);
+            }
+        }
+
+        if (node.firstChild != QuadTreeSnapshot::NONE) {
+            for (uint32_t i = 0; i < 4; i++) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return total;
+}
+
+std::vector<QuadPoint> MappedQuadTree::getAllPoints() const {
+    // Leaves are packed, so every stored point is one contiguous run
+    std::vector<QuadPoint> points;
+    points.reserve(pointCount);
+    for (std::size_t i = 0; i < pointCount; i++) {
+        points.emplace_back(xs[i], ys[i]);
+    }
+    return points;
+}
+
+std::vector<Rectangle> MappedQuadTree::getBoundaries() const {
+    std::vector<Rectangle> boundaries;
+    if (!mapping) {
+        return boundaries;
+    }
+
+    // Pre-order with NW first, matching QuadTree::getBoundaries()
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        boundaries.push_back(boundaryOf(node));
+        if (node.firstChild != QuadTreeSnapshot::NONE) {
+            for (int i = 3; i >= 0; i--) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return boundaries;
+}
+
+Rectangle MappedQuadTree::getBoundary() const {
+    return mapping ? boundaryOf(nodes[0]) : Rectangle();
+}
@@ -0,0 +1,191 @@
+#ifndef MAPPED_QUADTREE_H
+#define MAPPED_QUADTREE_H
+
+#include "Point.h"
+#include "QuadTreeSnapshot.h"
+#include "RangeFilter.h"
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+
+// A read-only QuadTree served straight from a snapshot file.
+//
+// open() maps the file written by QuadTree::save() and checks its header;
+// queries then walk the mapped node and point arrays in place, so opening
+// costs the same for any size of tree and pages are read in as queries
+// touch them. The mapping is shared and read-only, so processes opening the
+// same snapshot share one copy in the page cache. QuadTree::save() replaces
+// a snapshot by renaming a new file over it, so an open mapping keeps
+// serving the old one; never truncate or rewrite a mapped file in place.
+class MappedQuadTree {
+public:
+    typedef uint32_t Id;
+
+    MappedQuadTree();
+    ~MappedQuadTree();
+
+    MappedQuadTree(const MappedQuadTree&) = delete;
+    MappedQuadTree& operator=(const MappedQuadTree&) = delete;
+
+    // Map a snapshot, replacing any open one. Returns false if the file
+    // cannot be mapped or its header is not a snapshot this build reads.
+    bool open(const std::string& path);
+
+    // Unmap the snapshot
+    void close();
+
+    bool isOpen() const { return mapping != nullptr; }
+
+    // Walk every node and check that child and point references stay in
+    // bounds. open() only checks the header so that it stays O(1); call
+    // this once for files from an untrusted source. O(nodes).
+    bool verify() const;
+
+    // Query points within a rectangular range
+    std::vector<QuadPoint> query(const Rectangle& range) const;
+
+    // Append points within range to a caller-owned buffer (not cleared first)
+    void query(const Rectangle& range, std::vector<QuadPoint>& result) const;
+
+    // Call visitor(const QuadPoint&) or visitor(Id, const QuadPoint&) for
+    // every point within range. A visitor returning bool can return false to
+    // stop early; the result is false if the walk was stopped.
+    template <typename Visitor>
+    bool query(const Rectangle& range, Visitor&& visitor) const;
+
+    // Ids of the points within range
+    std::vector<Id> queryIds(const Rectangle& range) const;
+
+    // Count points within range; covered nodes use their stored totals
+    std::size_t count(const Rectangle& range) const;
+
+    // Total number of points in the snapshot
+    std::size_t size() const { return pointCount; }
+
+    // Get all points in the snapshot
+    std::vector<QuadPoint> getAllPoints() const;
+
+    // Get all subdivision boundaries for visualization
+    std::vector<Rectangle> getBoundaries() const;
+
+    // Get the root boundary
+    Rectangle getBoundary() const;
+
+    // Number of nodes in the snapshot
+    std::size_t nodeCount() const { return nodeTotal; }
+
+private:
+    typedef QuadTreeSnapshot::Node Node;
+
+    // Same traversal limits as QuadTree, which wrote the tree
+    static constexpr int MAX_STACK = 512;
+    static constexpr uint32_t INSIDE = 0x80000000u;
+    static constexpr uint32_t FILTER_CHUNK = 64;
+    static constexpr uint32_t FILTER_MIN = 8;
+
+    void* mapping;
+    std::size_t mappedSize;
+
+    // Views into the mapping
+    const Node* nodes;
+    const float* xs;
+    const float* ys;
+    const Id* ids;
+    std::size_t nodeTotal;
+    std::size_t pointCount;
+
+    static Rectangle boundaryOf(const Node& node) {
+        return Rectangle(node.x, node.y, node.width, node.height);
+    }
+
+    // Call a visitor with (id, point) or just (point), whichever it takes
+    template <typename Visitor>
+    static bool visit(Visitor& visitor, Id id, const QuadPoint& point);
+};
+
+template <typename Visitor>
+bool MappedQuadTree::visit(Visitor& visitor, Id id, const QuadPoint& point) {
+    if constexpr (std::is_invocable_v<Visitor&, Id, const QuadPoint&>) {
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, Id, const QuadPoint&>, void>) {
+            visitor(id, point);
+            return true;
+        } else {
+            return visitor(id, point);
+        }
+    } else if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const QuadPoint&>, void>) {
+        visitor(point);
+        return true;
+    } else {
+        return visitor(point);
+    }
+}
+
+template <typename Visitor>
+bool MappedQuadTree::query(const Rectangle& range, Visitor&& visitor) const {
+    if (!mapping) {
+        return true;
+    }
+
+    uint32_t stack[MAX_STACK];
+    uint32_t hits[FILTER_CHUNK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        const Node& node = nodes[entry & ~INSIDE];
+        bool inside = (entry & INSIDE) != 0;
+
+        if (!inside) {
+            Rectangle boundary = boundaryOf(node);
+            if (node.total == 0 || !boundary.intersects(range)) {
+                continue;
+            }
+            inside = range.contains(boundary);
+        }
+
+        const float* px = xs + node.bucket;
+        const float* py = ys + node.bucket;
+        const Id* pid = ids + node.bucket;
+        if (inside) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                if (!visit(visitor, pid[i], QuadPoint(px[i], py[i]))) {
+                    return false;
+                }
+            }
+        } else if (node.count < FILTER_MIN) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                QuadPoint point(px[i], py[i]);
+                if (range.contains(point) && !visit(visitor, pid[i], point)) {
+                    return false;
+                }
+            }
+        } else {
+            for (uint32_t begin = 0; begin < node.count; begin += FILTER_CHUNK) {
+                uint32_t chunk = std::min(node.count - begin, FILTER_CHUNK);
+                uint32_t found = RangeFilter::filter(px + begin, py + begin, chunk, range, hits);
+                for (uint32_t i = 0; i < found; i++) {
+                    uint32_t k = begin + hits[i];
+                    if (!visit(visitor, pid[k], QuadPoint(px[k], py[k]))) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        if (node.firstChild != QuadTreeSnapshot::NONE) {
+            uint32_t flag = inside ? INSIDE : 0;
+            for (int i = 3; i >= 0; i--) {
+                if (nodes[node.firstChild + i].total != 0) {
+                    stack[top++] = (node.firstChild + i) | flag;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+#endif // MAPPED_QUADTREE_H
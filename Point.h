@@ -1,6 +1,8 @@
 #ifndef POINT_H
 #define POINT_H
 
+#include <algorithm>
+
 // Simple 2D point structure
 struct QuadPoint {
     float x, y;
@@ -11,6 +13,13 @@ struct QuadPoint {
     bool operator==(const QuadPoint& other) const {
         return x == other.x && y == other.y;
     }
+    
+    // Squared Euclidean distance to another point
+    float distanceSquared(const QuadPoint& other) const {
+        float dx = x - other.x;
+        float dy = y - other.y;
+        return dx * dx + dy * dy;
+    }
 };
 
 // Rectangle structure for quad tree bounds
@@ -28,6 +37,12 @@ struct Rectangle {
                 point.y >= y && point.y < y + height);
     }
     
+    // Check if another rectangle lies entirely inside this one
+    bool contains(const Rectangle& other) const {
+        return (other.x >= x && other.x + other.width <= x + width &&
+                other.y >= y && other.y + other.height <= y + height);
+    }
+    
     // Check if this rectangle intersects with another
     bool intersects(const Rectangle& other) const {
         return !(other.x >= x + width || 
@@ -36,6 +51,27 @@ struct Rectangle {
                  other.y + other.height <= y);
     }
     
+    // Squared distance from a point to the nearest point of this rectangle
+    // (zero when the point is inside)
+    float distanceSquared(const QuadPoint& point) const {
+        float dx = point.x < x ? x - point.x : (point.x > x + width ? point.x - (x + width) : 0.0f);
+        float dy = point.y < y ? y - point.y : (point.y > y + height ? point.y - (y + height) : 0.0f);
+        return dx * dx + dy * dy;
+    }
+    
+    // Check if a circle overlaps this rectangle
+    bool intersectsCircle(const QuadPoint& center, float radius) const {
+        return distanceSquared(center) <= radius * radius;
+    }
+    
+    // Check if this rectangle lies entirely inside a circle (all four
+    // corners are within radius of the center)
+    bool insideCircle(const QuadPoint& center, float radius) const {
+        float dx = std::max(center.x - x, x + width - center.x);
+        float dy = std::max(center.y - y, y + height - center.y);
+        return dx * dx + dy * dy <= radius * radius;
+    }
+    
     // Get center point
     QuadPoint center() const {
         return QuadPoint(x + width / 2.0f, y + height / 2.0f);
@@ -0,0 +1,270 @@
+#include "PointLoader.h"
+#include "QuadTree.h"
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// First '\n' in [p, end), or end. Compares 16 bytes per step where SSE2 is
+// available; lines are usually short, but this is the loop every byte of a
+// CSV file goes through.
+const char* findNewline(const char* p, const char* end) {
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; p + 16 <= end; p += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, newline)));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+    }
+#endif
+    for (; p < end; p++) {
+        if (*p == '\n') {
+            return p;
+        }
+    }
+    return end;
+}
+
+const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+    return p;
+}
+
+// Parse one float at p, not reading past end; nullptr if there is none
+const char* parseFloat(const char* p, const char* end, float& value) {
+    p = skipBlanks(p, end);
+    if (p < end && *p == '+') {
+        p++;
+    }
+#if defined(__cpp_lib_to_chars)
+    std::from_chars_result result = std::from_chars(p, end, value);
+    return result.ec == std::errc() ? result.ptr : nullptr;
+#else
+    // No floating-point from_chars in this standard library. strtof stops
+    // at the delimiter or the sentinel after the data, but it also skips
+    // leading newlines, so a result past end means an empty field.
+    if (p == end || *p == '\n') {
+        return nullptr;
+    }
+    char* next = nullptr;
+    value = std::strtof(p, &next);
+    return next == p || next > end ? nullptr : next;
+#endif
+}
+
+} // namespace
+
+// PointLoader constructor
+PointLoader::PointLoader(std::size_t chunkBytes)
+    : chunkBytes(chunkBytes < 64 ? 64 : chunkBytes), lastStats(), stopping(false) {}
+
+// PointLoader public methods
+bool PointLoader::load(const std::string& path, Format format, const Sink& sink) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    if (format == Format::Auto) {
+        format = detect(path);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    lastStats = Stats();
+    ready.clear();
+    spare.assign(QUEUE_DEPTH, Batch());
+    stopping = false;
+
+    std::thread reader(&PointLoader::produce, this, file, format);
+    bool failed = false;
+    try {
+        for (;;) {
+            Batch batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [this]() { return !ready.empty(); });
+                batch = std::move(ready.front());
+                ready.pop_front();
+            }
+
+            sink(batch.points.data(), batch.points.size());
+            lastStats.bytes += batch.bytes;
+            lastStats.points += batch.points.size();
+            lastStats.malformed += batch.malformed;
+            bool last = batch.last;
+            failed = batch.failed;
+
+            // Hand the buffer back to the reader
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                spare.push_back(std::move(batch));
+            }
+            changed.notify_all();
+            if (last) {
+                break;
+            }
+        }
+    } catch (...) {
+        // The reader may be waiting for a buffer the sink never returned
+        finish(reader, file);
+        throw;
+    }
+    finish(reader, file);
+
+    spare.clear();
+    spare.shrink_to_fit();
+    lastStats.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return !failed;
+}
+
+bool PointLoader::load(const std::string& path, Format format, QuadTree& tree) {
+    uint64_t inserted = 0;
+    bool loaded = load(path, format, [&tree, &inserted](const QuadPoint* points, std::size_t count) {
+        inserted += tree.insertBatch(points, count);
+    });
+    lastStats.inserted = inserted;
+    return loaded;
+}
+
+PointLoader::Format PointLoader::detect(const std::string& path) {
+    std::size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot + 1);
+    if (extension == "bin" || extension == "f32" || extension == "raw") {
+        return Format::Binary;
+    }
+    return Format::CSV;
+}
+
+uint64_t PointLoader::parseCSV(const char* begin, const char* end, std::vector<QuadPoint>& points) {
+    uint64_t malformed = 0;
+    for (const char* line = begin; line < end;) {
+        const char* lineEnd = findNewline(line, end);
+
+        // Blank lines, including a lone '\r', are not errors
+        const char* p = skipBlanks(line, lineEnd);
+        if (p < lineEnd && *p != '\r') {
+            float x, y;
+            p = parseFloat(p, lineEnd, x);
+            if (p) {
+                p = skipBlanks(p, lineEnd);
+                p = p < lineEnd && (*p == ',' || *p == ';') ? parseFloat(p + 1, lineEnd, y) : nullptr;
+            }
+            if (p) {
+                points.emplace_back(x, y);
+            } else {
+                malformed++;
+            }
+        }
+        line = lineEnd + 1;
+    }
+    return malformed;
+}
+
+// Loader helpers
+bool PointLoader::takeSpare(Batch& batch) {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [this]() { return stopping || !spare.empty(); });
+    if (stopping) {
+        return false;
+    }
+    batch = std::move(spare.back());
+    spare.pop_back();
+    batch.points.clear();
+    batch.bytes = 0;
+    batch.malformed = 0;
+    batch.last = false;
+    batch.failed = false;
+    return true;
+}
+
+void PointLoader::finish(std::thread& reader, std::FILE* file) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    reader.join();
+    std::fclose(file);
+}
+
+void PointLoader::produce(std::FILE* file, Format format) {
+    // One spare byte past the data holds a '\0' for the strtof fallback
+    std::vector<char> buffer(chunkBytes + 1);
+    std::size_t carry = 0;   // Unparsed tail of the previous chunk, moved to the front
+    bool skipping = false;   // Inside a CSV line longer than a chunk
+
+    for (;;) {
+        Batch batch;
+        if (!takeSpare(batch)) {
+            return;
+        }
+        std::size_t got = std::fread(buffer.data() + carry, 1, chunkBytes - carry, file);
+        bool done = got < chunkBytes - carry;
+        batch.failed = done && std::ferror(file);
+        std::size_t length = carry + got;
+        buffer[length] = '\0';
+        batch.bytes = got;
+
+        const char* data = buffer.data();
+        std::size_t begin = 0;
+        std::size_t parsed = length;
+
+        if (format == Format::Binary) {
+            // Whole pairs only; a torn pair waits for the next chunk
+            parsed = length / (2 * sizeof(float)) * (2 * sizeof(float));
+            batch.points.resize(parsed / (2 * sizeof(float)));
+            std::memcpy(batch.points.data(), data, parsed);
+        } else {
+            if (skipping) {
+                const char* newline = findNewline(data, data + length);
+                begin = static_cast<std::size_t>(newline - data);
+                skipping = begin == length;
+                begin = skipping ? length : begin + 1;
+            }
+
+            // Parse up to the last newline and keep the partial line after
+            // it, unless this is the end of the file
+            std::size_t last = length;
+            while (!done && last > begin && data[last - 1] != '\n') {
+                last--;
+            }
+            if (!done && last == begin && length - begin == chunkBytes) {
+                // A line that fills the whole buffer can never be parsed
+                batch.malformed++;
+                skipping = true;
+                last = length;
+            } else {
+                if (!done) {
+                    parsed = last;
+                }
+                batch.malformed += parseCSV(data + begin, data + parsed, batch.points);
+            }
+            if (skipping) {
+                parsed = length;
+            }
+        }
+
+        carry = done ? 0 : length - parsed;
+        std::memmove(buffer.data(), data + parsed, carry);
+        batch.last = done;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(std::move(batch));
+        }
+        changed.notify_all();
+        if (done) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef POINT_LOADER_H
+#define POINT_LOADER_H
+
+#include "Point.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class QuadTree;
+
+// Streams points from large files with bounded memory.
+//
+// A background thread reads the file in fixed-size chunks and parses each
+// chunk into a batch of points while the calling thread consumes finished
+// batches, so parsing overlaps insertion. At most QUEUE_DEPTH batches are in
+// flight and their buffers are reused, so peak memory is a few chunks
+// however large the file is.
+//
+// Two formats are read:
+// - CSV: one point per line, "x,y" with optional spaces and further
+//   columns. Lines that do not start with two numbers, such as a header,
+//   are counted as malformed and skipped.
+// - Binary: raw float32 x, y pairs in host byte order.
+class PointLoader {
+public:
+    enum class Format { Auto, CSV, Binary };
+
+    struct Stats {
+        uint64_t bytes;      // Bytes read from the file
+        uint64_t points;     // Points parsed
+        uint64_t inserted;   // Points the tree accepted (tree overload only)
+        uint64_t malformed;  // CSV lines skipped, including over-long ones
+        double seconds;      // Wall time of the whole load
+    };
+
+    // Receives each parsed batch on the thread that called load()
+    typedef std::function<void(const QuadPoint* points, std::size_t count)> Sink;
+
+    static const std::size_t DEFAULT_CHUNK = 1 << 20;
+
+    // chunkBytes is the read size and also the longest CSV line accepted
+    explicit PointLoader(std::size_t chunkBytes = DEFAULT_CHUNK);
+
+    // Stream a file into a sink. Returns false if it cannot be opened or a
+    // read fails; the batches before the failure have been delivered. If
+    // the sink throws, the reader is stopped and the file closed before
+    // the exception propagates.
+    bool load(const std::string& path, Format format, const Sink& sink);
+
+    // Stream a file into a tree; points outside its bounds are dropped
+    bool load(const std::string& path, Format format, QuadTree& tree);
+
+    // Counters of the last load
+    const Stats& stats() const { return lastStats; }
+
+    // Binary for .bin, .f32 and .raw files, CSV otherwise
+    static Format detect(const std::string& path);
+
+    // Parse whole CSV lines in [begin, end) into points. The character at
+    // end must be readable and not part of a number (the loader keeps a
+    // '\0' there). Returns the number of malformed lines.
+    static uint64_t parseCSV(const char* begin, const char* end, std::vector<QuadPoint>& points);
+
+private:
+    static const std::size_t QUEUE_DEPTH = 3;
+
+    struct Batch {
+        std::vector<QuadPoint> points;
+        uint64_t bytes;
+        uint64_t malformed;
+        bool last;
+        bool failed;    // The read ended with an error rather than EOF
+    };
+
+    std::size_t chunkBytes;
+    Stats lastStats;
+
+    // Batches parsed and waiting, and spent ones whose buffers can be reused
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<Batch> ready;
+    std::vector<Batch> spare;
+    bool stopping;  // The consumer gave up; the reader returns
+
+    // Reader thread body: read, parse and queue every chunk of the file
+    void produce(std::FILE* file, Format format);
+
+    // Take a spare batch, waiting while QUEUE_DEPTH are in flight. Returns
+    // false once the consumer has stopped.
+    bool takeSpare(Batch& batch);
+
+    // Stop the reader, wait for it and close the file
+    void finish(std::thread& reader, std::FILE* file);
+};
+
+#endif // POINT_LOADER_H
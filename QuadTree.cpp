@@ -1,124 +1,1501 @@
 #include "QuadTree.h"
+#include "QuadTreeSnapshot.h"
+#include "TaskPool.h"
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <queue>
+#include <utility>
 
 // QuadTree constructor
-QuadTree::QuadTree(const Rectangle& boundary) {
-    root = std::make_unique<QuadNode>(boundary);
+QuadTree::QuadTree(const Rectangle& boundary, uint32_t maxDepth, float minCellSize)
+    : trackLocations(true), maxDepth(std::min(maxDepth, MAX_DEPTH)), minCellSize(minCellSize),
+      autoExpand(false), capacity(DEFAULT_CAPACITY), splitRule(SPLIT_MIDPOINT), lazySplit(false),
+      autoTune(false), uneven(false), mergeThreshold(DEFAULT_CAPACITY / 2), grownLevels(0) {
+    nodes.emplace_back(boundary);
+    updateSplitLimits();
+}
+
+void QuadTree::updateSplitLimits() {
+    // A node at depth d is exactly 2^-d the size of the root, so the depth
+    // limit folds into the same size test as the cell size limit
+    int depth = static_cast<int>(maxDepth);
+    minSplitWidth = std::max(std::ldexp(nodes[0].boundary.width, 1 - depth), 2.0f * minCellSize);
+    minSplitHeight = std::max(std::ldexp(nodes[0].boundary.height, 1 - depth), 2.0f * minCellSize);
 }
 
 // QuadTree public methods
 bool QuadTree::insert(const QuadPoint& point) {
-    return root->insert(point);
+    return insert(point, static_cast<Id>(locations.size()));
+}
+
+bool QuadTree::insert(const QuadPoint& point, Id id) {
+    QUADTREE_STAT(auto start = std::chrono::steady_clock::now());
+
+    // Check if point is within the root boundary, growing it if allowed
+    if (id == INVALID_ID || contains(id) ||
+        static_cast<std::size_t>(id) >= 2 * locations.size() + ID_HEADROOM) {
+        return false;
+    }
+    if (!nodes[0].boundary.contains(point) && !(autoExpand && expandToInclude(point))) {
+        return false;
+    }
+
+    if (id >= locations.size()) {
+        locations.resize(static_cast<std::size_t>(id) + 1, Location{NONE, 0});
+    }
+    insertFrom(0, point, id);
+    if (autoTune && ++workload.inserts >= std::max<uint64_t>(TUNE_INTERVAL, size() / 2)) {
+        tune();
+    }
+    QUADTREE_STAT(counters.insertLatency.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count())));
+    return true;
+}
+
+bool QuadTree::remove(const QuadPoint& point) {
+    uint32_t leaf = findLeaf(point);
+    uint32_t slot = leaf == NONE ? NONE : findSlot(leaf, point);
+    if (slot == NONE) {
+        return false;
+    }
+
+    erase(leaf, slot);
+    return true;
+}
+
+bool QuadTree::remove(Id id) {
+    if (!contains(id)) {
+        return false;
+    }
+
+    erase(locations[id].node, locations[id].slot);
+    return true;
+}
+
+bool QuadTree::update(const QuadPoint& from, const QuadPoint& to) {
+    if (!nodes[0].boundary.contains(to)) {
+        return false;
+    }
+    uint32_t leaf = findLeaf(from);
+    uint32_t slot = leaf == NONE ? NONE : findSlot(leaf, from);
+    if (slot == NONE) {
+        return false;
+    }
+
+    move(leaf, slot, to);
+    return true;
+}
+
+bool QuadTree::update(Id id, const QuadPoint& to) {
+    if (!nodes[0].boundary.contains(to) || !contains(id)) {
+        return false;
+    }
+
+    move(locations[id].node, locations[id].slot, to);
+    return true;
+}
+
+bool QuadTree::contains(Id id) const {
+    return id < locations.size() && locations[id].node != NONE;
+}
+
+QuadPoint QuadTree::position(Id id) const {
+    const Location& location = locations[id];
+    uint32_t offset = nodes[location.node].bucket + location.slot;
+    return QuadPoint(xs[offset], ys[offset]);
+}
+
+std::size_t QuadTree::build(const QuadPoint* points, std::size_t count) {
+    clear();
+
+    // Keep only points inside the boundary, then sort them into the tree
+    std::vector<Entry> work = collect(points, count);
+    std::vector<Entry> scratch(work.size());
+    locations.assign(count, Location{NONE, 0});
+    build(0, work.data(), work.data() + work.size(), scratch.data());
+
+    // The final size is known now; give back the arenas' growth slack
+    nodes.shrink_to_fit();
+    xs.shrink_to_fit();
+    ys.shrink_to_fit();
+    ids.shrink_to_fit();
+    return work.size();
+}
+
+std::size_t QuadTree::build(const std::vector<QuadPoint>& points) {
+    return build(points.data(), points.size());
+}
+
+std::size_t QuadTree::insertBatch(const QuadPoint* points, std::size_t count) {
+    // Ids in input order, skipping the points insert() would refuse
+    std::vector<Entry> work;
+    work.reserve(count);
+    Id next = static_cast<Id>(locations.size());
+    for (std::size_t i = 0; i < count; i++) {
+        if (nodes[0].boundary.contains(points[i]) || (autoExpand && expandToInclude(points[i]))) {
+            work.push_back(Entry{points[i], next++});
+        }
+    }
+    if (work.empty()) {
+        return 0;
+    }
+
+    locations.resize(next, Location{NONE, 0});
+    std::vector<Entry> scratch(work.size());
+    std::vector<Entry> spill;
+    insertBatch(0, work.data(), work.data() + work.size(), scratch.data(), spill);
+    if (autoTune) {
+        workload.inserts += work.size();
+        if (workload.inserts >= std::max<uint64_t>(TUNE_INTERVAL, size() / 2)) {
+            tune();
+        }
+    }
+    return work.size();
+}
+
+std::size_t QuadTree::insertBatch(const std::vector<QuadPoint>& points) {
+    return insertBatch(points.data(), points.size());
+}
+
+std::size_t QuadTree::build(const QuadPoint* points, std::size_t count, TaskPool& pool) {
+    if (pool.size() == 1) {
+        return build(points, count);
+    }
+    clear();
+
+    std::vector<Entry> work = collect(points, count);
+    std::vector<Entry> scratch(work.size());
+
+    // Split the top of the tree here until there are enough independent
+    // subtrees for stealing to balance uneven quadrants
+    struct Subtree {
+        uint32_t node;
+        uint32_t begin, end;
+    };
+    std::vector<Subtree> frontier(1, Subtree{0, 0, static_cast<uint32_t>(work.size())});
+    const std::size_t target = static_cast<std::size_t>(pool.size()) * 8;
+
+    while (frontier.size() < target) {
+        std::vector<Subtree> next;
+        bool split = false;
+
+        for (const Subtree& s : frontier) {
+            uint32_t count = s.end - s.begin;
+            nodes[s.node].total = count;
+            if (count <= capacity || !canSplit(s.node)) {
+                next.push_back(s);
+                continue;
+            }
+
+            uint32_t offsets[5];
+            partition(s.node, work.data() + s.begin, work.data() + s.end,
+                      scratch.data() + s.begin, offsets);
+            uint32_t child = nodes[s.node].firstChild;
+            for (uint32_t q = 0; q < 4; q++) {
+                next.push_back(Subtree{child + q, s.begin + offsets[q], s.begin + offsets[q + 1]});
+            }
+            split = true;
+        }
+
+        frontier.swap(next);
+        if (!split) {
+            break;
+        }
+    }
+
+    // Build every subtree into a private arena in parallel
+    std::vector<QuadTree> parts;
+    parts.reserve(frontier.size());
+    for (const Subtree& s : frontier) {
+        // Limits are relative to this root, not the part's
+        parts.emplace_back(nodes[s.node].boundary);
+        QuadTree& part = parts.back();
+        part.trackLocations = false;
+        part.setCapacity(capacity);
+        part.splitRule = splitRule;
+        part.maxDepth = maxDepth - std::min(maxDepth, depthOf(s.node));
+        part.uneven = uneven;
+        part.minSplitWidth = minSplitWidth;
+        part.minSplitHeight = minSplitHeight;
+    }
+    pool.parallelFor(frontier.size(), [&](std::size_t i) {
+        const Subtree& s = frontier[i];
+        parts[i].build(0, work.data() + s.begin, work.data() + s.end, scratch.data() + s.begin);
+    });
+
+    // Reserve each part's place in the shared arena, then copy in parallel.
+    // A part's root reuses its frontier node, so only the rest is appended.
+    std::vector<uint32_t> nodeBase(parts.size()), slabBase(parts.size());
+    std::size_t nodeTotal = nodes.size();
+    std::size_t slabTotal = xs.size();
+    for (std::size_t i = 0; i < parts.size(); i++) {
+        nodeBase[i] = static_cast<uint32_t>(nodeTotal);
+        slabBase[i] = static_cast<uint32_t>(slabTotal);
+        nodeTotal += parts[i].nodes.size() - 1;
+        slabTotal += parts[i].xs.size();
+    }
+    nodes.resize(nodeTotal, QuadNode(Rectangle()));
+    xs.resize(slabTotal);
+    ys.resize(slabTotal);
+    ids.resize(slabTotal);
+    locations.assign(count, Location{NONE, 0});
+
+    pool.parallelFor(parts.size(), [&](std::size_t i) {
+        graft(frontier[i].node, parts[i], nodeBase[i], slabBase[i]);
+    });
+    if (lazySplit) {
+        workload.fitHeat(nodes.size());
+    }
+
+    // Overflow leaves are rare; record them here rather than lock the map
+    for (std::size_t i = 0; i < parts.size(); i++) {
+        uneven = uneven || parts[i].uneven;
+        for (const auto& leaf : parts[i].overflow) {
+            uint32_t k = leaf.first;
+            overflow[k == 0 ? frontier[i].node : nodeBase[i] + k - 1] = leaf.second;
+        }
+    }
+    QUADTREE_STAT(recountStructure());
+
+    nodes.shrink_to_fit();
+    xs.shrink_to_fit();
+    ys.shrink_to_fit();
+    ids.shrink_to_fit();
+    return work.size();
 }
 
 std::vector<QuadPoint> QuadTree::query(const Rectangle& range) const {
     std::vector<QuadPoint> result;
-    root->query(range, result);
+    query(range, result);
+    return result;
+}
+
+void QuadTree::query(const Rectangle& range, std::vector<QuadPoint>& result) const {
+    query(range, [&result](const QuadPoint& point) { result.push_back(point); });
+}
+
+std::vector<QuadPoint> QuadTree::queryRadius(const QuadPoint& center, float radius) const {
+    std::vector<QuadPoint> result;
+    queryRadius(center, radius, [&result](const QuadPoint& point) { result.push_back(point); });
+    return result;
+}
+
+std::vector<QuadPoint> QuadTree::nearest(const QuadPoint& center, std::size_t k) const {
+    std::vector<QuadPoint> result;
+    for (const Entry& entry : nearestEntries(center, k)) {
+        result.push_back(entry.point);
+    }
+    return result;
+}
+
+std::vector<QuadTree::Id> QuadTree::nearestIds(const QuadPoint& center, std::size_t k) const {
+    std::vector<Id> result;
+    for (const Entry& entry : nearestEntries(center, k)) {
+        result.push_back(entry.id);
+    }
+    return result;
+}
+
+std::vector<QuadTree::Entry> QuadTree::nearestEntries(const QuadPoint& center, std::size_t k) const {
+    std::vector<Entry> result;
+    if (k == 0 || nodes[0].total == 0) {
+        return result;
+    }
+
+    // Unexpanded nodes, closest first
+    typedef std::pair<float, uint32_t> NodeEntry;
+    std::priority_queue<NodeEntry, std::vector<NodeEntry>, std::greater<NodeEntry>> frontier;
+
+    // The best k points so far, farthest on top so it can be evicted
+    typedef std::pair<float, Entry> PointEntry;
+    auto fartherFirst = [](const PointEntry& a, const PointEntry& b) { return a.first < b.first; };
+    std::vector<PointEntry> best;
+    best.reserve(std::min(k, size()));
+
+    frontier.push(NodeEntry(nodes[0].boundary.distanceSquared(center), 0));
+    while (!frontier.empty()) {
+        NodeEntry top = frontier.top();
+        frontier.pop();
+
+        // Nothing left can be closer than the current k-th point
+        if (best.size() == k && top.first > best.front().first) {
+            break;
+        }
+
+        const QuadNode& node = nodes[top.second];
+        for (uint32_t i = 0; i < node.count; i++) {
+            QuadPoint point(xs[node.bucket + i], ys[node.bucket + i]);
+            float d = point.distanceSquared(center);
+            if (best.size() < k) {
+                best.emplace_back(d, Entry{point, ids[node.bucket + i]});
+                std::push_heap(best.begin(), best.end(), fartherFirst);
+            } else if (d < best.front().first) {
+                std::pop_heap(best.begin(), best.end(), fartherFirst);
+                best.back() = PointEntry(d, Entry{point, ids[node.bucket + i]});
+                std::push_heap(best.begin(), best.end(), fartherFirst);
+            }
+        }
+
+        if (node.divided()) {
+            for (uint32_t i = 0; i < 4; i++) {
+                const QuadNode& child = nodes[node.firstChild + i];
+                if (child.total == 0) {
+                    continue;
+                }
+                float d = child.boundary.distanceSquared(center);
+                if (best.size() < k || d <= best.front().first) {
+                    frontier.push(NodeEntry(d, node.firstChild + i));
+                }
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), fartherFirst);
+    result.reserve(best.size());
+    for (const PointEntry& entry : best) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+std::vector<std::vector<QuadPoint>> QuadTree::queryBatch(const Rectangle* ranges, std::size_t count,
+                                                         TaskPool& pool) const {
+    std::vector<std::vector<QuadPoint>> results(count);
+    pool.parallelFor(count, [&](std::size_t i) {
+        query(ranges[i], results[i]);
+    });
+    return results;
+}
+
+std::vector<std::vector<QuadPoint>> QuadTree::queryBatch(const std::vector<Rectangle>& ranges,
+                                                         TaskPool& pool) const {
+    return queryBatch(ranges.data(), ranges.size(), pool);
+}
+
+std::vector<QuadTree::Id> QuadTree::queryIds(const Rectangle& range) const {
+    std::vector<Id> result;
+    query(range, [&result](Id id, const QuadPoint&) { result.push_back(id); });
     return result;
 }
 
+std::size_t QuadTree::count(const Rectangle& range) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    std::size_t total = 0;
+
+    while (top > 0) {
+        const QuadNode& node = nodes[stack[--top]];
+
+        if (node.total == 0 || !node.boundary.intersects(range)) {
+            continue;
+        }
+
+        // Covered nodes answer from their cached subtree total
+        if (range.contains(node.boundary)) {
+            total += node.total;
+            continue;
+        }
+
+        if (node.count < FILTER_MIN) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                if (range.contains(QuadPoint(xs[node.bucket + i], ys[node.bucket + i]))) {
+                    total++;
+                }
+            }
+        } else {
+            uint32_t hits[FILTER_CHUNK];
+            for (uint32_t begin = 0; begin < node.count; begin += FILTER_CHUNK) {
+                uint32_t chunk = std::min(node.count - begin, FILTER_CHUNK);
+                total += RangeFilter::filter(xs.data() + node.bucket + begin,
+                                             ys.data() + node.bucket + begin, chunk, range, hits);
+            }
+        }
+
+        if (node.divided()) {
+            for (uint32_t i = 0; i < 4; i++) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+    return total;
+}
+
 std::vector<QuadPoint> QuadTree::getAllPoints() const {
-    return query(root->boundary);
+    return query(nodes[0].boundary);
 }
 
 std::vector<Rectangle> QuadTree::getBoundaries() const {
     std::vector<Rectangle> boundaries;
-    root->getBoundaries(boundaries);
+    getBoundaries(0, boundaries);
     return boundaries;
 }
 
+Rectangle QuadTree::leafBoundary(const QuadPoint& point) const {
+    uint32_t leaf = findLeaf(point);
+    return nodes[leaf == NONE ? 0 : leaf].boundary;
+}
+
 void QuadTree::clear() {
-    root = std::make_unique<QuadNode>(root->boundary);
+    Rectangle boundary = nodes[0].boundary;
+    nodes.clear();
+    xs.clear();
+    ys.clear();
+    ids.clear();
+    locations.clear();
+    freeSlabs.clear();
+    freeBlocks.clear();
+    overflow.clear();
+    nodes.emplace_back(boundary);
+    grownLevels = 0;
+    uneven = false;
+    updateSplitLimits();
+    workload.resetHeat();
+    QUADTREE_STAT(counters.resetStructure(capacity));
+}
+
+bool QuadTree::grow(Quadrant quadrant) {
+    // Nodes split under the old root sit one level deeper after this, so
+    // stop before they could outrun the traversal stacks
+    if (maxDepth + grownLevels >= MAX_DEPTH) {
+        return false;
+    }
+
+    // The old root must land exactly on the new root's quadrant split and
+    // far edges, or points on its edges would be routed to a sibling or
+    // fall outside the root
+    Rectangle old = nodes[0].boundary;
+    float x = (quadrant & 1) ? old.x - old.width : old.x;
+    float y = (quadrant & 2) ? old.y - old.height : old.y;
+    Rectangle bigger(x, y, old.width * 2.0f, old.height * 2.0f);
+    bool exactX = !(quadrant & 1) || (x + bigger.width / 2.0f == old.x && x + bigger.width == old.x + old.width);
+    bool exactY = !(quadrant & 2) || (y + bigger.height / 2.0f == old.y && y + bigger.height == old.y + old.height);
+    if (!std::isfinite(x + bigger.width) || !std::isfinite(y + bigger.height) || !exactX || !exactY) {
+        return false;
+    }
+
+    QuadNode root = nodes[0];
+#ifdef QUADTREE_STATS
+    // Everything moves down a level under a new root. createChildren()
+    // counts four children, one of which the old root already was.
+    std::copy_backward(counters.nodesByDepth.begin(), counters.nodesByDepth.end() - 1,
+                       counters.nodesByDepth.end());
+    counters.nodesByDepth[0] = 1;
+    counters.nodesByDepth[1]--;
+#endif
+    nodes[0] = QuadNode(bigger);
+    createChildren(0, Split{old.width, old.height});
+
+    uint32_t slot = nodes[0].firstChild + quadrant;
+    nodes[slot] = root;
+    nodes[slot].parent = 0;
+    nodes[0].total = root.total;
+    adopt(slot, 0);
+
+    grownLevels++;
+    updateSplitLimits();
+    return true;
+}
+
+bool QuadTree::shrink(Quadrant quadrant) {
+    QuadNode& root = nodes[0];
+    if (!root.divided()) {
+        // A leaf root shrinks in place if its points all fit
+        const Rectangle& b = root.boundary;
+        float w = b.width / 2.0f;
+        float h = b.height / 2.0f;
+        Rectangle smaller((quadrant & 1) ? b.x + w : b.x, (quadrant & 2) ? b.y + h : b.y, w, h);
+
+        // Never down to a root that could not split, or repeated shrinks of
+        // an empty tree would squeeze it to nothing
+        if (!(w >= 2.0f * minCellSize) || !(smaller.x + w / 2.0f > smaller.x) ||
+            !(smaller.y + h / 2.0f > smaller.y)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < root.count; i++) {
+            if (!smaller.contains(QuadPoint(xs[root.bucket + i], ys[root.bucket + i]))) {
+                return false;
+            }
+        }
+        root.boundary = smaller;
+        grownLevels = grownLevels > 0 ? grownLevels - 1 : 0;
+        updateSplitLimits();
+        return true;
+    }
+
+    uint32_t block = root.firstChild;
+    for (uint32_t q = 0; q < 4; q++) {
+        if (q != quadrant && nodes[block + q].total != 0) {
+            return false;
+        }
+    }
+
+    // The three siblings are empty, but may still be divided, as grow()
+    // leaves them; free them down to bare leaves
+    for (uint32_t q = 0; q < 4; q++) {
+        if (q != quadrant) {
+            prune(block + q);
+        }
+    }
+    uint32_t slot = block + quadrant;
+    nodes[0] = nodes[slot];
+    nodes[0].parent = NONE;
+    adopt(0, slot);
+    freeBlocks.push_back(block);
+#ifdef QUADTREE_STATS
+    std::copy(counters.nodesByDepth.begin() + 2, counters.nodesByDepth.end(), counters.nodesByDepth.begin() + 1);
+    counters.nodesByDepth.back() = 0;
+    counters.leavesByOccupancy[0] -= 3;
+#endif
+
+    grownLevels = grownLevels > 0 ? grownLevels - 1 : 0;
+    updateSplitLimits();
+    return true;
+}
+
+bool QuadTree::expandToInclude(const QuadPoint& point) {
+    if (!std::isfinite(point.x) || !std::isfinite(point.y)) {
+        return false;
+    }
+    // Grow away from the old root towards the point, one doubling at a time
+    while (!nodes[0].boundary.contains(point)) {
+        const Rectangle& b = nodes[0].boundary;
+        uint32_t quadrant = (point.x < b.x ? 1 : 0) + (point.y < b.y ? 2 : 0);
+        if (!grow(static_cast<Quadrant>(quadrant))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool QuadTree::expandToInclude(const Rectangle& area) {
+    if (!std::isfinite(area.x) || !std::isfinite(area.y) || !std::isfinite(area.width) ||
+        !std::isfinite(area.height)) {
+        return false;
+    }
+    while (!nodes[0].boundary.contains(area)) {
+        const Rectangle& b = nodes[0].boundary;
+        uint32_t quadrant = (area.x < b.x ? 1 : 0) + (area.y < b.y ? 2 : 0);
+        if (!grow(static_cast<Quadrant>(quadrant))) {
+            return false;
+        }
+    }
+    return true;
 }
 
 Rectangle QuadTree::getBoundary() const {
-    return root->boundary;
+    return nodes[0].boundary;
 }
 
-// QuadNode implementation
-bool QuadTree::QuadNode::insert(const QuadPoint& point) {
-    // Check if point is within this node's boundary
-    if (!boundary.contains(point)) {
+bool QuadTree::setCapacity(uint32_t points) {
+    if (points == 0 || points > MAX_CAPACITY) {
         return false;
     }
-    
-    // If we haven't reached capacity and haven't divided, add point here
-    if (points.size() < CAPACITY && !divided) {
-        points.push_back(point);
-        return true;
+    capacity = points;
+    mergeThreshold = points / 2;
+    relayout();
+    return true;
+}
+
+void QuadTree::setLazySplit(bool enabled) {
+    lazySplit = enabled;
+    if (enabled) {
+        workload.fitHeat(nodes.size());
+    } else {
+        splitDeferred(false);
+        workload.heat.reset();
+        workload.heatSize = 0;
     }
-    
-    // If we haven't subdivided yet, do it now
-    if (!divided) {
-        subdivide();
-        
-        // Move existing points to appropriate quadrants
-        std::vector<QuadPoint> pointsToMove = points;
-        points.clear();
-        
-        for (const QuadPoint& p : pointsToMove) {
-            if (!northwest->insert(p)) {
-                if (!northeast->insert(p)) {
-                    if (!southwest->insert(p)) {
-                        southeast->insert(p);
-                    }
-                }
+}
+
+void QuadTree::setAutoTune(bool enabled) {
+    autoTune = enabled;
+    workload.resetCounts();
+}
+
+bool QuadTree::save(const std::string& path) const {
+    namespace Snapshot = QuadTreeSnapshot;
+
+    // Renumber breadth-first, which keeps each node's children together,
+    // and give every leaf the next packed run of points
+    std::vector<uint32_t> order(1, 0);
+    std::vector<Snapshot::Node> records;
+    records.reserve(nodeCount());
+    uint32_t points = 0;
+    for (std::size_t i = 0; i < order.size(); i++) {
+        const QuadNode& node = nodes[order[i]];
+        Snapshot::Node record = {node.boundary.x, node.boundary.y, node.boundary.width,
+                                 node.boundary.height, Snapshot::NONE, points, node.count, node.total};
+        if (node.divided()) {
+            record.firstChild = static_cast<uint32_t>(order.size());
+            for (uint32_t q = 0; q < 4; q++) {
+                order.push_back(node.firstChild + q);
+            }
+        }
+        points += node.count;
+        records.push_back(record);
+    }
+
+    auto align = [](uint64_t offset) {
+        return (offset + Snapshot::ALIGNMENT - 1) / Snapshot::ALIGNMENT * Snapshot::ALIGNMENT;
+    };
+    Snapshot::Header header = {};
+    std::copy(Snapshot::MAGIC, Snapshot::MAGIC + sizeof(header.magic), header.magic);
+    header.version = Snapshot::VERSION;
+    header.byteOrder = Snapshot::BYTE_ORDER_MARK;
+    header.x = nodes[0].boundary.x;
+    header.y = nodes[0].boundary.y;
+    header.width = nodes[0].boundary.width;
+    header.height = nodes[0].boundary.height;
+    header.nodeCount = records.size();
+    header.pointCount = points;
+    header.nodesOffset = align(sizeof(header));
+    header.xsOffset = align(header.nodesOffset + records.size() * sizeof(Snapshot::Node));
+    header.ysOffset = align(header.xsOffset + points * sizeof(float));
+    header.idsOffset = align(header.ysOffset + points * sizeof(float));
+    header.fileSize = header.idsOffset + points * sizeof(Id);
+
+    std::string temporary = path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    uint64_t written = 0;
+    auto write = [&](const void* data, uint64_t bytes) {
+        out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes));
+        written += bytes;
+    };
+    auto padTo = [&](uint64_t offset) {
+        const char zeros[Snapshot::ALIGNMENT] = {};
+        write(zeros, offset - written);
+    };
+
+    // Point arrays are streamed from the slabs leaf by leaf, in the order
+    // the runs were assigned, so they are never copied in memory
+    auto writeLeaves = [&](const auto& array) {
+        for (uint32_t index : order) {
+            const QuadNode& node = nodes[index];
+            if (node.count > 0) {
+                write(array.data() + node.bucket, node.count * sizeof(array[0]));
+            }
+        }
+    };
+    write(&header, sizeof(header));
+    padTo(header.nodesOffset);
+    write(records.data(), records.size() * sizeof(Snapshot::Node));
+    padTo(header.xsOffset);
+    writeLeaves(xs);
+    padTo(header.ysOffset);
+    writeLeaves(ys);
+    padTo(header.idsOffset);
+    writeLeaves(ids);
+
+    out.close();
+    if (!out || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::size_t QuadTree::memoryUsage() const {
+    return nodes.capacity() * sizeof(QuadNode) +
+           (xs.capacity() + ys.capacity()) * sizeof(float) + ids.capacity() * sizeof(Id) +
+           locations.capacity() * sizeof(Location) +
+           (freeSlabs.capacity() + freeBlocks.capacity()) * sizeof(uint32_t) +
+           overflow.size() * sizeof(std::pair<const uint32_t, uint32_t>) +
+           overflow.bucket_count() * sizeof(void*);
+}
+
+QuadTreeStats QuadTree::stats() const {
+    QuadTreeStats result;
+    result.points = size();
+    result.nodes = nodeCount();
+#ifdef QUADTREE_STATS
+    result.enabled = true;
+    std::size_t depths = counters.nodesByDepth.size();
+    while (depths > 1 && counters.nodesByDepth[depths - 1] == 0) {
+        depths--;
+    }
+    result.nodesByDepth.assign(counters.nodesByDepth.begin(), counters.nodesByDepth.begin() + depths);
+    result.leavesByOccupancy.assign(counters.leavesByOccupancy.begin(), counters.leavesByOccupancy.end());
+    for (std::size_t leaves : result.leavesByOccupancy) {
+        result.leaves += leaves;
+    }
+    result.queries = counters.queries.load(std::memory_order_relaxed);
+    result.nodesVisited = counters.nodesVisited.load(std::memory_order_relaxed);
+    result.pointsTested = counters.pointsTested.load(std::memory_order_relaxed);
+    result.pointsReturned = counters.pointsReturned.load(std::memory_order_relaxed);
+    result.insertLatency = counters.insertLatency.snapshot();
+    result.queryLatency = counters.queryLatency.snapshot();
+#endif
+    return result;
+}
+
+void QuadTree::resetStats() {
+    QUADTREE_STAT(counters.resetWorkload());
+}
+
+QuadTree::Workload& QuadTree::Workload::operator=(const Workload& other) {
+    if (this != &other) {
+        heat.reset();
+        heatSize = 0;
+        fitHeat(other.heatSize);
+        for (std::size_t i = 0; i < other.heatSize; i++) {
+            heat[i].store(other.heat[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+    queries.store(other.queries.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    inserts = other.inserts;
+    return *this;
+}
+
+void QuadTree::Workload::fitHeat(std::size_t count) {
+    if (count <= heatSize) {
+        return;
+    }
+    std::size_t size = std::max(count, 2 * heatSize);
+    std::unique_ptr<std::atomic<uint32_t>[]> grown(new std::atomic<uint32_t>[size]);
+    for (std::size_t i = 0; i < size; i++) {
+        grown[i].store(i < heatSize ? heat[i].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+    }
+    heat = std::move(grown);
+    heatSize = size;
+}
+
+void QuadTree::Workload::resetHeat() {
+    for (std::size_t i = 0; i < heatSize; i++) {
+        heat[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void QuadTree::Workload::resetCounts() {
+    queries.store(0, std::memory_order_relaxed);
+    inserts = 0;
+}
+
+#ifdef QUADTREE_STATS
+// Instrumentation
+QuadTree::Counters& QuadTree::Counters::operator=(const Counters& other) {
+    nodesByDepth = other.nodesByDepth;
+    leavesByOccupancy = other.leavesByOccupancy;
+    queries.store(other.queries.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    nodesVisited.store(other.nodesVisited.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    pointsTested.store(other.pointsTested.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    pointsReturned.store(other.pointsReturned.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    insertLatency = other.insertLatency;
+    queryLatency = other.queryLatency;
+    return *this;
+}
+
+void QuadTree::Counters::resetStructure(uint32_t capacity) {
+    nodesByDepth.fill(0);
+    leavesByOccupancy.assign(capacity + 2, 0);
+    nodesByDepth[0] = 1;
+    leavesByOccupancy[0] = 1;
+}
+
+void QuadTree::Counters::resetWorkload() {
+    queries.store(0, std::memory_order_relaxed);
+    nodesVisited.store(0, std::memory_order_relaxed);
+    pointsTested.store(0, std::memory_order_relaxed);
+    pointsReturned.store(0, std::memory_order_relaxed);
+    insertLatency.reset();
+    queryLatency.reset();
+}
+
+QuadTree::QueryProbe::~QueryProbe() {
+    counters.queries.fetch_add(1, std::memory_order_relaxed);
+    counters.nodesVisited.fetch_add(nodes, std::memory_order_relaxed);
+    counters.pointsTested.fetch_add(tested, std::memory_order_relaxed);
+    counters.pointsReturned.fetch_add(returned, std::memory_order_relaxed);
+    counters.queryLatency.record(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count()));
+}
+
+void QuadTree::recountStructure() {
+    counters.nodesByDepth.fill(0);
+    counters.leavesByOccupancy.assign(capacity + 2, 0);
+    std::pair<uint32_t, uint32_t> stack[MAX_STACK];  // Node, depth
+    int top = 0;
+    stack[top++] = std::make_pair(0u, 0u);
+    while (top > 0) {
+        std::pair<uint32_t, uint32_t> entry = stack[--top];
+        const QuadNode& node = nodes[entry.first];
+        counters.nodesByDepth[entry.second]++;
+        if (node.divided()) {
+            for (uint32_t i = 0; i < 4; i++) {
+                stack[top++] = std::make_pair(node.firstChild + i, entry.second + 1);
             }
+        } else {
+            countLeaf(node.count, 1);
+        }
+    }
+}
+#endif
+
+// Workload tuning
+bool QuadTree::queriedOften(uint32_t nodeIndex) const {
+    return nodeIndex < workload.heatSize &&
+           workload.heat[nodeIndex].load(std::memory_order_relaxed) >= LAZY_SPLIT_SCANS;
+}
+
+bool QuadTree::splitDue(uint32_t nodeIndex) const {
+    return queriedOften(nodeIndex) || nodes[nodeIndex].count >= capacity * LAZY_SPLIT_LIMIT;
+}
+
+std::size_t QuadTree::splitDeferred(bool hotOnly) {
+    // Every leaf over the capacity has an overflow run. Splitting one only
+    // adds nodes, so the others keep their indices.
+    std::vector<uint32_t> leaves;
+    leaves.reserve(overflow.size());
+    for (const auto& leaf : overflow) {
+        leaves.push_back(leaf.first);
+    }
+    std::size_t split = 0;
+    for (uint32_t index : leaves) {
+        if (nodes[index].divided() || nodes[index].count <= capacity || !canSplit(index) ||
+            (hotOnly && !splitDue(index))) {
+            continue;
+        }
+        subdivide(index);
+        split++;
+    }
+    return split;
+}
+
+void QuadTree::relayout() {
+    // Slabs are sized by the capacity, so every point moves to a new one
+    std::vector<Entry> work;
+    work.reserve(size());
+    for (Id id = 0; id < locations.size(); id++) {
+        if (locations[id].node != NONE) {
+            work.push_back(Entry{position(id), id});
+        }
+    }
+    std::size_t idCount = locations.size();
+    clear();
+    locations.assign(idCount, Location{NONE, 0});
+    std::vector<Entry> scratch(work.size());
+    build(0, work.data(), work.data() + work.size(), scratch.data());
+}
+
+void QuadTree::tune() {
+    // Splits dominate insert cost, so inserts get cheaper the larger the
+    // leaves. Queries are fastest around 64 points per leaf (bench_capacity),
+    // where the scan of a leaf still costs less than the node hops it
+    // saves. Slide from 256 for pure inserts down to 64 as queries take
+    // over, a power of two at a time.
+    uint64_t queries = workload.queries.exchange(0, std::memory_order_relaxed);
+    double share = static_cast<double>(queries) / static_cast<double>(queries + workload.inserts);
+    workload.inserts = 0;
+    uint32_t chosen = 1u << static_cast<int>(std::lround(8.0 - 2.0 * share));
+    if (chosen != capacity) {
+        setCapacity(chosen);
+    }
+}
+
+// Arena helpers
+std::vector<QuadTree::Entry> QuadTree::collect(const QuadPoint* points, std::size_t count) const {
+    std::vector<Entry> work;
+    work.reserve(count);
+    for (std::size_t i = 0; i < count; i++) {
+        if (nodes[0].boundary.contains(points[i])) {
+            work.push_back(Entry{points[i], static_cast<Id>(i)});
+        }
+    }
+    return work;
+}
+
+void QuadTree::erase(uint32_t leafIndex, uint32_t slot) {
+    removeFromLeaf(leafIndex, slot);
+    for (uint32_t index = leafIndex; index != NONE; index = nodes[index].parent) {
+        nodes[index].total--;
+    }
+    mergeUp(nodes[leafIndex].parent, NONE);
+}
+
+void QuadTree::move(uint32_t leafIndex, uint32_t slot, const QuadPoint& to) {
+    // Still in the same leaf: overwrite in place
+    QuadNode& leaf = nodes[leafIndex];
+    if (leaf.boundary.contains(to)) {
+        xs[leaf.bucket + slot] = to.x;
+        ys[leaf.bucket + slot] = to.y;
+        return;
+    }
+
+    // Walk up to the lowest common ancestor, taking the point out of every
+    // subtree total below it; totals from the ancestor up do not change
+    Id id = ids[leaf.bucket + slot];
+    removeFromLeaf(leafIndex, slot);
+    uint32_t ancestor = leafIndex;
+    while (!nodes[ancestor].boundary.contains(to)) {
+        nodes[ancestor].total--;
+        ancestor = nodes[ancestor].parent;
+    }
+
+    mergeUp(nodes[leafIndex].parent, ancestor);
+    nodes[ancestor].total--;
+    insertFrom(ancestor, to, id);
+}
+
+void QuadTree::insertFrom(uint32_t nodeIndex, const QuadPoint& point, Id id) {
+    // Walk down to the leaf whose quadrant holds the point, counting the
+    // point into every subtree total on the way
+    uint32_t index = nodeIndex;
+    for (;;) {
+        const QuadNode& node = nodes[index];
+
+        if (node.divided()) {
+            nodes[index].total++;
+            index = childFor(node, point);
+            continue;
+        }
+
+        // If we haven't reached capacity, or the leaf may not split any
+        // further (or, splitting lazily, not yet), add point here
+        if (node.count < capacity || !canSplit(index) || (lazySplit && !splitDue(index))) {
+            nodes[index].total++;
+            reserveLeaf(index, node.count + 1);
+            addToLeaf(index, point, id);
+            return;
+        }
+
+        // Full leaf: split it and keep descending
+        subdivide(index);
+    }
+}
+
+uint32_t QuadTree::findLeaf(const QuadPoint& point) const {
+    if (!nodes[0].boundary.contains(point)) {
+        return NONE;
+    }
+
+    uint32_t index = 0;
+    while (nodes[index].divided()) {
+        index = childFor(nodes[index], point);
+    }
+    return index;
+}
+
+uint32_t QuadTree::findSlot(uint32_t leafIndex, const QuadPoint& point) const {
+    const QuadNode& leaf = nodes[leafIndex];
+    for (uint32_t i = 0; i < leaf.count; i++) {
+        if (xs[leaf.bucket + i] == point.x && ys[leaf.bucket + i] == point.y) {
+            return i;
+        }
+    }
+    return NONE;
+}
+
+void QuadTree::removeFromLeaf(uint32_t leafIndex, uint32_t slot) {
+    // Order within a slab does not matter, so fill the hole with the last point
+    QuadNode& leaf = nodes[leafIndex];
+    uint32_t last = leaf.count - 1;
+    if (trackLocations) {
+        locations[ids[leaf.bucket + slot]].node = NONE;
+        locations[ids[leaf.bucket + last]].slot = slot;
+    }
+    xs[leaf.bucket + slot] = xs[leaf.bucket + last];
+    ys[leaf.bucket + slot] = ys[leaf.bucket + last];
+    ids[leaf.bucket + slot] = ids[leaf.bucket + last];
+    QUADTREE_STAT(countLeaf(leaf.count, -1); countLeaf(leaf.count - 1, 1));
+    leaf.count--;
+
+    if (leaf.count == 0) {
+        releaseRun(leaf.bucket, leafCapacity(leafIndex));
+        overflow.erase(leafIndex);
+        leaf.bucket = NONE;
+    } else if (leaf.count <= mergeThreshold && leafCapacity(leafIndex) > capacity) {
+        // Same hysteresis as merging, so an overflow leaf at the slab size
+        // does not move back and forth
+        shrinkLeaf(leafIndex);
+    }
+}
+
+void QuadTree::mergeUp(uint32_t nodeIndex, uint32_t stop) {
+    // Totals only grow towards the root, so the first ancestor that is not
+    // underfull ends the walk
+    for (uint32_t index = nodeIndex; index != stop && index != NONE; index = nodes[index].parent) {
+        if (nodes[index].total > mergeThreshold) {
+            return;
+        }
+        collapse(index);
+    }
+}
+
+void QuadTree::adopt(uint32_t nodeIndex, uint32_t from) {
+    QuadNode& node = nodes[nodeIndex];
+    if (node.divided()) {
+        for (uint32_t q = 0; q < 4; q++) {
+            nodes[node.firstChild + q].parent = nodeIndex;
+        }
+        return;
+    }
+    if (trackLocations) {
+        for (uint32_t i = 0; i < node.count; i++) {
+            locations[ids[node.bucket + i]].node = nodeIndex;
+        }
+    }
+    auto found = overflow.find(from);
+    if (found != overflow.end()) {
+        uint32_t room = found->second;
+        overflow.erase(found);
+        overflow[nodeIndex] = room;
+    }
+}
+
+void QuadTree::collapse(uint32_t nodeIndex) {
+    // Children are usually underfull leaves, collapsed on the way up, but
+    // grow() puts the old root's subtree under a new root whatever its
+    // total, so the whole subtree is gathered
+    uint32_t child = nodes[nodeIndex].firstChild;
+    nodes[nodeIndex].firstChild = NONE;
+    nodes[nodeIndex].total = 0;
+    QUADTREE_STAT(counters.nodesByDepth[depthOf(nodeIndex) + 1] -= 4; countLeaf(0, 1));
+
+    for (uint32_t q = 0; q < 4; q++) {
+        absorb(nodeIndex, child + q);
+    }
+    freeBlocks.push_back(child);
+}
+
+void QuadTree::absorb(uint32_t nodeIndex, uint32_t from) {
+    if (nodes[from].divided()) {
+        uint32_t child = nodes[from].firstChild;
+        for (uint32_t q = 0; q < 4; q++) {
+            absorb(nodeIndex, child + q);
+        }
+        freeBlocks.push_back(child);
+        QUADTREE_STAT(counters.nodesByDepth[depthOf(from) + 1] -= 4);
+        return;
+    }
+
+    // Slots freed here are only handed out after the copy
+    const QuadNode& leaf = nodes[from];
+    QUADTREE_STAT(countLeaf(leaf.count, -1));
+    for (uint32_t i = 0; i < leaf.count; i++) {
+        QuadPoint p(xs[leaf.bucket + i], ys[leaf.bucket + i]);
+        nodes[nodeIndex].total++;
+        addToLeaf(nodeIndex, p, ids[leaf.bucket + i]);
+    }
+    if (leaf.bucket != NONE) {
+        releaseRun(leaf.bucket, leafCapacity(from));
+        overflow.erase(from);
+    }
+}
+
+void QuadTree::prune(uint32_t nodeIndex) {
+    QuadNode& node = nodes[nodeIndex];
+    if (node.bucket != NONE) {
+        releaseRun(node.bucket, leafCapacity(nodeIndex));
+        overflow.erase(nodeIndex);
+        node.bucket = NONE;
+    }
+    if (!node.divided()) {
+        return;
+    }
+
+    uint32_t child = node.firstChild;
+    for (uint32_t q = 0; q < 4; q++) {
+        prune(child + q);
+    }
+    nodes[nodeIndex].firstChild = NONE;
+    freeBlocks.push_back(child);
+    QUADTREE_STAT(counters.nodesByDepth[depthOf(nodeIndex) + 1] -= 4; countLeaf(0, -4); countLeaf(0, 1));
+}
+
+uint32_t QuadTree::childFor(const QuadNode& node, const QuadPoint& point) const {
+    // Children are laid out NW, NE, SW, SE, so the quadrant index is
+    // (east ? 1 : 0) + (south ? 2 : 0). Compare against the children's own
+    // edges so the split matches their boundaries exactly.
+    uint32_t child = node.firstChild;
+    uint32_t east = point.x >= nodes[child + 1].boundary.x ? 1 : 0;
+    uint32_t south = point.y >= nodes[child + 2].boundary.y ? 2 : 0;
+    return child + east + south;
+}
+
+void QuadTree::addToLeaf(uint32_t nodeIndex, const QuadPoint& point, Id id) {
+    if (nodes[nodeIndex].bucket == NONE) {
+        uint32_t slab = allocateSlab();
+        nodes[nodeIndex].bucket = slab;
+    }
+
+    QuadNode& node = nodes[nodeIndex];
+    xs[node.bucket + node.count] = point.x;
+    ys[node.bucket + node.count] = point.y;
+    ids[node.bucket + node.count] = id;
+    if (trackLocations) {
+        locations[id] = Location{nodeIndex, node.count};
+    }
+    QUADTREE_STAT(countLeaf(node.count, -1); countLeaf(node.count + 1, 1));
+    node.count++;
+}
+
+uint32_t QuadTree::depthOf(uint32_t nodeIndex) const {
+    uint32_t depth = 0;
+    for (uint32_t index = nodes[nodeIndex].parent; index != NONE; index = nodes[index].parent) {
+        depth++;
+    }
+    return depth;
+}
+
+bool QuadTree::canSplit(uint32_t nodeIndex) const {
+    // The last two checks catch cells so small that halving them no longer
+    // moves the split line, whatever the limits allow
+    const Rectangle& b = nodes[nodeIndex].boundary;
+    if (b.width < minSplitWidth || b.height < minSplitHeight || !(b.x + b.width / 2.0f > b.x) ||
+        !(b.y + b.height / 2.0f > b.y)) {
+        return false;
+    }
+    // Off-center splits can keep a wide child many levels down
+    return !(uneven || splitRule == SPLIT_CENTROID) || depthOf(nodeIndex) < maxDepth;
+}
+
+uint32_t QuadTree::leafCapacity(uint32_t nodeIndex) const {
+    if (overflow.empty()) {
+        return capacity;
+    }
+    auto found = overflow.find(nodeIndex);
+    return found == overflow.end() ? capacity : found->second;
+}
+
+void QuadTree::reserveLeaf(uint32_t nodeIndex, uint32_t points) {
+    uint32_t room = leafCapacity(nodeIndex);
+    if (points <= room) {
+        return;
+    }
+
+    // Doubling keeps a leaf that fills one point at a time at O(1) moves
+    // per point; a batch may need more than that at once
+    uint32_t length = std::max(2 * room, (points + capacity - 1) / capacity * capacity);
+    uint32_t run = allocateRun(length);
+
+    // Slots keep their offsets, so locations stay valid
+    QuadNode& leaf = nodes[nodeIndex];
+    if (leaf.bucket != NONE) {
+        std::copy(xs.begin() + leaf.bucket, xs.begin() + leaf.bucket + leaf.count, xs.begin() + run);
+        std::copy(ys.begin() + leaf.bucket, ys.begin() + leaf.bucket + leaf.count, ys.begin() + run);
+        std::copy(ids.begin() + leaf.bucket, ids.begin() + leaf.bucket + leaf.count, ids.begin() + run);
+        releaseRun(leaf.bucket, room);
+    }
+    leaf.bucket = run;
+    overflow[nodeIndex] = length;
+}
+
+void QuadTree::shrinkLeaf(uint32_t nodeIndex) {
+    uint32_t room = leafCapacity(nodeIndex);
+    uint32_t slab = allocateSlab();
+
+    QuadNode& leaf = nodes[nodeIndex];
+    std::copy(xs.begin() + leaf.bucket, xs.begin() + leaf.bucket + leaf.count, xs.begin() + slab);
+    std::copy(ys.begin() + leaf.bucket, ys.begin() + leaf.bucket + leaf.count, ys.begin() + slab);
+    std::copy(ids.begin() + leaf.bucket, ids.begin() + leaf.bucket + leaf.count, ids.begin() + slab);
+    releaseRun(leaf.bucket, room);
+    leaf.bucket = slab;
+    overflow.erase(nodeIndex);
+}
+
+uint32_t QuadTree::allocateRun(uint32_t length) {
+    uint32_t run = static_cast<uint32_t>(xs.size());
+    xs.resize(xs.size() + length);
+    ys.resize(ys.size() + length);
+    ids.resize(ids.size() + length);
+    return run;
+}
+
+void QuadTree::releaseRun(uint32_t bucket, uint32_t length) {
+    // A run is whole slabs, so ordinary leaves can reuse it piecewise
+    for (uint32_t offset = 0; offset < length; offset += capacity) {
+        freeSlabs.push_back(bucket + offset);
+    }
+}
+
+uint32_t QuadTree::allocateSlab() {
+    if (!freeSlabs.empty()) {
+        uint32_t slab = freeSlabs.back();
+        freeSlabs.pop_back();
+        return slab;
+    }
+
+    return allocateRun(capacity);
+}
+
+void QuadTree::subdivide(uint32_t nodeIndex) {
+    if (nodes[nodeIndex].count > capacity) {
+        subdivideOverflow(nodeIndex);
+        return;
+    }
+    createChildren(nodeIndex, leafSplit(nodeIndex));
+
+    // Move existing points to appropriate quadrants and release the slab
+    uint32_t slab = nodes[nodeIndex].bucket;
+    uint32_t count = nodes[nodeIndex].count;
+    nodes[nodeIndex].bucket = NONE;
+    nodes[nodeIndex].count = 0;
+
+    if (slab == NONE) {
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        QuadPoint p(xs[slab + i], ys[slab + i]);
+        uint32_t target = childFor(nodes[nodeIndex], p);
+        nodes[target].total++;
+        addToLeaf(target, p, ids[slab + i]);
+    }
+    freeSlabs.push_back(slab);
+}
+
+void QuadTree::subdivideOverflow(uint32_t nodeIndex) {
+    // Reached once shrink() has loosened the limits under an overflow leaf,
+    // or a lazily split leaf is due. Its points may all fall in one child,
+    // so they are reinserted, which splits as deep as they need.
+    uint32_t run = nodes[nodeIndex].bucket;
+    uint32_t count = nodes[nodeIndex].count;
+    uint32_t room = leafCapacity(nodeIndex);
+    bool queried = queriedOften(nodeIndex);
+    createChildren(nodeIndex, leafSplit(nodeIndex));
+    overflow.erase(nodeIndex);
+    nodes[nodeIndex].bucket = NONE;
+    nodes[nodeIndex].count = 0;
+    nodes[nodeIndex].total -= count;
+
+    // A lazily split leaf that queries made due splits all the way down,
+    // since queries there are what it was waiting for; one that only grew
+    // too large splits a level
+    bool lazy = lazySplit;
+    lazySplit = lazy && !queried;
+    for (uint32_t i = 0; i < count; i++) {
+        insertFrom(nodeIndex, QuadPoint(xs[run + i], ys[run + i]), ids[run + i]);
+    }
+    lazySplit = lazy;
+    releaseRun(run, room);
+}
+
+QuadTree::Split QuadTree::splitAt(const Rectangle& boundary, double sumX, double sumY, uint32_t count) const {
+    Split half = {boundary.width / 2.0f, boundary.height / 2.0f};
+    if (splitRule == SPLIT_MIDPOINT || count == 0) {
+        return half;
+    }
+
+    // Each axis falls back to halving when the mean sits on the west or
+    // north edge (every point shares that coordinate), which would leave a
+    // column or row of empty children
+    Split split = {static_cast<float>(sumX / count) - boundary.x, static_cast<float>(sumY / count) - boundary.y};
+    if (!(boundary.x + split.west > boundary.x) || !(split.west < boundary.width)) {
+        split.west = half.west;
+    }
+    if (!(boundary.y + split.north > boundary.y) || !(split.north < boundary.height)) {
+        split.north = half.north;
+    }
+    return split;
+}
+
+QuadTree::Split QuadTree::leafSplit(uint32_t nodeIndex) const {
+    const QuadNode& leaf = nodes[nodeIndex];
+    double sumX = 0.0, sumY = 0.0;
+    if (splitRule == SPLIT_CENTROID) {
+        for (uint32_t i = 0; i < leaf.count; i++) {
+            sumX += xs[leaf.bucket + i];
+            sumY += ys[leaf.bucket + i];
         }
     }
-    
-    // Try to insert into appropriate quadrant
-    if (northwest->insert(point)) return true;
-    if (northeast->insert(point)) return true;
-    if (southwest->insert(point)) return true;
-    if (southeast->insert(point)) return true;
-    
-    return false;
+    return splitAt(leaf.boundary, sumX, sumY, leaf.count);
 }
 
-void QuadTree::QuadNode::subdivide() {
+void QuadTree::createChildren(uint32_t nodeIndex, const Split& split) {
+    Rectangle boundary = nodes[nodeIndex].boundary;
     float x = boundary.x;
     float y = boundary.y;
-    float w = boundary.width / 2.0f;
-    float h = boundary.height / 2.0f;
-    
-    northwest = std::make_unique<QuadNode>(Rectangle(x, y, w, h));
-    northeast = std::make_unique<QuadNode>(Rectangle(x + w, y, w, h));
-    southwest = std::make_unique<QuadNode>(Rectangle(x, y + h, w, h));
-    southeast = std::make_unique<QuadNode>(Rectangle(x + w, y + h, w, h));
-    
-    divided = true;
-}
-
-void QuadTree::QuadNode::query(const Rectangle& range, std::vector<QuadPoint>& result) const {
-    // Check if range intersects with this node's boundary
-    if (!boundary.intersects(range)) {
+    float w = split.west;
+    float h = split.north;
+    float e = boundary.width - w;
+    float s = boundary.height - h;
+    uneven = uneven || e != w || s != h;
+
+    // Allocate all four siblings together, reusing a block freed by a merge
+    // when there is one. Growing may reallocate the arena, so no references
+    // into it are held across this.
+    uint32_t child;
+    if (!freeBlocks.empty()) {
+        child = freeBlocks.back();
+        freeBlocks.pop_back();
+    } else {
+        child = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 4, QuadNode(boundary));
+    }
+    nodes[child] = QuadNode(Rectangle(x, y, w, h));
+    nodes[child + 1] = QuadNode(Rectangle(x + w, y, e, h));
+    nodes[child + 2] = QuadNode(Rectangle(x, y + h, w, s));
+    nodes[child + 3] = QuadNode(Rectangle(x + w, y + h, e, s));
+    for (uint32_t q = 0; q < 4; q++) {
+        nodes[child + q].parent = nodeIndex;
+    }
+    nodes[nodeIndex].firstChild = child;
+    if (workload.heat) {
+        // New leaves, and blocks reused from a merge, start cold, as does
+        // this node should it collapse back into a leaf. Keyed on the heat
+        // array rather than lazySplit, which subdivideOverflow() turns off
+        // while it reinserts.
+        workload.fitHeat(nodes.size());
+        workload.heat[nodeIndex].store(0, std::memory_order_relaxed);
+        for (uint32_t q = 0; q < 4; q++) {
+            workload.heat[child + q].store(0, std::memory_order_relaxed);
+        }
+    }
+    QUADTREE_STAT(counters.nodesByDepth[depthOf(nodeIndex) + 1] += 4; countLeaf(nodes[nodeIndex].count, -1);
+                  countLeaf(0, 4));
+}
+
+// Recursive helpers
+void QuadTree::getBoundaries(uint32_t nodeIndex, std::vector<Rectangle>& boundaries) const {
+    const QuadNode& node = nodes[nodeIndex];
+    boundaries.push_back(node.boundary);
+
+    if (node.divided()) {
+        for (uint32_t i = 0; i < 4; i++) {
+            getBoundaries(node.firstChild + i, boundaries);
+        }
+    }
+}
+
+void QuadTree::build(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch) {
+    uint32_t count = static_cast<uint32_t>(end - begin);
+    nodes[nodeIndex].total = count;
+
+    // Small enough to be a leaf: store the points in one slab. A node that
+    // may not split takes any number of points in one overflow run.
+    if (count <= capacity || !canSplit(nodeIndex)) {
+        if (count > capacity) {
+            uint32_t run = (count + capacity - 1) / capacity * capacity;
+            nodes[nodeIndex].bucket = allocateRun(run);
+            overflow[nodeIndex] = run;
+        }
+        for (Entry* e = begin; e != end; e++) {
+            addToLeaf(nodeIndex, e->point, e->id);
+        }
+        return;
+    }
+
+    uint32_t offsets[5];
+    partition(nodeIndex, begin, end, scratch, offsets);
+
+    uint32_t child = nodes[nodeIndex].firstChild;
+    for (uint32_t q = 0; q < 4; q++) {
+        build(child + q, begin + offsets[q], begin + offsets[q + 1], scratch + offsets[q]);
+    }
+}
+
+void QuadTree::insertBatch(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch,
+                           std::vector<Entry>& spill) {
+    uint32_t count = static_cast<uint32_t>(end - begin);
+    if (nodes[nodeIndex].divided()) {
+        nodes[nodeIndex].total += count;
+        uint32_t offsets[5];
+        scatter(nodeIndex, begin, end, scratch, offsets);
+        uint32_t child = nodes[nodeIndex].firstChild;
+        for (uint32_t q = 0; q < 4; q++) {
+            if (offsets[q + 1] > offsets[q]) {
+                insertBatch(child + q, begin + offsets[q], begin + offsets[q + 1], scratch + offsets[q], spill);
+            }
+        }
         return;
     }
-    
-    // Check points in this node
-    for (const QuadPoint& point : points) {
-        if (range.contains(point)) {
-            result.push_back(point);
+
+    // A leaf keeps the batch if it has room, may not split, or is lazily
+    // waiting for queries
+    const QuadNode& leaf = nodes[nodeIndex];
+    uint32_t total = leaf.count + count;
+    if (total <= capacity || !canSplit(nodeIndex) ||
+        (lazySplit && !queriedOften(nodeIndex) && total < capacity * LAZY_SPLIT_LIMIT)) {
+        nodes[nodeIndex].total += count;
+        reserveLeaf(nodeIndex, total);
+        for (Entry* e = begin; e != end; e++) {
+            addToLeaf(nodeIndex, e->point, e->id);
+        }
+        return;
+    }
+
+    // Otherwise its points join the batch and the leaf is built afresh,
+    // with its scratch in the second half of spill
+    spill.resize(2 * static_cast<std::size_t>(total));
+    uint32_t bucket = leaf.bucket;
+    for (uint32_t i = 0; i < leaf.count; i++) {
+        spill[i] = Entry{QuadPoint(xs[bucket + i], ys[bucket + i]), ids[bucket + i]};
+    }
+    std::copy(begin, end, spill.begin() + leaf.count);
+    if (bucket != NONE) {
+        releaseRun(bucket, leafCapacity(nodeIndex));
+        overflow.erase(nodeIndex);
+    }
+    QUADTREE_STAT(countLeaf(leaf.count, -1); countLeaf(0, 1));
+    nodes[nodeIndex].bucket = NONE;
+    nodes[nodeIndex].count = 0;
+    build(nodeIndex, spill.data(), spill.data() + total, spill.data() + total);
+}
+
+void QuadTree::partition(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch,
+                         uint32_t offsets[5]) {
+    // One radix pass on the next two Morton bits: count each quadrant,
+    // then scatter the points into scratch grouped NW, NE, SW, SE
+    double sumX = 0.0, sumY = 0.0;
+    if (splitRule == SPLIT_CENTROID) {
+        for (Entry* e = begin; e != end; e++) {
+            sumX += e->point.x;
+            sumY += e->point.y;
         }
     }
-    
-    // Recursively check child nodes if subdivided
-    if (divided) {
-        northwest->query(range, result);
-        northeast->query(range, result);
-        southwest->query(range, result);
-        southeast->query(range, result);
+    createChildren(nodeIndex, splitAt(nodes[nodeIndex].boundary, sumX, sumY, static_cast<uint32_t>(end - begin)));
+    scatter(nodeIndex, begin, end, scratch, offsets);
+}
+
+void QuadTree::scatter(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch, uint32_t offsets[5]) const {
+    const QuadNode& node = nodes[nodeIndex];
+    for (int q = 0; q < 5; q++) {
+        offsets[q] = 0;
+    }
+    for (Entry* e = begin; e != end; e++) {
+        offsets[childFor(node, e->point) - node.firstChild + 1]++;
+    }
+    for (int q = 1; q < 5; q++) {
+        offsets[q] += offsets[q - 1];
+    }
+
+    uint32_t cursor[4] = {offsets[0], offsets[1], offsets[2], offsets[3]};
+    for (Entry* e = begin; e != end; e++) {
+        scratch[cursor[childFor(node, e->point) - node.firstChild]++] = *e;
     }
+    std::copy(scratch, scratch + (end - begin), begin);
 }
 
-void QuadTree::QuadNode::getBoundaries(std::vector<Rectangle>& boundaries) const {
-    boundaries.push_back(boundary);
-    
-    if (divided) {
-        northwest->getBoundaries(boundaries);
-        northeast->getBoundaries(boundaries);
-        southwest->getBoundaries(boundaries);
-        southeast->getBoundaries(boundaries);
+void QuadTree::graft(uint32_t nodeIndex, const QuadTree& part, uint32_t nodeBase, uint32_t slabBase) {
+    // Part node k > 0 moves to nodeBase + k - 1; part node 0 becomes nodeIndex
+    auto move = [&](uint32_t k) { return k == 0 ? nodeIndex : nodeBase + k - 1; };
+    auto rebase = [&](QuadNode node) {
+        if (node.divided()) {
+            node.firstChild = move(node.firstChild);
+        }
+        node.parent = node.parent == NONE ? nodes[nodeIndex].parent : move(node.parent);
+        if (node.bucket != NONE) {
+            node.bucket += slabBase;
+        }
+        return node;
+    };
+
+    nodes[nodeIndex] = rebase(part.nodes[0]);
+    for (std::size_t k = 1; k < part.nodes.size(); k++) {
+        nodes[nodeBase + k - 1] = rebase(part.nodes[k]);
+    }
+    std::copy(part.xs.begin(), part.xs.end(), xs.begin() + slabBase);
+    std::copy(part.ys.begin(), part.ys.end(), ys.begin() + slabBase);
+    std::copy(part.ids.begin(), part.ids.end(), ids.begin() + slabBase);
+
+    // The part did not track locations; ids are disjoint between parts, so
+    // each can fill in its own without synchronization
+    for (std::size_t k = 0; k < part.nodes.size(); k++) {
+        const QuadNode& node = part.nodes[k];
+        for (uint32_t i = 0; i < node.count; i++) {
+            locations[part.ids[node.bucket + i]] = Location{move(static_cast<uint32_t>(k)), i};
+        }
     }
 }
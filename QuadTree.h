@@ -2,64 +2,777 @@
 #define QUADTREE_H
 
 #include "Point.h"
+#include "RangeFilter.h"
+#include "QuadTreeStats.h"
 #include <vector>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+#include <algorithm>
+#include <string>
+#include <unordered_map>
 #include <memory>
+#ifdef QUADTREE_STATS
+#include <array>
+#include <chrono>
+#endif
+
+class TaskPool;
 
 class QuadTree {
+public:
+    // Stable 32-bit handle for a stored point, so results can be tied back
+    // to the caller's entities and duplicate positions told apart
+    typedef uint32_t Id;
+    static constexpr Id INVALID_ID = 0xFFFFFFFFu;
+
+    // Ids index a table as long as the highest id in use, so a caller-chosen
+    // id may lie at most this far past twice the table's length; the table
+    // then at most triples, rather than growing to whatever id is passed
+    static constexpr Id ID_HEADROOM = 1u << 20;
+
+    // Default depth limit: a float has a 24-bit mantissa, so cells deeper
+    // than this no longer separate points in most of the root's extent
+    static constexpr uint32_t DEFAULT_MAX_DEPTH = 24;
+
+    // The four children of a node, in arena order
+    enum Quadrant : uint32_t { NW = 0, NE = 1, SW = 2, SE = 3 };
+
+    // Points a leaf holds before it subdivides, unless set otherwise, and
+    // the most setCapacity() accepts
+    static constexpr uint32_t DEFAULT_CAPACITY = 4;
+    static constexpr uint32_t MAX_CAPACITY = 1024;
+
+    // Where a full leaf divides: through the middle of its boundary, or
+    // through the mean of the points it holds, so a cluster is spread over
+    // all four children instead of landing in one
+    enum SplitRule : uint32_t { SPLIT_MIDPOINT = 0, SPLIT_CENTROID = 1 };
+
 private:
-    static const int CAPACITY = 4;  // Maximum points per node before subdivision
-    
+    static constexpr uint32_t NONE = 0xFFFFFFFFu;  // Sentinel for "no child" / "no bucket"
+
+    // Traversals use a fixed stack of node indices. Each level pops one node
+    // and pushes at most four, so depth d needs 3d + 1 slots; halving a float
+    // extent runs out of precision long before 170 levels.
+    static constexpr int MAX_STACK = 512;
+
+    // Deepest tree the traversal stack can hold; larger depth limits are
+    // clamped to it
+    static constexpr uint32_t MAX_DEPTH = (MAX_STACK - 1) / 3;
+
+    // Stack entries with this bit set lie inside the query range, so their
+    // points are emitted without testing them
+    static constexpr uint32_t INSIDE = 0x80000000u;
+
+    // Points handed to the range filter per kernel call. Buckets smaller
+    // than FILTER_MIN are tested inline, where a kernel call would cost
+    // more than it saves.
+    static constexpr uint32_t FILTER_CHUNK = 64;
+    static constexpr uint32_t FILTER_MIN = 8;
+
+    // A lazily split leaf divides once range queries have scanned it this
+    // many times, or once it holds LAZY_SPLIT_LIMIT times the capacity
+    static constexpr uint32_t LAZY_SPLIT_SCANS = 4;
+    static constexpr uint32_t LAZY_SPLIT_LIMIT = 64;
+
+    // Auto-tune picks the capacity again after this many inserts, or after
+    // half as many as the tree holds points, whichever is more, so the O(n)
+    // relayout a new capacity costs stays amortized O(1) per insert
+    static constexpr uint64_t TUNE_INTERVAL = 4096;
+
+    // Nodes live in one contiguous arena and refer to each other by index.
+    // The four children of a subdivision are allocated together, so a node
+    // only stores the index of its first child: NW, NE, SW, SE follow it.
     struct QuadNode {
         Rectangle boundary;
-        std::vector<QuadPoint> points;
-        
-        // Four quadrants: NW, NE, SW, SE
-        std::unique_ptr<QuadNode> northwest;
-        std::unique_ptr<QuadNode> northeast;
-        std::unique_ptr<QuadNode> southwest;
-        std::unique_ptr<QuadNode> southeast;
-        
-        bool divided;
-        
-        QuadNode(const Rectangle& boundary) 
-            : boundary(boundary), divided(false) {}
-        
-        // Check if this node can accept a new point
-        bool insert(const QuadPoint& point);
-        
-        // Subdivide this node into four quadrants
-        void subdivide();
-        
-        // Query points within a range
-        void query(const Rectangle& range, std::vector<QuadPoint>& result) const;
-        
-        // Get all subdivision boundaries for visualization
-        void getBoundaries(std::vector<Rectangle>& boundaries) const;
+        uint32_t firstChild;  // Index of the NW child, NONE while this is a leaf
+        uint32_t parent;      // Index of the parent, NONE for the root
+        uint32_t bucket;      // Offset of this leaf's slab in xs/ys, NONE if empty
+        uint32_t count;       // Number of points stored in the slab
+        uint32_t total;       // Number of points in this node's whole subtree
+
+        QuadNode(const Rectangle& boundary)
+            : boundary(boundary), firstChild(NONE), parent(NONE), bucket(NONE), count(0), total(0) {}
+
+        bool divided() const { return firstChild != NONE; }
+    };
+
+    // Where a point with a given id is stored
+    struct Location {
+        uint32_t node;  // Leaf holding the point, NONE if the id is unused
+        uint32_t slot;  // Offset within the leaf's slab
+    };
+
+    // A point and its id while it is being bulk-loaded
+    struct Entry {
+        QuadPoint point;
+        Id id;
+    };
+
+    // Where a node's children divide it: the width of the west column and
+    // the height of the north row
+    struct Split {
+        float west;
+        float north;
+    };
+
+    // Leaf points are stored structure-of-arrays: one capacity-sized slab per
+    // non-empty leaf (a longer run for overflow leaves), at the same offset
+    // in xs, ys and ids, so the range filter can test several points per
+    // instruction.
+    std::vector<QuadNode> nodes;      // nodes[0] is the root
+    std::vector<float> xs;            // x coordinates of all slabs
+    std::vector<float> ys;            // y coordinates of all slabs
+    std::vector<Id> ids;              // ids of all slabs
+    std::vector<Location> locations;  // Indexed by id
+    bool trackLocations;              // False for private build arenas
+    std::vector<uint32_t> freeSlabs;  // Slabs released by leaves that subdivided or emptied
+    std::vector<uint32_t> freeBlocks; // Sibling blocks released by merged nodes
+
+    // Leaves that hit the depth or cell size limit cannot split, so once
+    // they fill a slab their points move to a larger run of slabs in the
+    // same arrays. Maps each such overflow leaf to its run's capacity.
+    std::unordered_map<uint32_t, uint32_t> overflow;
+
+    uint32_t maxDepth;    // Nodes at this depth never split
+    float minCellSize;    // Nodes never split into cells narrower than this
+    float minSplitWidth;  // Narrowest node that may still split, from both limits
+    float minSplitHeight;
+    bool autoExpand;      // Grow the root to take points outside it
+
+    uint32_t capacity;        // Points per slab, and per leaf before it splits
+    SplitRule splitRule;
+    bool lazySplit;           // Full leaves wait for queries before splitting
+    bool autoTune;            // insert() picks the capacity from the workload
+
+    // Some node was split off-center, so a cell's size no longer bounds its
+    // depth and canSplit() checks the depth itself
+    bool uneven;
+
+    // A divided node collapses back into a leaf once its subtree holds this
+    // many points or fewer: half the capacity, so a point moving back and
+    // forth across the split threshold does not split and merge every time
+    uint32_t mergeThreshold;
+
+    // Range query activity that lazy splitting and auto-tune steer by.
+    // Queries are const and may run on several threads, so the counts are
+    // atomic, and copies take a snapshot of them, as with Counters.
+    struct Workload {
+        // Partial scans of leaves holding more than the capacity, by node
+        // index. Allocated only while splitting lazily, and grown with the
+        // arena by the (non-const) calls that add nodes.
+        std::unique_ptr<std::atomic<uint32_t>[]> heat;
+        std::size_t heatSize;
+
+        // Since the capacity was last tuned
+        std::atomic<uint64_t> queries;
+        uint64_t inserts;
+
+        Workload() : heatSize(0) { resetCounts(); }
+        Workload(const Workload& other) : heatSize(0) { *this = other; }
+        Workload& operator=(const Workload& other);
+
+        // Make room for the heat of nodes [0, count), keeping what is there
+        void fitHeat(std::size_t count);
+        void resetHeat();
+        void resetCounts();
+    };
+    mutable Workload workload;
+
+    // Levels by which nodes split under an earlier, smaller root may lie
+    // deeper than maxDepth now allows; grow() stops before maxDepth plus
+    // this reaches MAX_DEPTH
+    uint32_t grownLevels;
+
+#ifdef QUADTREE_STATS
+    // Live counts behind stats(). Structure counts change only with the
+    // tree; query counters are bumped by const calls that may run on
+    // several threads (queryBatch), so they are atomic.
+    struct Counters {
+        std::array<std::size_t, MAX_DEPTH + 1> nodesByDepth;
+        std::vector<std::size_t> leavesByOccupancy;  // capacity + 2 classes
+        std::atomic<uint64_t> queries, nodesVisited, pointsTested, pointsReturned;
+        LatencyRecorder insertLatency;
+        LatencyRecorder queryLatency;
+
+        Counters() { resetStructure(DEFAULT_CAPACITY); resetWorkload(); }
+        Counters(const Counters& other) { *this = other; }
+        Counters& operator=(const Counters& other);
+
+        // A tree with just an empty root; the workload counters stay
+        void resetStructure(uint32_t capacity);
+        void resetWorkload();
     };
-    
-    std::unique_ptr<QuadNode> root;
-    
+    mutable Counters counters;
+
+    // Tallies one range query into counters when it ends, however it ends
+    struct QueryProbe {
+        Counters& counters;
+        std::chrono::steady_clock::time_point start;
+        uint64_t nodes = 0, tested = 0, returned = 0;
+
+        explicit QueryProbe(Counters& counters)
+            : counters(counters), start(std::chrono::steady_clock::now()) {}
+        ~QueryProbe();
+    };
+
+    // Move a leaf between occupancy classes; delta +1 adds, -1 removes
+    void countLeaf(uint32_t count, int delta) {
+        counters.leavesByOccupancy[std::min<uint32_t>(count, capacity + 1)] += delta;
+    }
+
+    // Rebuild the structure counts by walking the tree, after a parallel
+    // build grafted subtrees in wholesale
+    void recountStructure();
+#endif
+
+    // Call a visitor with (id, point) or just (point), whichever it takes,
+    // and report whether the walk should continue
+    template <typename Visitor>
+    static bool visit(Visitor& visitor, Id id, const QuadPoint& point);
+
+    // Pick the child of a divided node whose quadrant holds the point
+    uint32_t childFor(const QuadNode& node, const QuadPoint& point) const;
+
+    // Store a point in a leaf that still has room in its slab
+    void addToLeaf(uint32_t nodeIndex, const QuadPoint& point, Id id);
+
+    uint32_t depthOf(uint32_t nodeIndex) const;
+
+    // Whether a node may be split under the depth and cell size limits
+    bool canSplit(uint32_t nodeIndex) const;
+
+    // Whether range queries have scanned a leaf often enough that a lazy
+    // split is due, or it is due by that or by its size
+    bool queriedOften(uint32_t nodeIndex) const;
+    bool splitDue(uint32_t nodeIndex) const;
+
+    // Split the leaves holding more than the capacity that may split,
+    // only those splitDue() if hotOnly; returns how many split
+    std::size_t splitDeferred(bool hotOnly);
+
+    // Lay every point out again under the current capacity, keeping ids
+    void relayout();
+
+    // Pick the capacity from the inserts and queries since the last call
+    void tune();
+
+    // Number of points a leaf's storage holds: one slab, or its overflow run
+    uint32_t leafCapacity(uint32_t nodeIndex) const;
+
+    // Give a leaf room for points in all, moving it to an overflow run at
+    // least twice its current one if it needs more
+    void reserveLeaf(uint32_t nodeIndex, uint32_t points);
+
+    // Move an overflow leaf that fits in one slab again back into one
+    void shrinkLeaf(uint32_t nodeIndex);
+
+    // Append a run of length points (a multiple of the capacity) to the arrays
+    uint32_t allocateRun(uint32_t length);
+
+    // Put a run's slabs on the free list
+    void releaseRun(uint32_t bucket, uint32_t length);
+
+    // Subdivide a leaf into four quadrants and move its points down
+    void subdivide(uint32_t nodeIndex);
+
+    // Subdivide an overflow leaf that the limits allow to split again
+    void subdivideOverflow(uint32_t nodeIndex);
+
+    // Where to split a node under the split rule, given the number of its
+    // points and the sums of their coordinates
+    Split splitAt(const Rectangle& boundary, double sumX, double sumY, uint32_t count) const;
+
+    // The split for a leaf about to subdivide, from the points it holds
+    Split leafSplit(uint32_t nodeIndex) const;
+
+    // Append the four child nodes of a leaf and link them in
+    void createChildren(uint32_t nodeIndex, const Split& split);
+
+    // Take a slab from the free list or grow the pool by one
+    uint32_t allocateSlab();
+
+    // Insert below a node known to contain the point
+    void insertFrom(uint32_t nodeIndex, const QuadPoint& point, Id id);
+
+    // Take a point out of the tree given its leaf and slot
+    void erase(uint32_t leafIndex, uint32_t slot);
+
+    // Move a point given its leaf and slot; to must be inside the bounds
+    void move(uint32_t leafIndex, uint32_t slot, const QuadPoint& to);
+
+    // Points inside the boundary, paired with their index as id
+    std::vector<Entry> collect(const QuadPoint* points, std::size_t count) const;
+
+    // The k closest points with their ids, nearest first
+    std::vector<Entry> nearestEntries(const QuadPoint& center, std::size_t k) const;
+
+    // Leaf whose quadrant holds the point, NONE if outside the root
+    uint32_t findLeaf(const QuadPoint& point) const;
+
+    // Slot of a point within a leaf's slab, NONE if it is not there
+    uint32_t findSlot(uint32_t leafIndex, const QuadPoint& point) const;
+
+    // Drop one point from a leaf, freeing the slab once it is empty
+    void removeFromLeaf(uint32_t leafIndex, uint32_t slot);
+
+    // Collapse underfull ancestors from nodeIndex up to, not including, stop
+    void mergeUp(uint32_t nodeIndex, uint32_t stop);
+
+    // Pull every point below an underfull node into it, freeing the blocks
+    // and runs below
+    void collapse(uint32_t nodeIndex);
+
+    // Move the points of the subtree at from into the leaf nodeIndex and
+    // free its storage
+    void absorb(uint32_t nodeIndex, uint32_t from);
+
+    // Turn an empty node into a leaf without storage, freeing every block
+    // and run below it
+    void prune(uint32_t nodeIndex);
+
+    // Point what refers to a node that moved from index from (its
+    // children's parent links, or its points' locations and overflow
+    // entry) at its new index
+    void adopt(uint32_t nodeIndex, uint32_t from);
+
+    // Derive minSplitWidth and minSplitHeight from the root and limits
+    void updateSplitLimits();
+
+    // Get all subdivision boundaries for visualization
+    void getBoundaries(uint32_t nodeIndex, std::vector<Rectangle>& boundaries) const;
+
+    // Bulk-load the points in [begin, end) under a fresh node, using scratch
+    // (same length) to partition them by quadrant
+    void build(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch);
+
+    // Give a node its children and reorder [begin, end) into NW, NE, SW, SE
+    // groups; offsets receives the group boundaries
+    void partition(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch,
+                   uint32_t offsets[5]);
+
+    // The same reordering for a node that is already divided
+    void scatter(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch, uint32_t offsets[5]) const;
+
+    // Insert the points in [begin, end), all inside the node, below it.
+    // scratch is the same length; spill is reused by every leaf the batch
+    // makes split.
+    void insertBatch(uint32_t nodeIndex, Entry* begin, Entry* end, Entry* scratch, std::vector<Entry>& spill);
+
+    // Copy a separately built subtree into this arena, replacing the leaf
+    // at nodeIndex; its nodes and slabs land at the given bases
+    void graft(uint32_t nodeIndex, const QuadTree& part, uint32_t nodeBase, uint32_t slabBase);
+
 public:
-    QuadTree(const Rectangle& boundary);
+    // Nodes below maxDepth levels, or whose quadrants would be narrower
+    // than minCellSize, are never split; points piling up in them go to an
+    // overflow bucket instead, so clusters of identical or near-identical
+    // points cannot subdivide without end.
+    QuadTree(const Rectangle& boundary, uint32_t maxDepth = DEFAULT_MAX_DEPTH,
+             float minCellSize = 0.0f);
     ~QuadTree() = default;
-    
-    // Insert a point into the quad tree
+
+    // Insert a point into the quad tree. It gets the next id past every id
+    // used so far; use the id overload to choose one.
     bool insert(const QuadPoint& point);
-    
+
+    // Insert a point under a caller-chosen id, typically an entity index.
+    // Returns false if the point is outside the bounds, the id is taken, or
+    // it is too far past the ids in use (see ID_HEADROOM).
+    bool insert(const QuadPoint& point, Id id);
+
+    // Remove one point equal to the given one, or the point with an id.
+    // Quadrants left underfull are merged back into their parent. Returns
+    // false if no such point exists.
+    bool remove(const QuadPoint& point);
+    bool remove(Id id);
+
+    // Move one point equal to from, or the point with an id, to a new
+    // position. If the point stays in its leaf it is overwritten in place;
+    // otherwise only the subtree below the lowest common ancestor of both
+    // positions is touched. Returns false (and changes nothing) if the point
+    // is missing or to is outside the bounds.
+    bool update(const QuadPoint& from, const QuadPoint& to);
+    bool update(Id id, const QuadPoint& to);
+
+    // Whether a point with this id is stored
+    bool contains(Id id) const;
+
+    // Current position of a stored point; the id must be present
+    QuadPoint position(Id id) const;
+
+    // Replace the contents with a bulk-loaded tree of the given points; each
+    // point's id is its index in the input.
+    // Points are put into Z-order (Morton order) by a radix pass per level
+    // that uses the tree's own quadrant splits, and each node is emitted
+    // once, already holding its final points, so nothing is re-inserted.
+    // With midpoint splits this produces the same tree as inserting the
+    // points one by one; centroid splits divide each node at the mean of
+    // all the points below it, not just the first to fill it. Leaves are
+    // split fully even when splitting lazily. Returns the number of points
+    // inside the boundary.
+    std::size_t build(const QuadPoint* points, std::size_t count);
+    std::size_t build(const std::vector<QuadPoint>& points);
+
+    // Insert many points at once, each getting the next id past every id
+    // used so far, in order, as insert() would give them. The batch is
+    // partitioned into quadrants once per node on its way down, a radix
+    // sort on Morton key, so each node is visited once per batch rather
+    // than once per point. A leaf the batch overflows is rebuilt together
+    // with its old points by build()'s bulk path, so its subdivisions are
+    // made for all of them at once. With midpoint splits this produces the
+    // same tree as inserting the points one by one. Returns the number of
+    // points inserted.
+    std::size_t insertBatch(const QuadPoint* points, std::size_t count);
+    std::size_t insertBatch(const std::vector<QuadPoint>& points);
+
+    // Parallel build(): the top levels are partitioned on the calling
+    // thread until there are several subtrees per thread, the subtrees are
+    // built into private arenas on the pool, then grafted into this one
+    std::size_t build(const QuadPoint* points, std::size_t count, TaskPool& pool);
+
     // Query points within a rectangular range
     std::vector<QuadPoint> query(const Rectangle& range) const;
-    
+
+    // Append points within range to a caller-owned buffer (not cleared first),
+    // so a hot loop can reuse one allocation across queries
+    void query(const Rectangle& range, std::vector<QuadPoint>& result) const;
+
+    // Call visitor(const QuadPoint&) or visitor(Id, const QuadPoint&) for
+    // every point within range without allocating. A visitor returning bool
+    // can return false to stop early; the result is false if the walk was
+    // stopped.
+    template <typename Visitor>
+    bool query(const Rectangle& range, Visitor&& visitor) const;
+
+    // Ids of the points within range
+    std::vector<Id> queryIds(const Rectangle& range) const;
+
+    // Call visitor(const QuadPoint&) or visitor(Id, const QuadPoint&) for
+    // every point within radius of center (inclusive). Nodes are pruned by circle-rectangle overlap, and nodes
+    // lying wholly inside the circle are emitted without distance tests.
+    template <typename Visitor>
+    bool queryRadius(const QuadPoint& center, float radius, Visitor&& visitor) const;
+
+    // Points within radius of center
+    std::vector<QuadPoint> queryRadius(const QuadPoint& center, float radius) const;
+
+    // The k points closest to center, nearest first, and the same search
+    // returning ids. Best-first search:
+    // nodes are expanded in order of their minimum distance to center and
+    // the walk stops once no unexpanded node can beat the k-th best point.
+    std::vector<QuadPoint> nearest(const QuadPoint& center, std::size_t k) const;
+    std::vector<Id> nearestIds(const QuadPoint& center, std::size_t k) const;
+
+    // Run independent range queries across the pool. Each query fills its
+    // own result vector, so workers never share an output buffer.
+    std::vector<std::vector<QuadPoint>> queryBatch(const Rectangle* ranges, std::size_t count,
+                                                   TaskPool& pool) const;
+    std::vector<std::vector<QuadPoint>> queryBatch(const std::vector<Rectangle>& ranges,
+                                                   TaskPool& pool) const;
+
+    // Count points within range without materializing them. Nodes that lie
+    // inside the range contribute their cached subtree total, so this costs
+    // O(nodes touched) rather than O(points).
+    std::size_t count(const Rectangle& range) const;
+
+    // Total number of points in the tree
+    std::size_t size() const { return nodes[0].total; }
+
     // Get all points in the quad tree
     std::vector<QuadPoint> getAllPoints() const;
-    
+
     // Get all subdivision boundaries for visualization
     std::vector<Rectangle> getBoundaries() const;
-    
-    // Clear all points from the quad tree
+
+    // Level-of-detail walk over the cells that intersect range, for drawing
+    // it at a scale where cells narrower than minSize are not worth
+    // resolving. Cells at least minSize wide go to cell(const Rectangle&)
+    // and their points within range to point(const QuadPoint&); a non-empty
+    // cell narrower than that goes whole to aggregate(const Rectangle&,
+    // std::size_t points) with its cached subtree total and is not entered.
+    // The cost is bounded by the cells at minSize resolution, not by the
+    // number of points beneath them.
+    template <typename CellVisitor, typename PointVisitor, typename AggregateVisitor>
+    void queryLevelOfDetail(const Rectangle& range, float minSize, CellVisitor&& cell, PointVisitor&& point,
+                            AggregateVisitor&& aggregate) const;
+
+    // Boundary of the leaf whose quadrant holds point, or the root's if the
+    // point is outside. A following insert of the point only subdivides
+    // within this cell.
+    Rectangle leafBoundary(const QuadPoint& point) const;
+
+    // Clear all points from the quad tree. Keeps the arena's capacity, so
+    // this is O(1) and refilling the tree does not hit the allocator again.
     void clear();
-    
+
     // Get the root boundary
     Rectangle getBoundary() const;
+
+    // Double the root's extent, keeping the old root as the new root's
+    // given quadrant; the rest of the tree is untouched, so this costs O(1)
+    // however many points are stored. The depth limit then applies below
+    // the new root. Returns false (and changes nothing) if the grown bounds
+    // are not exact in floating point or the tree would get too deep.
+    bool grow(Quadrant quadrant);
+
+    // Halve the root's extent to one quadrant by promoting that child, in
+    // O(1) plus freeing the other, empty, quadrants' nodes. Returns false
+    // (and changes nothing) if a point lies outside it, or if the root is
+    // a leaf whose half could no longer split.
+    bool shrink(Quadrant quadrant);
+
+    // Grow the root, one doubling at a time away from the old one, until it
+    // contains point or area; false if grow() refuses first
+    bool expandToInclude(const QuadPoint& point);
+    bool expandToInclude(const Rectangle& area);
+
+    // When on, insert() grows the root to take a point outside it instead
+    // of refusing it. Off by default.
+    void setAutoExpand(bool enabled) { autoExpand = enabled; }
+    bool getAutoExpand() const { return autoExpand; }
+
+    // Points a leaf holds before it subdivides. Larger leaves make a
+    // shallower tree of fewer nodes, whose queries hop between fewer nodes
+    // and scan more points contiguously through the range filter. Changing
+    // it lays a non-empty tree out again in O(n), keeping every id. Returns
+    // false (and changes nothing) for 0 or more than MAX_CAPACITY.
+    bool setCapacity(uint32_t points);
+    uint32_t getCapacity() const { return capacity; }
+
+    // How leaves split from now on; nodes already divided keep their
+    // split. Midpoint by default.
+    void setSplitRule(SplitRule rule) { splitRule = rule; }
+    SplitRule getSplitRule() const { return splitRule; }
+
+    // When on, a full leaf keeps taking points instead of splitting until
+    // range queries have scanned it LAZY_SPLIT_SCANS times or it holds
+    // LAZY_SPLIT_LIMIT times the capacity, so regions that are written but
+    // rarely read stay flat. The split happens at the leaf's next insert or
+    // at refine(), all the way down if queries made it due. Turning this
+    // off splits every leaf still waiting. Off by default.
+    void setLazySplit(bool enabled);
+    bool getLazySplit() const { return lazySplit; }
+
+    // Split the lazily deferred leaves that queries have made due, without
+    // waiting for an insert; returns how many split
+    std::size_t refine() { return splitDeferred(true); }
+
+    // When on, insert() periodically picks the capacity from the share of
+    // inserts and range queries measured since it last did: 256 points per
+    // leaf for insert-only work, which then splits rarely, down to 64 as
+    // queries dominate. Range queries then bump a shared atomic counter.
+    // Off by default.
+    void setAutoTune(bool enabled);
+    bool getAutoTune() const { return autoTune; }
+
+    // Number of nodes currently in the tree
+    std::size_t nodeCount() const { return nodes.size() - 4 * freeBlocks.size(); }
+
+    // Write a snapshot of the tree (see QuadTreeSnapshot.h) that
+    // MappedQuadTree can serve without deserializing. Nodes are renumbered
+    // breadth-first and leaves packed, so space freed in the arena is left
+    // out. The file is written beside path and renamed over it, so readers
+    // never see a partial snapshot. Returns false on I/O failure.
+    bool save(const std::string& path) const;
+
+    // Number of leaves holding more than the capacity, because they hit
+    // the depth or cell size limit or are waiting to split lazily. Without
+    // lazy splitting, a persistently high count points at pathological
+    // input, such as many points sharing one position.
+    std::size_t overflowCount() const { return overflow.size(); }
+
+    // Depth and cell size limits
+    uint32_t getMaxDepth() const { return maxDepth; }
+    float getMinCellSize() const { return minCellSize; }
+
+    // Bytes reserved by the node arena and point slabs
+    std::size_t memoryUsage() const;
+
+    // Counters and histograms described in QuadTreeStats.h. Costs the same
+    // however large the tree is; without QUADTREE_STATS only the point and
+    // node totals are filled in.
+    QuadTreeStats stats() const;
+
+    // Zero the query counters and latency histograms, to measure a new
+    // phase of work; structure counts are left alone
+    void resetStats();
 };
 
+template <typename Visitor>
+bool QuadTree::visit(Visitor& visitor, Id id, const QuadPoint& point) {
+    if constexpr (std::is_invocable_v<Visitor&, Id, const QuadPoint&>) {
+        if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, Id, const QuadPoint&>, void>) {
+            visitor(id, point);
+            return true;
+        } else {
+            return visitor(id, point);
+        }
+    } else if constexpr (std::is_same_v<std::invoke_result_t<Visitor&, const QuadPoint&>, void>) {
+        visitor(point);
+        return true;
+    } else {
+        return visitor(point);
+    }
+}
+
+template <typename Visitor>
+bool QuadTree::query(const Rectangle& range, Visitor&& visitor) const {
+    uint32_t stack[MAX_STACK];
+    uint32_t hits[FILTER_CHUNK];
+    int top = 0;
+    stack[top++] = 0;
+    QUADTREE_STAT(QueryProbe probe(counters));
+    if (autoTune) {
+        workload.queries.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        const QuadNode& node = nodes[entry & ~INSIDE];
+        bool inside = (entry & INSIDE) != 0;
+        QUADTREE_STAT(probe.nodes++);
+
+        if (!inside) {
+            // Check if range intersects with this node's boundary
+            if (node.total == 0 || !node.boundary.intersects(range)) {
+                continue;
+            }
+            // A node fully covered by the range takes its subtree with it
+            inside = range.contains(node.boundary);
+
+            // A partial scan of an oversized leaf is what splitting it saves
+            if (lazySplit && !inside && node.count > capacity) {
+                workload.heat[entry & ~INSIDE].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Check points in this node
+        const float* px = node.count > 0 ? xs.data() + node.bucket : nullptr;
+        const float* py = node.count > 0 ? ys.data() + node.bucket : nullptr;
+        const Id* pid = node.count > 0 ? ids.data() + node.bucket : nullptr;
+        if (inside) {
+            for (uint32_t i = 0; i < node.count; i++) {
+                QUADTREE_STAT(probe.returned++);
+                if (!visit(visitor, pid[i], QuadPoint(px[i], py[i]))) {
+                    return false;
+                }
+            }
+        } else if (node.count < FILTER_MIN) {
+            QUADTREE_STAT(probe.tested += node.count);
+            for (uint32_t i = 0; i < node.count; i++) {
+                QuadPoint point(px[i], py[i]);
+                if (range.contains(point)) {
+                    QUADTREE_STAT(probe.returned++);
+                    if (!visit(visitor, pid[i], point)) {
+                        return false;
+                    }
+                }
+            }
+        } else {
+            QUADTREE_STAT(probe.tested += node.count);
+            for (uint32_t begin = 0; begin < node.count; begin += FILTER_CHUNK) {
+                uint32_t chunk = std::min(node.count - begin, FILTER_CHUNK);
+                uint32_t found = RangeFilter::filter(px + begin, py + begin, chunk, range, hits);
+                for (uint32_t i = 0; i < found; i++) {
+                    uint32_t k = begin + hits[i];
+                    QUADTREE_STAT(probe.returned++);
+                    if (!visit(visitor, pid[k], QuadPoint(px[k], py[k]))) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        // Push children in reverse so NW is visited first
+        if (node.divided()) {
+            uint32_t flag = inside ? INSIDE : 0;
+            for (int i = 3; i >= 0; i--) {
+                if (nodes[node.firstChild + i].total != 0) {
+                    stack[top++] = (node.firstChild + i) | flag;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template <typename CellVisitor, typename PointVisitor, typename AggregateVisitor>
+void QuadTree::queryLevelOfDetail(const Rectangle& range, float minSize, CellVisitor&& cell,
+                                  PointVisitor&& point, AggregateVisitor&& aggregate) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const QuadNode& node = nodes[stack[--top]];
+        if (!node.boundary.intersects(range)) {
+            continue;
+        }
+        if (std::max(node.boundary.width, node.boundary.height) < minSize) {
+            if (node.total > 0) {
+                aggregate(node.boundary, static_cast<std::size_t>(node.total));
+            }
+            continue;
+        }
+
+        cell(node.boundary);
+        for (uint32_t i = 0; i < node.count; i++) {
+            QuadPoint p(xs[node.bucket + i], ys[node.bucket + i]);
+            if (range.contains(p)) {
+                point(p);
+            }
+        }
+
+        // Empty children still have outlines, as in getBoundaries()
+        if (node.divided()) {
+            for (int i = 3; i >= 0; i--) {
+                stack[top++] = node.firstChild + i;
+            }
+        }
+    }
+}
+
+template <typename Visitor>
+bool QuadTree::queryRadius(const QuadPoint& center, float radius, Visitor&& visitor) const {
+    uint32_t stack[MAX_STACK];
+    int top = 0;
+    stack[top++] = 0;
+    float radiusSquared = radius * radius;
+
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        const QuadNode& node = nodes[entry & ~INSIDE];
+        bool inside = (entry & INSIDE) != 0;
+
+        if (!inside) {
+            if (node.total == 0 || !node.boundary.intersectsCircle(center, radius)) {
+                continue;
+            }
+            inside = node.boundary.insideCircle(center, radius);
+        }
+
+        for (uint32_t i = 0; i < node.count; i++) {
+            QuadPoint point(xs[node.bucket + i], ys[node.bucket + i]);
+            if (!inside && point.distanceSquared(center) > radiusSquared) {
+                continue;
+            }
+            if (!visit(visitor, ids[node.bucket + i], point)) {
+                return false;
+            }
+        }
+
+        if (node.divided()) {
+            uint32_t flag = inside ? INSIDE : 0;
+            for (int i = 3; i >= 0; i--) {
+                if (nodes[node.firstChild + i].total != 0) {
+                    stack[top++] = (node.firstChild + i) | flag;
+                }
+            }
+        }
+    }
+    return true;
+}
+
 #endif // QUADTREE_H
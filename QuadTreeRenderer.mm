@@ -1,5 +1,6 @@
 #import "QuadTreeRenderer.h"
 #include <random>
+#include <vector>
 
 @implementation QuadTreeView
 
@@ -52,10 +53,13 @@
     std::uniform_real_distribution<float> xDist(boundary.x, boundary.x + boundary.width);
     std::uniform_real_distribution<float> yDist(boundary.y, boundary.y + boundary.height);
     
+    std::vector<QuadPoint> points;
+    points.reserve(count);
     for (int i = 0; i < count; i++) {
-        QuadPoint randomPoint(xDist(gen), yDist(gen));
-        _quadTree->insert(randomPoint);
+        float x = xDist(gen);
+        points.emplace_back(x, yDist(gen));
     }
+    _quadTree->insertBatch(points);
     
     [self setNeedsDisplay:YES];
 }
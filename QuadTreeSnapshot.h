@@ -0,0 +1,53 @@
+#ifndef QUADTREE_SNAPSHOT_H
+#define QUADTREE_SNAPSHOT_H
+
+#include <cstdint>
+
+// On-disk layout of a QuadTree snapshot, written by QuadTree::save() and
+// served in place by MappedQuadTree.
+//
+// The file is a Header followed by four arrays, each starting at an offset
+// recorded in the header and aligned to ALIGNMENT: the nodes, then the x
+// coordinates, y coordinates and ids of all points. Nodes refer to their
+// children and points by index, never by address, so the file works at
+// whatever address it is mapped. Children of a node are contiguous (NW,
+// NE, SW, SE) and every leaf's points are one packed run.
+//
+// Values are in the writer's byte order; byteOrder lets a reader on a host
+// of the other order reject the file instead of misreading it.
+namespace QuadTreeSnapshot {
+
+const char MAGIC[8] = {'Q', 'T', 'S', 'N', 'A', 'P', '\r', '\n'};
+const uint32_t VERSION = 1;
+const uint32_t BYTE_ORDER_MARK = 0x01020304u;
+const uint32_t ALIGNMENT = 64;
+const uint32_t NONE = 0xFFFFFFFFu;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    float x, y, width, height;  // Root boundary
+    uint64_t nodeCount;
+    uint64_t pointCount;
+    uint64_t nodesOffset;
+    uint64_t xsOffset;
+    uint64_t ysOffset;
+    uint64_t idsOffset;
+    uint64_t fileSize;
+};
+
+struct Node {
+    float x, y, width, height;  // Boundary
+    uint32_t firstChild;        // Index of the NW child, NONE for a leaf
+    uint32_t bucket;            // Index of the leaf's first point
+    uint32_t count;             // Points stored in this leaf
+    uint32_t total;             // Points in the whole subtree
+};
+
+static_assert(sizeof(Header) == 88, "snapshot header layout changed");
+static_assert(sizeof(Node) == 32, "snapshot node layout changed");
+
+} // namespace QuadTreeSnapshot
+
+#endif // QUADTREE_SNAPSHOT_H
@@ -0,0 +1,203 @@
+#ifndef QUADTREE_STATS_H
+#define QUADTREE_STATS_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Opt-in instrumentation for QuadTree. Build every translation unit with
+// -DQUADTREE_STATS (make test-stats, make -f Makefile.sdl stats) to turn it
+// on; without it the counters and timers are compiled out and the tree
+// carries no extra state. The flag changes QuadTree's layout, so it has to
+// be the same across a whole program.
+//
+// QuadTree::stats() returns a QuadTreeStats in time independent of the
+// tree's size: structure counts are kept up to date as nodes split, merge
+// and fill, rather than found by walking the tree.
+
+#ifdef QUADTREE_STATS
+#define QUADTREE_STAT(...) __VA_ARGS__
+#else
+#define QUADTREE_STAT(...)
+#endif
+
+// Log-linear latency histogram in the style of HdrHistogram: values below
+// 2 * SUB_BUCKETS nanoseconds are exact, larger ones fall in one of
+// SUB_BUCKETS equal steps per power of two, so any recorded value is known
+// to within 1 / SUB_BUCKETS (6.25%).
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BITS;
+
+    // Values of 2^(MAX_EXPONENT + 1) ns (about 36 minutes) and up share the
+    // last bucket
+    static constexpr int MAX_EXPONENT = 40;
+    static constexpr int BUCKETS = (MAX_EXPONENT - SUB_BITS + 2) * SUB_BUCKETS;
+
+    LatencyHistogram() : counts(BUCKETS, 0), total(0), sum(0), largest(0) {}
+
+    void record(uint64_t nanoseconds);
+
+    // Number of recorded values, and their mean and maximum in ns
+    uint64_t count() const { return total; }
+    double mean() const { return total == 0 ? 0.0 : static_cast<double>(sum) / total; }
+    uint64_t max() const { return largest; }
+
+    // Smallest bucket upper edge at or below which a fraction p (0 to 1) of
+    // the recorded values lie, capped at the maximum; 0 when empty
+    uint64_t percentile(double p) const;
+
+    // Bucket holding a value, and the range of values a bucket covers
+    static int bucketFor(uint64_t nanoseconds);
+    static uint64_t bucketLow(int bucket);
+    static uint64_t bucketHigh(int bucket);
+
+    std::vector<uint64_t> counts;  // Indexed by bucket
+    uint64_t total;
+    uint64_t sum;
+    uint64_t largest;
+};
+
+inline int LatencyHistogram::bucketFor(uint64_t nanoseconds) {
+    if (nanoseconds < 2 * SUB_BUCKETS) {
+        return static_cast<int>(nanoseconds);
+    }
+    int exponent = SUB_BITS + 1;
+    while (exponent < MAX_EXPONENT && (nanoseconds >> (exponent + 1)) != 0) {
+        exponent++;
+    }
+    if ((nanoseconds >> (exponent + 1)) != 0) {
+        return BUCKETS - 1;
+    }
+    // The top SUB_BITS + 1 bits, less the leading one, pick the step
+    int sub = static_cast<int>(nanoseconds >> (exponent - SUB_BITS)) - SUB_BUCKETS;
+    return (exponent - SUB_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+inline uint64_t LatencyHistogram::bucketLow(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    return static_cast<uint64_t>(SUB_BUCKETS + bucket % SUB_BUCKETS) << (exponent - SUB_BITS);
+}
+
+inline uint64_t LatencyHistogram::bucketHigh(int bucket) {
+    if (bucket < 2 * SUB_BUCKETS) {
+        return static_cast<uint64_t>(bucket);
+    }
+    int exponent = bucket / SUB_BUCKETS + SUB_BITS - 1;
+    return bucketLow(bucket) + (uint64_t(1) << (exponent - SUB_BITS)) - 1;
+}
+
+inline void LatencyHistogram::record(uint64_t nanoseconds) {
+    counts[bucketFor(nanoseconds)]++;
+    total++;
+    sum += nanoseconds;
+    largest = nanoseconds > largest ? nanoseconds : largest;
+}
+
+inline uint64_t LatencyHistogram::percentile(double p) const {
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = static_cast<uint64_t>(p * static_cast<double>(total));
+    rank = rank == 0 ? 1 : (rank > total ? total : rank);
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+            uint64_t high = bucketHigh(b);
+            return high < largest ? high : largest;
+        }
+    }
+    return largest;
+}
+
+// What stats() reports. Without QUADTREE_STATS only points and nodes are
+// filled in and enabled is false.
+struct QuadTreeStats {
+    bool enabled = false;
+    std::size_t points = 0;
+    std::size_t nodes = 0;
+    std::size_t leaves = 0;
+
+    // Nodes at each depth, the root's first; its length is one past the
+    // deepest level in use
+    std::vector<std::size_t> nodesByDepth;
+
+    // Leaves holding 0, 1, ... capacity points (see setCapacity()); the last
+    // entry counts overflow leaves holding more
+    std::vector<std::size_t> leavesByOccupancy;
+
+    // Range queries (every query() form, including getAllPoints) since
+    // the tree was made or resetStats() was called. Points inside nodes the
+    // range covers are returned without a test, so returned can exceed
+    // tested.
+    uint64_t queries = 0;
+    uint64_t nodesVisited = 0;
+    uint64_t pointsTested = 0;
+    uint64_t pointsReturned = 0;
+
+    LatencyHistogram insertLatency;  // Per insert() call
+    LatencyHistogram queryLatency;   // Per query, visitor time included
+
+    double nodesPerQuery() const {
+        return queries == 0 ? 0.0 : static_cast<double>(nodesVisited) / queries;
+    }
+};
+
+// A histogram and counters that const queries on several threads can bump
+// at once: relaxed atomics, gathered into a LatencyHistogram on demand.
+// Copying takes the current values, so trees holding one stay copyable.
+class LatencyRecorder {
+public:
+    LatencyRecorder() { reset(); }
+    LatencyRecorder(const LatencyRecorder& other) { *this = other; }
+
+    LatencyRecorder& operator=(const LatencyRecorder& other) {
+        for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+            counts[b].store(other.counts[b].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        sum.store(other.sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        largest.store(other.largest.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void record(uint64_t nanoseconds) {
+        counts[LatencyHistogram::bucketFor(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+        uint64_t seen = largest.load(std::memory_order_relaxed);
+        while (nanoseconds > seen &&
+               !largest.compare_exchange_weak(seen, nanoseconds, std::memory_order_relaxed)) {
+        }
+    }
+
+    LatencyHistogram snapshot() const {
+        LatencyHistogram histogram;
+        for (int b = 0; b < LatencyHistogram::BUCKETS; b++) {
+            histogram.counts[b] = counts[b].load(std::memory_order_relaxed);
+            histogram.total += histogram.counts[b];
+        }
+        histogram.sum = sum.load(std::memory_order_relaxed);
+        histogram.largest = largest.load(std::memory_order_relaxed);
+        return histogram;
+    }
+
+    void reset() {
+        for (std::atomic<uint64_t>& count : counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        sum.store(0, std::memory_order_relaxed);
+        largest.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> counts[LatencyHistogram::BUCKETS];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> largest;
+};
+
+#endif // QUADTREE_STATS_H
@@ -0,0 +1,178 @@
+#include "RangeFilter.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RANGE_FILTER_X86 1
+#include <immintrin.h>
+#endif
+
+namespace RangeFilter {
+
+namespace {
+
+// Expand a comparison bitmask into point offsets starting at base
+inline uint32_t emitMask(unsigned mask, uint32_t base, uint32_t* out) {
+    uint32_t written = 0;
+    while (mask) {
+        out[written++] = base + static_cast<uint32_t>(__builtin_ctz(mask));
+        mask &= mask - 1;
+    }
+    return written;
+}
+
+uint32_t scalarFrom(const float* xs, const float* ys, uint32_t begin, uint32_t count,
+                    const Rectangle& range, uint32_t* out) {
+    float x1 = range.x + range.width;
+    float y1 = range.y + range.height;
+    uint32_t written = 0;
+
+    for (uint32_t i = begin; i < count; i++) {
+        // Same comparisons as Rectangle::contains(), without branches
+        bool inside = (xs[i] >= range.x) & (xs[i] < x1) & (ys[i] >= range.y) & (ys[i] < y1);
+        out[written] = i;
+        written += inside ? 1 : 0;
+    }
+    return written;
+}
+
+uint32_t resolve(const float* xs, const float* ys, uint32_t count,
+                 const Rectangle& range, uint32_t* out) {
+    dispatch = get(active());
+    return dispatch(xs, ys, count, range, out);
+}
+
+} // namespace
+
+// Constant-initialized so calls made during static initialization still
+// work, then resolved eagerly before main() so that worker threads only
+// ever read it.
+Function dispatch = resolve;
+
+namespace {
+const bool dispatchResolved = (dispatch = get(active()), true);
+}
+
+uint32_t scalar(const float* xs, const float* ys, uint32_t count,
+                const Rectangle& range, uint32_t* out) {
+    return scalarFrom(xs, ys, 0, count, range, out);
+}
+
+#ifdef RANGE_FILTER_X86
+
+__attribute__((target("sse2")))
+uint32_t sse(const float* xs, const float* ys, uint32_t count,
+             const Rectangle& range, uint32_t* out) {
+    __m128 x0 = _mm_set1_ps(range.x);
+    __m128 y0 = _mm_set1_ps(range.y);
+    __m128 x1 = _mm_set1_ps(range.x + range.width);
+    __m128 y1 = _mm_set1_ps(range.y + range.height);
+
+    uint32_t written = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 px = _mm_loadu_ps(xs + i);
+        __m128 py = _mm_loadu_ps(ys + i);
+        __m128 inX = _mm_and_ps(_mm_cmpge_ps(px, x0), _mm_cmplt_ps(px, x1));
+        __m128 inY = _mm_and_ps(_mm_cmpge_ps(py, y0), _mm_cmplt_ps(py, y1));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_and_ps(inX, inY)));
+        written += emitMask(mask, i, out + written);
+    }
+    return written + scalarFrom(xs, ys, i, count, range, out + written);
+}
+
+__attribute__((target("avx2")))
+uint32_t avx2(const float* xs, const float* ys, uint32_t count,
+              const Rectangle& range, uint32_t* out) {
+    __m256 x0 = _mm256_set1_ps(range.x);
+    __m256 y0 = _mm256_set1_ps(range.y);
+    __m256 x1 = _mm256_set1_ps(range.x + range.width);
+    __m256 y1 = _mm256_set1_ps(range.y + range.height);
+
+    uint32_t written = 0;
+    uint32_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 px = _mm256_loadu_ps(xs + i);
+        __m256 py = _mm256_loadu_ps(ys + i);
+        __m256 inX = _mm256_and_ps(_mm256_cmp_ps(px, x0, _CMP_GE_OQ),
+                                   _mm256_cmp_ps(px, x1, _CMP_LT_OQ));
+        __m256 inY = _mm256_and_ps(_mm256_cmp_ps(py, y0, _CMP_GE_OQ),
+                                   _mm256_cmp_ps(py, y1, _CMP_LT_OQ));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_and_ps(inX, inY)));
+        written += emitMask(mask, i, out + written);
+    }
+    // A half-full block still gets one 4-wide step before the scalar tail
+    if (i + 4 <= count) {
+        __m128 px = _mm_loadu_ps(xs + i);
+        __m128 py = _mm_loadu_ps(ys + i);
+        __m128 inX = _mm_and_ps(_mm_cmpge_ps(px, _mm256_castps256_ps128(x0)),
+                                _mm_cmplt_ps(px, _mm256_castps256_ps128(x1)));
+        __m128 inY = _mm_and_ps(_mm_cmpge_ps(py, _mm256_castps256_ps128(y0)),
+                                _mm_cmplt_ps(py, _mm256_castps256_ps128(y1)));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_and_ps(inX, inY)));
+        written += emitMask(mask, i, out + written);
+        i += 4;
+    }
+    return written + scalarFrom(xs, ys, i, count, range, out + written);
+}
+
+bool supported(Kernel kernel) {
+    __builtin_cpu_init();
+    switch (kernel) {
+        case Kernel::Scalar:
+            return true;
+        case Kernel::SSE:
+            return __builtin_cpu_supports("sse2");
+        case Kernel::AVX2:
+            return __builtin_cpu_supports("avx2");
+    }
+    return false;
+}
+
+#else
+
+uint32_t sse(const float* xs, const float* ys, uint32_t count,
+             const Rectangle& range, uint32_t* out) {
+    return scalar(xs, ys, count, range, out);
+}
+
+uint32_t avx2(const float* xs, const float* ys, uint32_t count,
+              const Rectangle& range, uint32_t* out) {
+    return scalar(xs, ys, count, range, out);
+}
+
+bool supported(Kernel kernel) {
+    return kernel == Kernel::Scalar;
+}
+
+#endif // RANGE_FILTER_X86
+
+Kernel active() {
+    if (supported(Kernel::AVX2)) return Kernel::AVX2;
+    if (supported(Kernel::SSE)) return Kernel::SSE;
+    return Kernel::Scalar;
+}
+
+Function get(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::AVX2:
+            return avx2;
+        case Kernel::SSE:
+            return sse;
+        case Kernel::Scalar:
+            break;
+    }
+    return scalar;
+}
+
+const char* name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::AVX2:
+            return "avx2";
+        case Kernel::SSE:
+            return "sse";
+        case Kernel::Scalar:
+            break;
+    }
+    return "scalar";
+}
+
+} // namespace RangeFilter
@@ -0,0 +1,53 @@
+#ifndef RANGE_FILTER_H
+#define RANGE_FILTER_H
+
+#include "Point.h"
+#include <cstdint>
+
+// Range-filter kernels over structure-of-arrays point buckets.
+//
+// Every kernel writes the offsets of the points inside range to out, which
+// must have room for count entries, and returns how many matched. The SIMD
+// kernels test 4 (SSE) or 8 (AVX2) points per instruction and expand the
+// comparison bitmask into offsets; they give exactly the same results as
+// the scalar loop, which they also use for the tail.
+namespace RangeFilter {
+
+enum class Kernel { Scalar, SSE, AVX2 };
+
+typedef uint32_t (*Function)(const float* xs, const float* ys, uint32_t count,
+                             const Rectangle& range, uint32_t* out);
+
+uint32_t scalar(const float* xs, const float* ys, uint32_t count,
+                const Rectangle& range, uint32_t* out);
+
+// Only valid when supported() reports the kernel for this CPU
+uint32_t sse(const float* xs, const float* ys, uint32_t count,
+             const Rectangle& range, uint32_t* out);
+uint32_t avx2(const float* xs, const float* ys, uint32_t count,
+              const Rectangle& range, uint32_t* out);
+
+// Whether this CPU (and build) can run a kernel
+bool supported(Kernel kernel);
+
+// Best kernel for this CPU, detected once at first use
+Kernel active();
+
+// Kernel function by name, for tests and benchmarks
+Function get(Kernel kernel);
+
+// Name of a kernel for reporting
+const char* name(Kernel kernel);
+
+// Points to the best kernel once resolved; starts at a resolver stub
+extern Function dispatch;
+
+// Filter with the best kernel for this CPU
+inline uint32_t filter(const float* xs, const float* ys, uint32_t count,
+                       const Rectangle& range, uint32_t* out) {
+    return dispatch(xs, ys, count, range, out);
+}
+
+} // namespace RangeFilter
+
+#endif // RANGE_FILTER_H
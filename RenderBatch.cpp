@@ -0,0 +1,138 @@
+#include "RenderBatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+RenderBatch::RenderBatch() : renderer(nullptr), sprite(nullptr), submissions(0) {
+    vertices.reserve(4 * MAX_DISCS);
+    shades.reserve(4 * MAX_DISCS);
+
+    // Every disc and fill uses the same pattern over its own four vertices
+    indices.reserve(6 * MAX_DISCS);
+    for (int i = 0; i < MAX_DISCS; i++) {
+        int v = 4 * i;
+        const int quad[6] = {v, v + 1, v + 2, v + 2, v + 1, v + 3};
+        indices.insert(indices.end(), quad, quad + 6);
+    }
+}
+
+RenderBatch::~RenderBatch() {
+    detach();
+}
+
+bool RenderBatch::attach(SDL_Renderer* target) {
+    detach();
+    renderer = target;
+
+    // A white disc whose edge fades over one texel; vertex colors tint it
+    std::vector<uint32_t> pixels(SPRITE_SIZE * SPRITE_SIZE);
+    float center = SPRITE_SIZE / 2.0f;
+    for (int y = 0; y < SPRITE_SIZE; y++) {
+        for (int x = 0; x < SPRITE_SIZE; x++) {
+            float d = std::hypot(x + 0.5f - center, y + 0.5f - center);
+            float coverage = std::min(1.0f, std::max(0.0f, center - d + 0.5f));
+            uint32_t alpha = static_cast<uint32_t>(coverage * 255.0f + 0.5f);
+            pixels[y * SPRITE_SIZE + x] = (alpha << 24) | 0x00FFFFFFu;
+        }
+    }
+
+    sprite = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC,
+                               SPRITE_SIZE, SPRITE_SIZE);
+    if (!sprite) {
+        return false;
+    }
+    if (SDL_UpdateTexture(sprite, nullptr, pixels.data(), SPRITE_SIZE * sizeof(uint32_t)) != 0) {
+        SDL_DestroyTexture(sprite);
+        sprite = nullptr;
+        return false;
+    }
+    SDL_SetTextureBlendMode(sprite, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+void RenderBatch::detach() {
+    if (sprite) {
+        SDL_DestroyTexture(sprite);
+        sprite = nullptr;
+    }
+    renderer = nullptr;
+    vertices.clear();
+    shades.clear();
+    cells.clear();
+}
+
+void RenderBatch::addDisc(const QuadPoint& point, float radius, const SDL_Color& color) {
+    if (vertices.size() == 4 * static_cast<std::size_t>(MAX_DISCS)) {
+        drawDiscs();
+    }
+
+    // Same pixels the per-pixel loop covered: the point's pixel +- radius
+    float r = std::floor(radius);
+    float left = std::floor(point.x) - r;
+    float top = std::floor(point.y) - r;
+    float size = 2.0f * r + 1.0f;
+    SDL_Vertex corners[4] = {
+        {{left, top}, color, {0, 0}},
+        {{left + size, top}, color, {1, 0}},
+        {{left, top + size}, color, {0, 1}},
+        {{left + size, top + size}, color, {1, 1}},
+    };
+    vertices.insert(vertices.end(), corners, corners + 4);
+}
+
+void RenderBatch::drawDiscs() {
+    if (vertices.empty() || !renderer) {
+        vertices.clear();
+        return;
+    }
+    int discs = static_cast<int>(vertices.size() / 4);
+    SDL_RenderGeometry(renderer, sprite, vertices.data(), static_cast<int>(vertices.size()),
+                       indices.data(), 6 * discs);
+    submissions++;
+    vertices.clear();
+}
+
+void RenderBatch::addShade(const Rectangle& area, const SDL_Color& color) {
+    if (shades.size() == 4 * static_cast<std::size_t>(MAX_DISCS)) {
+        drawShades();
+    }
+    float right = area.x + area.width;
+    float bottom = area.y + area.height;
+    SDL_Vertex corners[4] = {
+        {{area.x, area.y}, color, {0, 0}},
+        {{right, area.y}, color, {0, 0}},
+        {{area.x, bottom}, color, {0, 0}},
+        {{right, bottom}, color, {0, 0}},
+    };
+    shades.insert(shades.end(), corners, corners + 4);
+}
+
+void RenderBatch::drawShades() {
+    if (shades.empty() || !renderer) {
+        shades.clear();
+        return;
+    }
+    int fills = static_cast<int>(shades.size() / 4);
+    SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+    SDL_RenderGeometry(renderer, nullptr, shades.data(), static_cast<int>(shades.size()), indices.data(),
+                       6 * fills);
+    submissions++;
+    shades.clear();
+}
+
+void RenderBatch::addCell(const Rectangle& cell) {
+    // Truncated like drawRectangle() always did
+    cells.push_back(SDL_Rect{static_cast<int>(cell.x), static_cast<int>(cell.y),
+                             static_cast<int>(cell.width), static_cast<int>(cell.height)});
+}
+
+void RenderBatch::drawCells(const SDL_Color& color) {
+    if (cells.empty() || !renderer) {
+        cells.clear();
+        return;
+    }
+    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
+    SDL_RenderDrawRects(renderer, cells.data(), static_cast<int>(cells.size()));
+    submissions++;
+    cells.clear();
+}
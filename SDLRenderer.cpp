@@ -1,17 +1,17 @@
 #include "SDLRenderer.h"
 #include <iostream>
-#include <random>
 #include <cmath>
 
 SDLRenderer::SDLRenderer(int width, int height)
-    : window(nullptr), renderer(nullptr), quadTree(nullptr),
-      windowWidth(width), windowHeight(height), running(false), isDragging(false),
-      showQuery(false), queryStartX(0), queryStartY(0),
+    : window(nullptr), renderer(nullptr), worker(nullptr),
+      windowWidth(width), windowHeight(height), running(false), isDragging(false), isPanning(false),
+      viewX(0), viewY(0), zoom(1), showQuery(false), queryStartX(0), queryStartY(0),
       backgroundColor(20, 20, 30),      // Dark blue background
       boundaryColor(255, 255, 255),     // White boundaries
       pointColor(100, 255, 100),        // Light green points
       queryColor(255, 100, 100),        // Red query rectangle
-      queryResultColor(255, 255, 100)   // Yellow query results
+      queryResultColor(255, 255, 100),  // Yellow query results
+      backgroundTexture(nullptr), sceneTexture(nullptr), sceneDirty(true), sceneVersion(0)
 {
     // Initialize query range
     queryRange = Rectangle(0, 0, 0, 0);
@@ -40,15 +40,23 @@ bool SDLRenderer::initialize() {
     }
     
     // Create renderer
-    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC |
+                                              SDL_RENDERER_TARGETTEXTURE);
     if (renderer == nullptr) {
         std::cerr << "Renderer could not be created! SDL_Error: " << SDL_GetError() << std::endl;
         return false;
     }
+    createSceneTextures();
+    if (!batch.attach(renderer)) {
+        std::cerr << "Point sprite unavailable, drawing squares: " << SDL_GetError() << std::endl;
+    }
     
-    // Initialize QuadTree with window bounds
+    // Initialize QuadTree with window bounds; from here on only the worker
+    // thread touches it
     Rectangle boundary(0, 0, windowWidth, windowHeight);
-    quadTree = new QuadTree(boundary);
+    worker = new SceneWorker(new SpatialTree(boundary));
+    postView();
+    worker->start();
     
     running = true;
     
@@ -60,17 +68,23 @@ bool SDLRenderer::initialize() {
     std::cout << "  Space: Add 50 random points" << std::endl;
     std::cout << "  R: Add 200 random points" << std::endl;
     std::cout << "  C: Clear points" << std::endl;
+    std::cout << "  Wheel / + / -: Zoom" << std::endl;
+    std::cout << "  Middle Drag / Arrows: Pan" << std::endl;
+    std::cout << "  0: Show the whole tree" << std::endl;
     std::cout << "  ESC: Quit" << std::endl;
     
     return true;
 }
 
 void SDLRenderer::cleanup() {
-    if (quadTree) {
-        delete quadTree;
-        quadTree = nullptr;
+    if (worker) {
+        delete worker;
+        worker = nullptr;
     }
     
+    destroySceneTextures();
+    batch.detach();
+    
     if (renderer) {
         SDL_DestroyRenderer(renderer);
         renderer = nullptr;
@@ -84,11 +98,12 @@ void SDLRenderer::cleanup() {
     SDL_Quit();
 }
 
-void SDLRenderer::setQuadTree(QuadTree* tree) {
-    if (quadTree) {
-        delete quadTree;
+void SDLRenderer::setQuadTree(SpatialTree* tree) {
+    if (worker) {
+        worker->replace(tree);
+    } else {
+        delete tree;
     }
-    quadTree = tree;
 }
 
 bool SDLRenderer::handleEvents() {
@@ -111,6 +126,10 @@ bool SDLRenderer::handleEvents() {
                 handleMouseMotion(event);
                 break;
                 
+            case SDL_MOUSEWHEEL:
+                handleMouseWheel(event);
+                break;
+                
             case SDL_KEYDOWN:
                 handleKeyDown(event);
                 break;
@@ -120,23 +139,23 @@ bool SDLRenderer::handleEvents() {
                     windowWidth = event.window.data1;
                     windowHeight = event.window.data2;
                     
-                    // Recreate QuadTree with new bounds
-                    if (quadTree) {
-                        std::vector<QuadPoint> points = quadTree->getAllPoints();
-                        delete quadTree;
-                        Rectangle boundary(0, 0, windowWidth, windowHeight);
-                        quadTree = new QuadTree(boundary);
-                        
-                        // Re-add points that fit in new bounds
-                        for (const QuadPoint& point : points) {
-                            if (point.x >= 0 && point.x < windowWidth && 
-                                point.y >= 0 && point.y < windowHeight) {
-                                quadTree->insert(point);
-                            }
-                        }
+                    // Fit the tree to the new bounds on the worker thread
+                    if (worker) {
+                        worker->resize(Rectangle(0, 0, windowWidth, windowHeight));
                     }
+                    postView();
+                    
+                    // The cached layers are window-sized
+                    destroySceneTextures();
+                    createSceneTextures();
                 }
                 break;
+                
+            case SDL_RENDER_TARGETS_RESET:
+                // Some backends drop texture contents on device loss
+                destroySceneTextures();
+                createSceneTextures();
+                break;
         }
     }
     return running;
@@ -149,6 +168,9 @@ void SDLRenderer::handleMouseDown(const SDL_Event& event) {
         queryStartY = event.button.y;
         isDragging = true;
         showQuery = false;
+        postQuery();
+    } else if (event.button.button == SDL_BUTTON_MIDDLE) {
+        isPanning = true;
     } else if (event.button.button == SDL_BUTTON_RIGHT) {
         // Clear points
         clearPoints();
@@ -164,11 +186,15 @@ void SDLRenderer::handleMouseUp(const SDL_Event& event) {
         
         // If mouse didn't move much, add a point. Otherwise, end query.
         if (deltaX < 5 && deltaY < 5) {
-            addPoint(event.button.x, event.button.y);
+            QuadPoint point = toWorld(event.button.x, event.button.y);
+            addPoint(point.x, point.y);
             showQuery = false;
+            postQuery();
         } else {
             endQuery();
         }
+    } else if (event.button.button == SDL_BUTTON_MIDDLE) {
+        isPanning = false;
     }
 }
 
@@ -176,6 +202,15 @@ void SDLRenderer::handleMouseMotion(const SDL_Event& event) {
     if (isDragging) {
         updateQuery(event.motion.x, event.motion.y);
     }
+    if (isPanning) {
+        pan(static_cast<float>(-event.motion.xrel), static_cast<float>(-event.motion.yrel));
+    }
+}
+
+void SDLRenderer::handleMouseWheel(const SDL_Event& event) {
+    int x, y;
+    SDL_GetMouseState(&x, &y);
+    zoomAt(static_cast<float>(x), static_cast<float>(y), std::pow(1.25f, static_cast<float>(event.wheel.y)));
 }
 
 void SDLRenderer::handleKeyDown(const SDL_Event& event) {
@@ -195,34 +230,57 @@ void SDLRenderer::handleKeyDown(const SDL_Event& event) {
         case SDLK_c:
             clearPoints();
             break;
+            
+        case SDLK_EQUALS:
+            zoomAt(windowWidth / 2.0f, windowHeight / 2.0f, 2.0f);
+            break;
+            
+        case SDLK_MINUS:
+            zoomAt(windowWidth / 2.0f, windowHeight / 2.0f, 0.5f);
+            break;
+            
+        case SDLK_LEFT:
+            pan(-windowWidth / 8.0f, 0);
+            break;
+            
+        case SDLK_RIGHT:
+            pan(windowWidth / 8.0f, 0);
+            break;
+            
+        case SDLK_UP:
+            pan(0, -windowHeight / 8.0f);
+            break;
+            
+        case SDLK_DOWN:
+            pan(0, windowHeight / 8.0f);
+            break;
+            
+        case SDLK_0:
+            resetView();
+            break;
     }
 }
 
 void SDLRenderer::addPoint(float x, float y) {
-    if (quadTree) {
-        QuadPoint point(x, y);
-        quadTree->insert(point);
+    if (worker) {
+        worker->addPoint(QuadPoint(x, y));
     }
 }
 
 void SDLRenderer::addRandomPoints(int count) {
-    if (!quadTree) return;
+    if (!worker) return;
     
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_real_distribution<float> xDist(0, windowWidth);
-    std::uniform_real_distribution<float> yDist(0, windowHeight);
-    
-    for (int i = 0; i < count; i++) {
-        QuadPoint point(xDist(gen), yDist(gen));
-        quadTree->insert(point);
-    }
+    // Scatter over the part of the tree in view
+    QuadPoint low = toWorld(0, 0);
+    QuadPoint high = toWorld(static_cast<float>(windowWidth), static_cast<float>(windowHeight));
+    worker->addRandomPoints(count, Rectangle(low.x, low.y, high.x - low.x, high.y - low.y));
 }
 
 void SDLRenderer::clearPoints() {
-    if (quadTree) {
-        quadTree->clear();
+    if (worker) {
+        worker->clear();
         showQuery = false;
+        postQuery();
     }
 }
 
@@ -233,13 +291,77 @@ void SDLRenderer::startQuery(float x, float y) {
 }
 
 void SDLRenderer::updateQuery(float x, float y) {
-    float minX = std::min(queryStartX, x);
-    float minY = std::min(queryStartY, y);
-    float maxX = std::max(queryStartX, x);
-    float maxY = std::max(queryStartY, y);
+    QuadPoint start = toWorld(queryStartX, queryStartY);
+    QuadPoint end = toWorld(x, y);
+    float minX = std::min(start.x, end.x);
+    float minY = std::min(start.y, end.y);
+    float maxX = std::max(start.x, end.x);
+    float maxY = std::max(start.y, end.y);
     
     queryRange = Rectangle(minX, minY, maxX - minX, maxY - minY);
     showQuery = true;
+    postQuery();
+}
+
+void SDLRenderer::zoomAt(float x, float y, float factor) {
+    float next = std::min(MAX_ZOOM, std::max(MIN_ZOOM, zoom * factor));
+    QuadPoint anchor = toWorld(x, y);
+    zoom = next;
+    viewX = anchor.x - x / zoom;
+    viewY = anchor.y - y / zoom;
+    postView();
+}
+
+void SDLRenderer::pan(float dx, float dy) {
+    viewX += dx / zoom;
+    viewY += dy / zoom;
+    postView();
+}
+
+void SDLRenderer::resetView() {
+    // Fit the whole root in the window
+    Rectangle bounds = worker && worker->frame().version > 0 ? worker->frame().boundary
+                                                             : Rectangle(0, 0, windowWidth, windowHeight);
+    zoom = std::min(windowWidth / bounds.width, windowHeight / bounds.height);
+    viewX = bounds.x - (windowWidth / zoom - bounds.width) / 2;
+    viewY = bounds.y - (windowHeight / zoom - bounds.height) / 2;
+    postView();
+}
+
+void SDLRenderer::postView() {
+    // An eighth of the window on each side, one arrow-key step
+    QuadPoint low = toWorld(-windowWidth / 8.0f, -windowHeight / 8.0f);
+    QuadPoint high = toWorld(windowWidth * 9 / 8.0f, windowHeight * 9 / 8.0f);
+    if (worker) {
+        worker->setView(Rectangle(low.x, low.y, high.x - low.x, high.y - low.y), DETAIL_PIXELS / zoom);
+    }
+    sceneDirty = true;
+}
+
+void SDLRenderer::postQuery() {
+    if (worker) {
+        bool valid = showQuery && queryRange.width > 0 && queryRange.height > 0;
+        worker->setQuery(valid ? queryRange : Rectangle());
+    }
+}
+
+QuadPoint SDLRenderer::toScreen(const QuadPoint& point) const {
+    return QuadPoint((point.x - viewX) * zoom, (point.y - viewY) * zoom);
+}
+
+Rectangle SDLRenderer::toScreen(const Rectangle& rect) const {
+    return Rectangle((rect.x - viewX) * zoom, (rect.y - viewY) * zoom, rect.width * zoom, rect.height * zoom);
+}
+
+QuadPoint SDLRenderer::toWorld(float x, float y) const {
+    return QuadPoint(viewX + x / zoom, viewY + y / zoom);
+}
+
+SDL_Color SDLRenderer::densityColor(const Color& color, const Rectangle& cell, std::size_t points) const {
+    // Log scale, saturating at 256 points per pixel
+    float pixels = std::max(1.0f, cell.width * cell.height * zoom * zoom);
+    float level = std::min(1.0f, std::log2(1.0f + points / pixels) / 8.0f);
+    return SDL_Color{color.r, color.g, color.b, static_cast<Uint8>(64 + 191 * level)};
 }
 
 void SDLRenderer::endQuery() {
@@ -247,20 +369,21 @@ void SDLRenderer::endQuery() {
 }
 
 void SDLRenderer::render() {
-    // Draw enhanced background
-    drawGradientBackground();
-    
-    // Draw subtle grid lines
-    drawGridLines();
-    
-    if (quadTree) {
-        drawQuadTree();
-        drawPoints();
-        
-        if (showQuery) {
-            drawQueryRange();
-            drawQueryResults();
+    // Never waits: the worker's newest frame if there is one, else the last
+    bool fresh = worker && worker->update();
+    if (sceneTexture) {
+        if (sceneDirty || fresh) {
+            SDL_SetRenderTarget(renderer, sceneTexture);
+            updateScene();
+            SDL_SetRenderTarget(renderer, nullptr);
         }
+        SDL_RenderCopy(renderer, sceneTexture, nullptr, nullptr);
+    } else {
+        drawScene(Rectangle(0, 0, windowWidth, windowHeight));
+    }
+    
+    if (worker && showQuery) {
+        drawQueryRange();
     }
     
     // Draw UI elements
@@ -289,50 +412,17 @@ void SDLRenderer::drawRectangle(const Rectangle& rect, const Color& color, bool
     }
 }
 
-void SDLRenderer::drawPoint(const QuadPoint& point, const Color& color, float radius) {
-    SDL_SetRenderDrawColor(renderer, color.r, color.g, color.b, color.a);
-    
-    // Draw a filled circle using SDL_RenderDrawPoints
-    int x = static_cast<int>(point.x);
-    int y = static_cast<int>(point.y);
-    int r = static_cast<int>(radius);
-    
-    // Simple circle drawing algorithm
-    for (int dx = -r; dx <= r; dx++) {
-        for (int dy = -r; dy <= r; dy++) {
-            if (dx * dx + dy * dy <= r * r) {
-                SDL_RenderDrawPoint(renderer, x + dx, y + dy);
-            }
-        }
-    }
-}
-
-void SDLRenderer::drawQuadTree() {
-    std::vector<Rectangle> boundaries = quadTree->getBoundaries();
-    
-    for (const Rectangle& boundary : boundaries) {
-        drawRectangle(boundary, boundaryColor, false);
-    }
-}
-
-void SDLRenderer::drawPoints() {
-    std::vector<QuadPoint> points = quadTree->getAllPoints();
-    
-    for (const QuadPoint& point : points) {
-        drawPoint(point, pointColor, 3.0f);
-    }
-}
-
 void SDLRenderer::drawQueryRange() {
     if (queryRange.width > 0 && queryRange.height > 0) {
         // Draw query rectangle with thicker border
         SDL_SetRenderDrawColor(renderer, queryColor.r, queryColor.g, queryColor.b, queryColor.a);
         
+        Rectangle screen = toScreen(queryRange);
         SDL_Rect rect = {
-            static_cast<int>(queryRange.x),
-            static_cast<int>(queryRange.y),
-            static_cast<int>(queryRange.width),
-            static_cast<int>(queryRange.height)
+            static_cast<int>(screen.x),
+            static_cast<int>(screen.y),
+            static_cast<int>(screen.width),
+            static_cast<int>(screen.height)
         };
         
         // Draw multiple rectangles for thicker border
@@ -346,14 +436,127 @@ void SDLRenderer::drawQueryRange() {
     }
 }
 
-void SDLRenderer::drawQueryResults() {
-    if (queryRange.width > 0 && queryRange.height > 0) {
-        std::vector<QuadPoint> queryPoints = quadTree->query(queryRange);
+void SDLRenderer::createSceneTextures() {
+    backgroundTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                          windowWidth, windowHeight);
+    sceneTexture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET,
+                                     windowWidth, windowHeight);
+    if (!backgroundTexture || !sceneTexture) {
+        std::cerr << "Render targets unavailable, drawing every frame in full: " << SDL_GetError() << std::endl;
+        destroySceneTextures();
+        return;
+    }
+    SDL_SetTextureBlendMode(backgroundTexture, SDL_BLENDMODE_NONE);
+    SDL_SetTextureBlendMode(sceneTexture, SDL_BLENDMODE_NONE);
+    
+    // The background only changes with the window size
+    SDL_SetRenderTarget(renderer, backgroundTexture);
+    drawGradientBackground();
+    drawGridLines();
+    SDL_SetRenderTarget(renderer, nullptr);
+    sceneDirty = true;
+}
+
+void SDLRenderer::destroySceneTextures() {
+    if (backgroundTexture) {
+        SDL_DestroyTexture(backgroundTexture);
+        backgroundTexture = nullptr;
+    }
+    if (sceneTexture) {
+        SDL_DestroyTexture(sceneTexture);
+        sceneTexture = nullptr;
+    }
+}
+
+void SDLRenderer::updateScene() {
+    Rectangle window(0, 0, windowWidth, windowHeight);
+    if (!worker) {
+        drawScene(window);
+        sceneDirty = false;
+        return;
+    }
+    
+    // The texture holds the previous frame under this camera, so only the
+    // regions the worker changed since then need drawing again
+    const SceneFrame& frame = worker->frame();
+    if (!sceneDirty && !frame.redrawAll && frame.version == sceneVersion + 1) {
+        for (const Rectangle& region : frame.dirty) {
+            drawScene(toScreen(region));
+        }
+    } else {
+        drawScene(window);
+    }
+    sceneVersion = frame.version;
+    sceneDirty = false;
+}
+
+void SDLRenderer::drawScene(const Rectangle& region) {
+    // Whole pixels covering the region; everything below is clipped to them
+    int left = std::max(0, static_cast<int>(std::floor(region.x)));
+    int top = std::max(0, static_cast<int>(std::floor(region.y)));
+    int right = std::min(windowWidth, static_cast<int>(std::ceil(region.x + region.width)) + 1);
+    int bottom = std::min(windowHeight, static_cast<int>(std::ceil(region.y + region.height)) + 1);
+    if (right <= left || bottom <= top) {
+        return;
+    }
+    SDL_Rect clip = {left, top, right - left, bottom - top};
+    SDL_RenderSetClipRect(renderer, &clip);
+    
+    if (backgroundTexture) {
+        SDL_RenderCopy(renderer, backgroundTexture, &clip, &clip);
+    } else {
+        drawGradientBackground();
+        drawGridLines();
+    }
+    
+    if (worker) {
+        // The frame may be a camera move behind; drawing it through the
+        // current camera keeps pans and zooms immediate until the next
+        // arrives. Outlines lie on cell edges and discs spill past their
+        // points, so look a little beyond the clip.
+        const SceneFrame& frame = worker->frame();
+        Rectangle area(clip.x - 1.0f, clip.y - 1.0f, clip.w + 2.0f, clip.h + 2.0f);
+        Rectangle reach(area.x - 5, area.y - 5, area.width + 10, area.height + 10);
+        for (const Rectangle& cell : frame.cells) {
+            Rectangle rect = toScreen(cell);
+            if (rect.intersects(area)) {
+                batch.addCell(rect);
+            }
+        }
+        batch.drawCells(SDL_Color{boundaryColor.r, boundaryColor.g, boundaryColor.b, boundaryColor.a});
         
-        for (const QuadPoint& point : queryPoints) {
-            drawPoint(point, queryResultColor, 5.0f);
+        for (const SceneFrame::Shade& shade : frame.shades) {
+            Rectangle rect = toScreen(shade.cell);
+            if (rect.intersects(area)) {
+                batch.addShade(rect, densityColor(pointColor, shade.cell, shade.points));
+            }
         }
+        for (const SceneFrame::Shade& shade : frame.hitShades) {
+            Rectangle rect = toScreen(shade.cell);
+            if (rect.intersects(area)) {
+                batch.addShade(rect, densityColor(queryResultColor, shade.cell, shade.points));
+            }
+        }
+        batch.drawShades();
+        
+        SDL_Color color = {pointColor.r, pointColor.g, pointColor.b, pointColor.a};
+        for (const QuadPoint& point : frame.points) {
+            QuadPoint center = toScreen(point);
+            if (reach.contains(center)) {
+                batch.addDisc(center, 3.0f, color);
+            }
+        }
+        SDL_Color highlight = {queryResultColor.r, queryResultColor.g, queryResultColor.b, queryResultColor.a};
+        for (const QuadPoint& point : frame.hits) {
+            QuadPoint center = toScreen(point);
+            if (reach.contains(center)) {
+                batch.addDisc(center, 5.0f, highlight);
+            }
+        }
+        batch.drawDiscs();
     }
+    
+    SDL_RenderSetClipRect(renderer, nullptr);
 }
 
 void SDLRenderer::drawGradientBackground() {
@@ -387,17 +590,15 @@ void SDLRenderer::drawGridLines() {
 }
 
 void SDLRenderer::drawStats() {
-    if (!quadTree) return;
-    
-    std::vector<QuadPoint> allPoints = quadTree->getAllPoints();
-    std::vector<Rectangle> boundaries = quadTree->getBoundaries();
+    if (!worker) return;
     
-    int totalPoints = allPoints.size();
-    int subdivisions = boundaries.size();
+    const SceneFrame& frame = worker->frame();
+    int totalPoints = static_cast<int>(frame.totalPoints);
+    int subdivisions = static_cast<int>(frame.nodes);
     int queryResults = 0;
     
     if (showQuery && queryRange.width > 0 && queryRange.height > 0) {
-        queryResults = quadTree->query(queryRange).size();
+        queryResults = static_cast<int>(frame.queryHits);
     }
     
     // Draw a semi-transparent background for stats
@@ -418,6 +619,28 @@ void SDLRenderer::drawStats() {
         int py = y + (i / 10) * 3;
         SDL_RenderDrawPoint(renderer, x, py);
     }
+
+#if defined(QUADTREE_STATS) && !defined(SDL_LINEAR_QUADTREE)
+    // Bars from the stats the worker took with the frame: nodes per depth
+    // on the left, leaves per occupancy on the right, each scaled to its
+    // tallest bar
+    auto drawBars = [this](const std::vector<std::size_t>& values, int left, int width) {
+        std::size_t tallest = 1;
+        for (std::size_t value : values) {
+            tallest = std::max(tallest, value);
+        }
+        int barWidth = std::max(1, width / static_cast<int>(std::max<std::size_t>(values.size(), 1)));
+        for (std::size_t i = 0; i < values.size(); i++) {
+            int height = static_cast<int>(30 * values[i] / tallest);
+            SDL_Rect bar = {left + static_cast<int>(i) * barWidth, 82 - height, std::max(1, barWidth - 1), height};
+            SDL_RenderFillRect(renderer, &bar);
+        }
+    };
+    SDL_SetRenderDrawColor(renderer, 120, 180, 255, 255);
+    drawBars(frame.nodesByDepth, 60, 70);
+    SDL_SetRenderDrawColor(renderer, 255, 200, 120, 255);
+    drawBars(frame.leavesByOccupancy, 140, 60);
+#endif
 }
 
 void SDLRenderer::drawInstructions() {
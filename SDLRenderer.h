@@ -3,6 +3,8 @@
 
 #include <SDL2/SDL.h>
 #include "QuadTree.h"
+#include "RenderBatch.h"
+#include "SceneWorker.h"
 #include <vector>
 
 class SDLRenderer {
@@ -18,30 +20,51 @@ public:
     void render();
     void present();
     
-    // QuadTree interaction
-    void setQuadTree(QuadTree* tree);
+    // QuadTree interaction. The tree lives on a SceneWorker thread, so
+    // these queue the change and return at once; it shows up in a frame or
+    // two. setQuadTree() takes ownership and needs initialize() first.
+    void setQuadTree(SpatialTree* tree);
     void addRandomPoints(int count);
     void clearPoints();
-    void addPoint(float x, float y);
+    void addPoint(float x, float y);  // In tree coordinates
     
-    // Query functionality
+    // Query functionality, in window coordinates
     void startQuery(float x, float y);
     void updateQuery(float x, float y);
     void endQuery();
     
+    // Camera: zoom by factor keeping the tree point under window position
+    // (x, y) fixed, pan by a window offset, or go back to the whole tree
+    void zoomAt(float x, float y, float factor);
+    void pan(float dx, float dy);
+    void resetView();
+    
     // Getter for running status
     bool isRunning() const { return running; }
     
 private:
+    // Cells narrower than this many pixels are shaded by point density
+    // instead of being drawn cell by cell and point by point
+    static constexpr float DETAIL_PIXELS = 4.0f;
+    static constexpr float MIN_ZOOM = 0.25f;
+    static constexpr float MAX_ZOOM = 65536.0f;
+    
+
     SDL_Window* window;
     SDL_Renderer* renderer;
-    QuadTree* quadTree;
+    SceneWorker* worker;
     
     int windowWidth, windowHeight;
     bool running;
     bool isDragging;
+    bool isPanning;
     
-    // Query rectangle
+    // Camera: tree point at the window's top-left corner, and pixels per
+    // tree unit
+    float viewX, viewY;
+    float zoom;
+    
+    // Query rectangle, in tree coordinates; the drag start is in pixels
     bool showQuery;
     Rectangle queryRange;
     float queryStartX, queryStartY;
@@ -59,16 +82,53 @@ private:
     Color queryColor;
     Color queryResultColor;
     
+    // Retained scene: the background (gradient and grid) and the worker's
+    // latest frame drawn over it (cells, points, query results) are cached
+    // in textures, so an unchanged frame is one texture copy plus the
+    // overlays. A frame that follows sceneVersion redraws only its dirty
+    // regions; a camera move (sceneDirty) or a skipped frame redraws it
+    // all. Without render target support the textures stay null and every
+    // frame is drawn in full.
+    SDL_Texture* backgroundTexture;
+    SDL_Texture* sceneTexture;
+    bool sceneDirty;
+    uint64_t sceneVersion;
+    
+    // Cells and points go through one batch rather than a call per pixel
+    RenderBatch batch;
+    
+    // Camera transforms between tree coordinates and window pixels
+    QuadPoint toScreen(const QuadPoint& point) const;
+    Rectangle toScreen(const Rectangle& rect) const;
+    QuadPoint toWorld(float x, float y) const;
+    
+    // Fill color for a summarized cell, brighter the more points share
+    // each of its pixels
+    SDL_Color densityColor(const Color& color, const Rectangle& cell, std::size_t points) const;
+    
     // Helper methods
     void drawRectangle(const Rectangle& rect, const Color& color, bool filled = false);
-    void drawPoint(const QuadPoint& point, const Color& color, float radius = 2.0f);
-    void drawQuadTree();
-    void drawPoints();
     void drawQueryRange();
-    void drawQueryResults();
     void drawStats();
     void drawInstructions();
     
+    // Scene cache
+    void createSceneTextures();
+    void destroySceneTextures();
+    
+    // Bring the scene texture up to the worker's frame
+    void updateScene();
+    
+    // Draw the background and the worker's frame under the current camera,
+    // clipped to a region of the window
+    void drawScene(const Rectangle& region);
+    
+    // Tell the worker what the window shows now: the view with a margin,
+    // so short pans have something to show before the next frame arrives,
+    // and the query while one is shown
+    void postView();
+    void postQuery();
+    
     // Enhanced visual features
     void drawGradientBackground();
     void drawGridLines();
@@ -77,6 +137,7 @@ private:
     void handleMouseDown(const SDL_Event& event);
     void handleMouseUp(const SDL_Event& event);
     void handleMouseMotion(const SDL_Event& event);
+    void handleMouseWheel(const SDL_Event& event);
     void handleKeyDown(const SDL_Event& event);
 };
 
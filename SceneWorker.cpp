@@ -0,0 +1,265 @@
+#include "SceneWorker.h"
+#include <algorithm>
+
+namespace {
+
+bool sameRectangle(const Rectangle& a, const Rectangle& b) {
+    return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+} // namespace
+
+SceneWorker::SceneWorker(SpatialTree* tree)
+    : tree(tree), random(std::random_device{}()), published(0),
+      viewMinSize(0), changed(true), stopping(false), dirtyAll(true), frameMinSize(0) {}
+
+SceneWorker::~SceneWorker() {
+    stop();
+}
+
+void SceneWorker::start() {
+    if (thread.joinable()) {
+        return;
+    }
+    stopping = false;
+    thread = std::thread([this]() { run(); });
+}
+
+void SceneWorker::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    if (thread.joinable()) {
+        thread.join();
+    }
+
+    // The worker is gone, so the tree is ours to change
+    std::vector<Command> rest;
+    rest.swap(commands);
+    for (Command& command : rest) {
+        command();
+    }
+}
+
+void SceneWorker::post(Command command) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        commands.push_back(std::move(command));
+    }
+    wake.notify_one();
+}
+
+void SceneWorker::addPoint(const QuadPoint& point) {
+    post([this, point]() {
+        // Any split the insert causes stays inside the point's old leaf
+        Rectangle cell = tree->leafBoundary(point);
+        if (tree->insert(point)) {
+            markDirty(cell);
+        }
+    });
+}
+
+void SceneWorker::addRandomPoints(int count, const Rectangle& area) {
+    post([this, count, area]() {
+        // Only the part of the area inside the tree can take points
+        Rectangle bounds = tree->getBoundary();
+        float x0 = std::max(bounds.x, area.x);
+        float y0 = std::max(bounds.y, area.y);
+        float x1 = std::min(bounds.x + bounds.width, area.x + area.width);
+        float y1 = std::min(bounds.y + bounds.height, area.y + area.height);
+        if (x1 <= x0 || y1 <= y0) {
+            return;
+        }
+        markAllDirty();
+        std::uniform_real_distribution<float> xDist(x0, x1);
+        std::uniform_real_distribution<float> yDist(y0, y1);
+        std::vector<QuadPoint> points;
+        points.reserve(count);
+        for (int i = 0; i < count; i++) {
+            float x = xDist(random);
+            points.emplace_back(x, yDist(random));
+        }
+        tree->insertBatch(points);
+    });
+}
+
+void SceneWorker::clear() {
+    post([this]() {
+        tree->clear();
+        markAllDirty();
+    });
+}
+
+void SceneWorker::replace(SpatialTree* next) {
+    post([this, next]() {
+        tree.reset(next);
+        markAllDirty();
+    });
+}
+
+void SceneWorker::resize(const Rectangle& boundary) {
+    // A minimized or zero-size window has no area to fit
+    if (!(boundary.width > 0) || !(boundary.height > 0)) {
+        return;
+    }
+    post([this, boundary]() {
+        markAllDirty();
+#ifdef SDL_LINEAR_QUADTREE
+        // Keys are relative to the root, so a new one means a rebuild;
+        // build() drops the points outside it
+        std::vector<QuadPoint> points = tree->getAllPoints();
+        tree.reset(new SpatialTree(boundary));
+        tree->build(points);
+#else
+        // Re-root in place: grow until the area is covered, then shrink
+        // while one quadrant still covers it and holds every point
+        tree->expandToInclude(boundary);
+        for (bool shrunk = true; shrunk;) {
+            shrunk = false;
+            Rectangle b = tree->getBoundary();
+            for (uint32_t q = 0; q < 4 && !shrunk; q++) {
+                Rectangle half((q & 1) ? b.x + b.width / 2.0f : b.x, (q & 2) ? b.y + b.height / 2.0f : b.y,
+                               b.width / 2.0f, b.height / 2.0f);
+                shrunk = half.contains(boundary) && tree->shrink(static_cast<QuadTree::Quadrant>(q));
+            }
+        }
+#endif
+    });
+}
+
+void SceneWorker::setView(const Rectangle& area, float minSize) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        viewArea = area;
+        viewMinSize = minSize;
+        changed = true;
+    }
+    wake.notify_one();
+}
+
+void SceneWorker::setQuery(const Rectangle& query) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queryRange = query;
+        changed = true;
+    }
+    wake.notify_one();
+}
+
+void SceneWorker::markDirty(const Rectangle& cell) {
+    if (dirtyAll || dirtyCells.size() >= MAX_DIRTY) {
+        markAllDirty();
+        return;
+    }
+    dirtyCells.push_back(cell);
+}
+
+void SceneWorker::markAllDirty() {
+    dirtyAll = true;
+    dirtyCells.clear();
+}
+
+void SceneWorker::run() {
+    std::vector<Command> batch;
+    while (true) {
+        Rectangle area, query;
+        float minSize;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || changed || !commands.empty(); });
+            if (stopping) {
+                return;
+            }
+            batch.swap(commands);
+            area = viewArea;
+            minSize = viewMinSize;
+            query = queryRange;
+            changed = false;
+        }
+
+        // Everything posted while the last frame was built lands in one
+        // frame, so a burst of changes costs one frame rather than many
+        for (Command& command : batch) {
+            command();
+        }
+        batch.clear();
+        buildFrame(area, minSize, query);
+    }
+}
+
+void SceneWorker::buildFrame(const Rectangle& area, float minSize, const Rectangle& query) {
+    SceneFrame& frame = frames.write();
+    frame.version = ++published;
+    frame.boundary = tree->getBoundary();
+    frame.area = area;
+    frame.query = query;
+    frame.cells.clear();
+    frame.points.clear();
+    frame.shades.clear();
+    frame.hits.clear();
+    frame.hitShades.clear();
+
+    // A new view changes everything drawn; a new query changes the
+    // highlights in its old and new ranges
+    if (!sameRectangle(area, frameArea) || minSize != frameMinSize) {
+        markAllDirty();
+    }
+    if (!sameRectangle(query, frameQuery)) {
+        for (const Rectangle& range : {frameQuery, query}) {
+            if (range.width > 0 && range.height > 0) {
+                markDirty(range);
+            }
+        }
+    }
+    frameArea = area;
+    frameMinSize = minSize;
+    frameQuery = query;
+
+    // A changed cell also recolors the summarized cell around it, which is
+    // narrower than minSize
+    frame.redrawAll = dirtyAll;
+    frame.dirty.clear();
+    for (const Rectangle& cell : dirtyCells) {
+        frame.dirty.emplace_back(cell.x - minSize, cell.y - minSize, cell.width + 2 * minSize,
+                                 cell.height + 2 * minSize);
+    }
+    dirtyCells.clear();
+    dirtyAll = false;
+
+    if (area.width > 0 && area.height > 0) {
+        tree->queryLevelOfDetail(
+            area, minSize, [&frame](const Rectangle& cell) { frame.cells.push_back(cell); },
+            [&frame](const QuadPoint& point) { frame.points.push_back(point); },
+            [&frame](const Rectangle& cell, std::size_t points) {
+                frame.shades.push_back(SceneFrame::Shade{cell, points});
+            });
+    }
+
+    frame.queryHits = 0;
+    if (query.width > 0 && query.height > 0) {
+        frame.queryHits = tree->count(query);
+        float x0 = std::max(query.x, area.x);
+        float y0 = std::max(query.y, area.y);
+        float x1 = std::min(query.x + query.width, area.x + area.width);
+        float y1 = std::min(query.y + query.height, area.y + area.height);
+        if (x1 > x0 && y1 > y0) {
+            tree->queryLevelOfDetail(
+                Rectangle(x0, y0, x1 - x0, y1 - y0), minSize, [](const Rectangle&) {},
+                [&frame](const QuadPoint& point) { frame.hits.push_back(point); },
+                [&frame](const Rectangle& cell, std::size_t points) {
+                    frame.hitShades.push_back(SceneFrame::Shade{cell, points});
+                });
+        }
+    }
+
+    frame.totalPoints = tree->size();
+    frame.nodes = tree->nodeCount();
+#if defined(QUADTREE_STATS) && !defined(SDL_LINEAR_QUADTREE)
+    QuadTreeStats stats = tree->stats();
+    frame.nodesByDepth = stats.nodesByDepth;
+    frame.leavesByOccupancy = stats.leavesByOccupancy;
+#endif
+    frames.publish();
+}
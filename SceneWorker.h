@@ -0,0 +1,155 @@
+#ifndef SCENE_WORKER_H
+#define SCENE_WORKER_H
+
+#include "QuadTree.h"
+#include "TripleBuffer.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Build with -DSDL_LINEAR_QUADTREE (make -f Makefile.sdl linear) to drive
+// the view with LinearQuadTree instead; both have every call used here
+#ifdef SDL_LINEAR_QUADTREE
+#include "LinearQuadTree.h"
+typedef LinearQuadTree SpatialTree;
+#else
+typedef QuadTree SpatialTree;
+#endif
+
+// Everything the view draws from the tree for one frame, in tree
+// coordinates, so the render thread can apply its current camera to it
+struct SceneFrame {
+    // A cell summarized by its point count rather than drawn in detail
+    struct Shade {
+        Rectangle cell;
+        std::size_t points;
+    };
+
+    uint64_t version = 0;   // 0 until the first frame is published
+    Rectangle boundary;     // The tree's root
+    Rectangle area;         // Region the frame was built for
+
+    std::vector<Rectangle> cells;
+    std::vector<QuadPoint> points;
+    std::vector<Shade> shades;
+
+    // Query the highlights are for, empty if none, and what it matched
+    // within area
+    Rectangle query;
+    std::vector<QuadPoint> hits;
+    std::vector<Shade> hitShades;
+
+    // Regions whose drawing changed since frame version - 1, so a renderer
+    // still showing that frame under the same camera need only redraw
+    // these; redrawAll when the change was not local, such as a clear or a
+    // new view
+    std::vector<Rectangle> dirty;
+    bool redrawAll = true;
+
+    std::size_t totalPoints = 0;
+    std::size_t nodes = 0;
+    std::size_t queryHits = 0;  // Over the whole query, not just area
+
+#if defined(QUADTREE_STATS) && !defined(SDL_LINEAR_QUADTREE)
+    std::vector<std::size_t> nodesByDepth;
+    std::vector<std::size_t> leavesByOccupancy;
+#endif
+};
+
+// Owns the visualizer's tree on a thread of its own, so inserts, clears
+// and rebuilds never stall the render loop.
+//
+// The render thread posts changes, which queue up and are applied in
+// order, and the region it wants drawn, of which only the latest counts.
+// After each round of changes the worker builds a SceneFrame with the
+// tree's level-of-detail walk and publishes it through a TripleBuffer; the
+// render thread picks up the newest one when it is ready for it. Frames
+// the renderer was too slow to take are skipped, never queued.
+class SceneWorker {
+public:
+    // Takes ownership of the tree
+    explicit SceneWorker(SpatialTree* tree);
+
+    // Stops the thread if it is running
+    ~SceneWorker();
+
+    SceneWorker(const SceneWorker&) = delete;
+    SceneWorker& operator=(const SceneWorker&) = delete;
+
+    void start();
+
+    // Join the thread. Changes still queued are applied on the calling
+    // thread, so none are lost.
+    void stop();
+
+    // Changes, applied on the worker in the order they were posted
+    void addPoint(const QuadPoint& point);
+    void addRandomPoints(int count, const Rectangle& area);
+    void clear();
+    void replace(SpatialTree* tree);
+
+    // Fit the root to a new area. QuadTree grows and shrinks its root in
+    // place, keeping every point; LinearQuadTree is rebuilt and keeps only
+    // the points inside.
+    void resize(const Rectangle& boundary);
+
+    // Region of the tree to build frames for, and the cell size below
+    // which cells are summarized; only the latest call matters
+    void setView(const Rectangle& area, float minSize);
+
+    // Range whose matches frames highlight; an empty one highlights none
+    void setQuery(const Rectangle& query);
+
+    // Render thread: move to the newest published frame, reporting whether
+    // frame() changed
+    bool update() { return frames.update(); }
+    const SceneFrame& frame() const { return frames.read(); }
+
+private:
+    typedef std::function<void()> Command;
+
+    std::unique_ptr<SpatialTree> tree;  // Touched only by the worker once started
+    std::mt19937 random;
+    TripleBuffer<SceneFrame> frames;
+    uint64_t published;
+
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable wake;
+
+    // Guarded by mutex
+    std::vector<Command> commands;
+    Rectangle viewArea;
+    float viewMinSize;
+    Rectangle queryRange;
+    bool changed;     // A frame is due even without commands
+    bool stopping;
+
+    // What the next frame changes, touched only by the worker: tree cells
+    // the commands changed, and the view and query of the last frame
+    std::vector<Rectangle> dirtyCells;
+    bool dirtyAll;
+    Rectangle frameArea;
+    float frameMinSize;
+    Rectangle frameQuery;
+
+    // Past this many cells a frame is marked for a full redraw instead
+    static constexpr std::size_t MAX_DIRTY = 32;
+
+    void markDirty(const Rectangle& cell);
+    void markAllDirty();
+
+    void post(Command command);
+    void run();
+
+    // Fill and publish the next frame
+    void buildFrame(const Rectangle& area, float minSize, const Rectangle& query);
+};
+
+#endif // SCENE_WORKER_H
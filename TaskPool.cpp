@@ -0,0 +1,115 @@
+#include "TaskPool.h"
+
+namespace {
+
+// Which pool and queue the current thread belongs to, if any
+thread_local const TaskPool* currentPool = nullptr;
+thread_local unsigned currentQueue = 0;
+
+} // namespace
+
+TaskPool::TaskPool(unsigned threads) : queued(0), stopping(false) {
+    if (threads == 0) {
+        threads = 1;
+    }
+
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i + 1 < threads; i++) {
+        workers.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+unsigned TaskPool::self() const {
+    // Workers own queues [0, workers); every other thread shares the last
+    return currentPool == this ? currentQueue : static_cast<unsigned>(workers.size());
+}
+
+void TaskPool::submit(Task task) {
+    Queue& queue = *queues[self()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    // Bump the count under the sleep lock so a worker about to sleep sees it
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued.fetch_add(1, std::memory_order_release);
+    }
+    wake.notify_one();
+}
+
+bool TaskPool::runOne() {
+    unsigned own = self();
+    unsigned count = static_cast<unsigned>(queues.size());
+    Task task;
+
+    // Newest task from our own deque first: it is the most cache-warm
+    {
+        Queue& queue = *queues[own];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+
+    // Otherwise steal the oldest task from someone else
+    for (unsigned i = 1; !task && i < count; i++) {
+        Queue& victim = *queues[(own + i) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    queued.fetch_sub(1, std::memory_order_acq_rel);
+    task();
+    return true;
+}
+
+void TaskPool::waitFor(const std::atomic<std::size_t>& remaining) {
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        if (!runOne()) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentQueue = index;
+
+    for (;;) {
+        if (runOne()) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this]() {
+            return stopping.load() || queued.load(std::memory_order_acquire) > 0;
+        });
+        if (stopping) {
+            return;
+        }
+    }
+}
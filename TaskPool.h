@@ -0,0 +1,97 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A small work-stealing thread pool.
+//
+// Each worker owns a deque: it pushes and pops its own tasks at the back
+// and, when that runs dry, steals from the front of another worker's deque.
+// Threads waiting on a batch run tasks too, so nested parallelFor() calls
+// from inside a task make progress instead of blocking a worker.
+class TaskPool {
+public:
+    // threads counts the calling thread, so TaskPool(1) runs everything
+    // inline and TaskPool(n) starts n - 1 workers
+    explicit TaskPool(unsigned threads = std::thread::hardware_concurrency());
+    ~TaskPool();
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+
+    // Total parallelism, including the calling thread
+    unsigned size() const { return static_cast<unsigned>(workers.size()) + 1; }
+
+    // Call fn(i) for every i in [0, count) and return when all are done.
+    // Indices are handed out in chunks of at least grain.
+    template <typename Fn>
+    void parallelFor(std::size_t count, Fn&& fn, std::size_t grain = 1);
+
+private:
+    typedef std::function<void()> Task;
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // One queue per worker, plus the last one for threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::atomic<std::size_t> queued;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    // Queue a task on the calling thread's own deque
+    void submit(Task task);
+
+    // Run one task from our own deque or a stolen one; false if none found
+    bool runOne();
+
+    // Run tasks until remaining drops to zero
+    void waitFor(const std::atomic<std::size_t>& remaining);
+
+    void workerLoop(unsigned index);
+
+    // Index of the calling thread's queue
+    unsigned self() const;
+};
+
+template <typename Fn>
+void TaskPool::parallelFor(std::size_t count, Fn&& fn, std::size_t grain) {
+    if (count == 0) {
+        return;
+    }
+
+    // A few chunks per thread so stealing can even out uneven work
+    std::size_t chunk = count / (size() * 4);
+    if (chunk < grain) chunk = grain;
+    if (chunk == 0) chunk = 1;
+
+    std::size_t chunks = (count + chunk - 1) / chunk;
+    std::atomic<std::size_t> remaining(chunks);
+
+    for (std::size_t c = 0; c < chunks; c++) {
+        std::size_t begin = c * chunk;
+        std::size_t end = begin + chunk < count ? begin + chunk : count;
+        submit([&fn, &remaining, begin, end]() {
+            for (std::size_t i = begin; i < end; i++) {
+                fn(i);
+            }
+            remaining.fetch_sub(1, std::memory_order_acq_rel);
+        });
+    }
+    waitFor(remaining);
+}
+
+#endif // TASK_POOL_H
@@ -0,0 +1,59 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+// Hands the newest value from one producer thread to one consumer thread
+// without locks or waiting on either side.
+//
+// Three slots rotate between the roles back (being written), middle (last
+// published) and front (being read). publish() swaps back and middle and
+// update() swaps middle and front, each with one atomic exchange, so the
+// producer never blocks on a slow consumer: values the consumer did not
+// get to in time are overwritten, and it always moves to the latest one.
+// Slots are reused, so a T holding vectors keeps their capacity and a
+// steady stream of values stops allocating.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : middle(1), front(0), back(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer: fill the slot returned by write(), then publish() it. The
+    // slot holds whatever was published two rounds ago, not the last value.
+    T& write() { return slots[back]; }
+    void publish() {
+        uint8_t previous = middle.exchange(static_cast<uint8_t>(back | FRESH), std::memory_order_acq_rel);
+        back = previous & INDEX;
+    }
+
+    // Consumer: move to the newest published value if there is one since
+    // the last call, and report whether read() changed
+    bool update() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX;
+        return true;
+    }
+    const T& read() const { return slots[front]; }
+
+private:
+    // The middle index carries a flag saying it was published and not read
+    static constexpr uint8_t INDEX = 3;
+    static constexpr uint8_t FRESH = 4;
+
+    T slots[3];
+
+    // Each side's own index sits apart from the shared one, so a producer
+    // and consumer running flat out do not bounce a cache line
+    alignas(64) std::atomic<uint8_t> middle;
+    alignas(64) uint8_t front;  // Consumer only
+    alignas(64) uint8_t back;   // Producer only
+};
+
+#endif // TRIPLE_BUFFER_H
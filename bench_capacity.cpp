@@ -0,0 +1,208 @@
+#include "QuadTree.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Trade-off curve of leaf capacity and split rule: insert, build and query
+// cost, node count and memory, on uniform and clustered points, then mixed
+// insert/query workloads at fixed capacities against auto-tune.
+// Usage: bench_capacity [points]   (default: 1000000)
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+const size_t QUERIES = 20000;
+
+// Points fed to each mixed workload; the query-heavy ones run long
+const size_t MIXED_POINTS = 200000;
+
+// Queries cover about 0.01% and 1% of the world
+const float SMALL_QUERY = 100.0f;
+const float LARGE_QUERY = 1000.0f;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<QuadPoint> uniformPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+// A few hundred tight Gaussian clusters, like cities on a map
+std::vector<QuadPoint> clusteredPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> center(500, WORLD - 500);
+    std::vector<QuadPoint> centers;
+    for (int i = 0; i < 200; i++) {
+        float x = center(gen);
+        centers.emplace_back(x, center(gen));
+    }
+    std::uniform_int_distribution<size_t> pick(0, centers.size() - 1);
+    std::normal_distribution<float> spread(0, 60);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    while (points.size() < count) {
+        const QuadPoint& c = centers[pick(gen)];
+        float x = c.x + spread(gen);
+        float y = c.y + spread(gen);
+        if (x >= 0 && x < WORLD && y >= 0 && y < WORLD) {
+            points.emplace_back(x, y);
+        }
+    }
+    return points;
+}
+
+// Queries centered on stored points, so they land where the data is
+std::vector<Rectangle> queriesOver(const std::vector<QuadPoint>& points, float size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<size_t> pick(0, points.size() - 1);
+    std::vector<Rectangle> rects;
+    rects.reserve(QUERIES);
+    for (size_t i = 0; i < QUERIES; i++) {
+        const QuadPoint& p = points[pick(gen)];
+        rects.emplace_back(p.x - size / 2, p.y - size / 2, size, size);
+    }
+    return rects;
+}
+
+double queryMicros(const QuadTree& tree, const std::vector<Rectangle>& rects) {
+    std::vector<QuadPoint> result;
+    size_t hits = 0;
+    Clock::time_point start = Clock::now();
+    for (const Rectangle& r : rects) {
+        result.clear();
+        tree.query(r, result);
+        hits += result.size();
+    }
+    double micros = secondsSince(start) * 1e6 / rects.size();
+    if (hits == 0) {
+        std::cerr << "no hits" << std::endl;
+    }
+    return micros;
+}
+
+void sweep(const std::string& name, const std::vector<QuadPoint>& points) {
+    std::vector<Rectangle> small = queriesOver(points, SMALL_QUERY, SEED + 1);
+    std::vector<Rectangle> large = queriesOver(points, LARGE_QUERY, SEED + 2);
+
+    std::cout << name << ", " << points.size() << " points" << std::endl;
+    std::cout << "  capacity  split     insert ns/pt  build ms  small us  large us     nodes  bytes/pt"
+              << std::endl;
+    const char* rules[] = {"midpoint", "centroid"};
+    for (uint32_t capacity = 4; capacity <= 256; capacity *= 2) {
+        for (int rule = 0; rule < 2; rule++) {
+            QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+            tree.setCapacity(capacity);
+            tree.setSplitRule(static_cast<QuadTree::SplitRule>(rule));
+
+            Clock::time_point start = Clock::now();
+            for (const QuadPoint& p : points) {
+                tree.insert(p);
+            }
+            double insertNs = secondsSince(start) * 1e9 / points.size();
+
+            start = Clock::now();
+            tree.build(points);
+            double buildMs = secondsSince(start) * 1e3;
+
+            double smallUs = queryMicros(tree, small);
+            double largeUs = queryMicros(tree, large);
+            std::cout << "  " << std::setw(8) << capacity << "  " << std::left << std::setw(9) << rules[rule]
+                      << std::right << std::fixed << std::setprecision(1) << std::setw(13) << insertNs
+                      << std::setw(10) << buildMs << std::setprecision(2) << std::setw(10) << smallUs
+                      << std::setw(10) << largeUs << std::setw(10) << tree.nodeCount() << std::setprecision(1)
+                      << std::setw(10) << static_cast<double>(tree.memoryUsage()) / points.size() << std::endl;
+        }
+    }
+
+    // Lazy splitting: the insert cost of a flat tree, then the queries
+    // that make the visited leaves split
+    QuadTree lazy(Rectangle(0, 0, WORLD, WORLD));
+    lazy.setCapacity(16);
+    lazy.setLazySplit(true);
+    Clock::time_point start = Clock::now();
+    for (const QuadPoint& p : points) {
+        lazy.insert(p);
+    }
+    double insertNs = secondsSince(start) * 1e9 / points.size();
+    std::size_t flatNodes = lazy.nodeCount();
+    double coldUs = queryMicros(lazy, small);
+    start = Clock::now();
+    std::size_t split = lazy.refine();
+    double refineMs = secondsSince(start) * 1e3;
+    double warmUs = queryMicros(lazy, small);
+    std::cout << "  lazy, capacity 16: insert " << std::setprecision(1) << insertNs << " ns/pt, " << flatNodes
+              << " nodes; small queries " << std::setprecision(2) << coldUs << " us, refine() split " << split
+              << " leaves in " << std::setprecision(1) << refineMs << " ms, then " << std::setprecision(2)
+              << warmUs << " us" << std::endl
+              << std::endl;
+}
+
+// Interleave inserts with small queries, queryShare of the operations
+// being queries, and report the total time per operation
+double mixed(const std::vector<QuadPoint>& points, double queryShare, uint32_t capacity, bool autoTune,
+             uint32_t& finalCapacity) {
+    QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+    tree.setCapacity(capacity);
+    tree.setAutoTune(autoTune);
+    std::vector<Rectangle> rects = queriesOver(points, SMALL_QUERY, SEED + 3);
+    std::mt19937 gen(SEED);
+    std::bernoulli_distribution isQuery(queryShare);
+
+    std::vector<QuadPoint> result;
+    size_t inserted = 0, queried = 0, operations = 0;
+    Clock::time_point start = Clock::now();
+    while (inserted < points.size()) {
+        if (inserted > 0 && isQuery(gen)) {
+            result.clear();
+            tree.query(rects[queried++ % rects.size()], result);
+        } else {
+            tree.insert(points[inserted++]);
+        }
+        operations++;
+    }
+    finalCapacity = tree.getCapacity();
+    return secondsSince(start) * 1e9 / operations;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::vector<QuadPoint> uniform = uniformPoints(count, SEED);
+    std::vector<QuadPoint> clustered = clusteredPoints(count, SEED);
+
+    sweep("Uniform", uniform);
+    sweep("Clustered", clustered);
+
+    std::vector<QuadPoint> prefix(clustered.begin(), clustered.begin() + std::min(count, MIXED_POINTS));
+    std::cout << "Mixed workloads on " << prefix.size() << " clustered points, ns/operation" << std::endl;
+    std::cout << "  queries  capacity 4  capacity 64 capacity 256        auto" << std::endl;
+    const double shares[] = {0.0, 0.5, 0.9};
+    for (double share : shares) {
+        uint32_t chosen = 0;
+        std::cout << "  " << std::setw(6) << static_cast<int>(share * 100) << "%";
+        for (uint32_t capacity : {4u, 64u, 256u}) {
+            std::cout << std::fixed << std::setprecision(1) << std::setw(12)
+                      << mixed(prefix, share, capacity, false, chosen) << " ";
+        }
+        double tuned = mixed(prefix, share, QuadTree::DEFAULT_CAPACITY, true, chosen);
+        std::cout << std::setw(11) << tuned << " (picked " << chosen << ")" << std::endl;
+    }
+    return 0;
+}
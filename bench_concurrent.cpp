@@ -0,0 +1,164 @@
+#include "QuadTree.h"
+#include "ConcurrentQuadTree.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reader latency while a writer streams inserts and removals, for a
+// QuadTree behind one global mutex and for ConcurrentQuadTree snapshots.
+// Usage: bench_concurrent [points] [readers] [seconds]
+//
+// The writer keeps the tree at a steady size: each burst inserts BURST new
+// points and removes the BURST oldest, under one lock for the locked tree
+// and as one batch insert and one batch removal for the concurrent one.
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+const size_t BURST = 256;
+
+using Clock = std::chrono::steady_clock;
+
+std::vector<QuadPoint> uniformPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+struct Result {
+    std::vector<double> latencies;  // Microseconds per query, all readers
+    size_t writes;                  // Points inserted and removed
+    double seconds;
+};
+
+// Run readers calling query(rect, buffer) back to back against a writer
+// calling burst() back to back for the given time; burst returns the
+// number of points it replaced.
+template <typename Query, typename Burst>
+Result run(unsigned readers, double seconds, Query query, Burst burst) {
+    std::atomic<bool> running(true);
+    std::vector<std::vector<double>> perReader(readers);
+    std::vector<std::thread> threads;
+
+    for (unsigned r = 0; r < readers; r++) {
+        threads.emplace_back([&, r]() {
+            std::mt19937 gen(SEED + 1 + r);
+            std::uniform_real_distribution<float> dist(0, WORLD - WORLD / 10);
+            std::vector<QuadPoint> buffer;
+            while (running.load(std::memory_order_relaxed)) {
+                Rectangle rect(dist(gen), dist(gen), WORLD / 10, WORLD / 10);
+                Clock::time_point start = Clock::now();
+                buffer.clear();
+                query(rect, buffer);
+                perReader[r].push_back(
+                    std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+        });
+    }
+
+    Result result;
+    result.writes = 0;
+    Clock::time_point start = Clock::now();
+    while (std::chrono::duration<double>(Clock::now() - start).count() < seconds) {
+        result.writes += burst();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    running = false;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    for (const std::vector<double>& latencies : perReader) {
+        result.latencies.insert(result.latencies.end(), latencies.begin(), latencies.end());
+    }
+    return result;
+}
+
+void report(const std::string& name, Result& result) {
+    std::vector<double>& l = result.latencies;
+    std::sort(l.begin(), l.end());
+    auto percentile = [&l](double p) {
+        return l.empty() ? 0.0 : l[std::min(l.size() - 1, static_cast<size_t>(p * l.size()))];
+    };
+    std::cout << std::left << std::setw(11) << name << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << l.size() / result.seconds << std::setw(10) << percentile(0.5)
+              << std::setw(10) << percentile(0.99) << std::setw(10) << percentile(0.999)
+              << std::setw(11) << (l.empty() ? 0.0 : l.back()) << std::setw(12)
+              << result.writes / result.seconds << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t live = argc > 1 ? std::stoul(argv[1]) : 200000;
+    unsigned readers = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 2;
+    double seconds = argc > 3 ? std::stod(argv[3]) : 2.0;
+
+    // The writer cycles through a pool of points, keeping `live` in the tree
+    std::vector<QuadPoint> points = uniformPoints(live * 4, SEED);
+    Rectangle world(0, 0, WORLD, WORLD);
+
+    std::cout << "Reader latency under continuous writes: " << live << " points, " << readers
+              << " readers, bursts of " << BURST << ", " << seconds << " s per tree, "
+              << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+    std::cout << "tree        queries/s  p50 us    p99 us    p99.9 us  max us     writes/s" << std::endl;
+
+    {
+        QuadTree tree(world);
+        tree.build(points.data(), live);
+        std::mutex lock;
+        size_t next = live;
+        Result result = run(
+            readers, seconds,
+            [&](const Rectangle& rect, std::vector<QuadPoint>& out) {
+                std::lock_guard<std::mutex> guard(lock);
+                tree.query(rect, out);
+            },
+            [&]() {
+                std::lock_guard<std::mutex> guard(lock);
+                for (size_t i = 0; i < BURST; i++) {
+                    tree.insert(points[(next + i) % points.size()]);
+                    tree.remove(points[(next + i - live) % points.size()]);
+                }
+                next += BURST;
+                return BURST;
+            });
+        report("locked", result);
+    }
+    {
+        ConcurrentQuadTree tree(world);
+        tree.insert(points.data(), live);
+        size_t next = live;
+        Result result = run(
+            readers, seconds,
+            [&](const Rectangle& rect, std::vector<QuadPoint>& out) { tree.snapshot().query(rect, out); },
+            [&]() {
+                QuadPoint added[BURST], removed[BURST];
+                for (size_t i = 0; i < BURST; i++) {
+                    added[i] = points[(next + i) % points.size()];
+                    removed[i] = points[(next + i - live) % points.size()];
+                }
+                tree.insert(added, BURST);
+                tree.remove(removed, BURST);
+                next += BURST;
+                return BURST;
+            });
+        report("snapshot", result);
+        std::cout << "  " << tree.retiredCount() << " nodes awaiting reclamation at the end" << std::endl;
+    }
+
+    return 0;
+}
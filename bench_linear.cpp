@@ -0,0 +1,226 @@
+#include "QuadTree.h"
+#include "LinearQuadTree.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Query latency, cache misses and memory of the arena QuadTree against the
+// Morton ordered LinearQuadTree, with float and quantized storage, for a
+// range of point counts.
+// Usage: bench_linear [points...]   (default: 1000000 10000000; pass
+// 100000000 for the largest case, which needs several GB of memory)
+//
+// Cache misses come from the CPU's last-level miss counter through
+// perf_event_open on Linux and are reported as n/a where that is not
+// available (other systems, containers, perf_event_paranoid > 2).
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+const size_t QUERIES = 2000;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<QuadPoint> uniformPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+std::vector<Rectangle> queryRects(size_t count, float size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD - size);
+    std::vector<Rectangle> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        rects.emplace_back(x, dist(gen), size, size);
+    }
+    return rects;
+}
+
+void memory(const std::string& tree, std::size_t bytes, size_t count) {
+    std::cout << "  " << std::left << std::setw(8) << tree << std::right << bytes / (1024 * 1024) << " MB, "
+              << std::setprecision(1) << static_cast<double>(bytes) / count << " bytes/point" << std::endl;
+}
+
+// Counts last-level cache misses of this thread between start() and stop()
+class MissCounter {
+public:
+    MissCounter() : fd(-1) {
+#ifdef __linux__
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#endif
+    }
+
+    ~MissCounter() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start() {
+#ifdef __linux__
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    // Misses since start(), or -1 without a counter
+    long long stop() {
+#ifdef __linux__
+        if (fd < 0) return -1;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long misses = 0;
+        if (read(fd, &misses, sizeof(misses)) != static_cast<ssize_t>(sizeof(misses))) return -1;
+        return misses;
+#else
+        return -1;
+#endif
+    }
+
+private:
+    int fd;
+};
+
+void report(const std::string& tree, const std::string& op, size_t ops, double seconds,
+            long long misses) {
+    std::cout << "  " << std::left << std::setw(8) << tree << std::setw(10) << op << std::right
+              << std::setw(14) << std::fixed << std::setprecision(1) << (seconds * 1e9 / ops) << " ns/op";
+    if (misses >= 0) {
+        std::cout << std::setw(12) << std::setprecision(1) << (static_cast<double>(misses) / ops)
+                  << " misses/op";
+    } else {
+        std::cout << std::setw(12) << "n/a" << " misses/op";
+    }
+    std::cout << std::endl;
+}
+
+// Time the same query sets against one tree; any type with query(range,
+// visitor) works
+template <typename Tree>
+void queries(const std::string& name, const Tree& tree,
+             const std::vector<std::pair<std::string, std::vector<Rectangle>>>& sets,
+             MissCounter& counter) {
+    for (const auto& set : sets) {
+        size_t found = 0;
+        counter.start();
+        Clock::time_point start = Clock::now();
+        for (const Rectangle& range : set.second) {
+            tree.query(range, [&found](const QuadPoint&) { found++; });
+        }
+        double seconds = secondsSince(start);
+        report(name, set.first, set.second.size(), seconds, counter.stop());
+        if (found == 0) std::cout << "  (no hits)" << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++) {
+        sizes.push_back(std::stoul(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {1000000, 10000000};
+    }
+
+    MissCounter counter;
+    std::cout << "QuadTree vs LinearQuadTree, " << QUERIES << " queries per set"
+              << (counter.available() ? "" : " (no cache miss counter)") << std::endl;
+
+    for (size_t count : sizes) {
+        std::vector<QuadPoint> points = uniformPoints(count, SEED);
+
+        // Query sides chosen for about 10, 1000 and 100000 hits each
+        std::vector<std::pair<std::string, std::vector<Rectangle>>> sets;
+        for (double hits : {10.0, 1000.0, 100000.0}) {
+            float side = static_cast<float>(WORLD * std::sqrt(std::min(hits / count, 1.0)));
+            sets.emplace_back("q" + std::to_string(static_cast<long>(hits)),
+                              queryRects(QUERIES, side, SEED + 1));
+        }
+        std::cout << count << " points" << std::endl;
+
+        // One tree at a time so the largest sizes fit in memory
+        {
+            QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+            counter.start();
+            Clock::time_point start = Clock::now();
+            tree.build(points);
+            report("arena", "build", count, secondsSince(start), counter.stop());
+            memory("arena", tree.memoryUsage(), count);
+            queries("arena", tree, sets, counter);
+        }
+        {
+            LinearQuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+            counter.start();
+            Clock::time_point start = Clock::now();
+            tree.build(points);
+            report("linear", "build", count, secondsSince(start), counter.stop());
+            memory("linear", tree.memoryUsage(), count);
+            queries("linear", tree, sets, counter);
+        }
+        {
+            LinearQuadTree tree(Rectangle(0, 0, WORLD, WORLD), LinearQuadTree::DEFAULT_MAX_DEPTH,
+                                LinearQuadTree::STORAGE_QUANTIZED);
+            counter.start();
+            Clock::time_point start = Clock::now();
+            tree.build(points);
+            report("quant", "build", count, secondsSince(start), counter.stop());
+            memory("quant", tree.memoryUsage(), count);
+            queries("quant", tree, sets, counter);
+
+            // How far points moved, matched up by reading back in key order
+            // from a float tree built from the same points
+            LinearQuadTree exact(Rectangle(0, 0, WORLD, WORLD));
+            exact.build(points);
+            std::vector<QuadPoint> stored = exact.getAllPoints();
+            std::vector<QuadPoint> read = tree.getAllPoints();
+            float error = 0;
+            size_t moved = 0;
+            for (size_t i = 0; i < stored.size(); i++) {
+                float d = std::max(std::fabs(stored[i].x - read[i].x), std::fabs(stored[i].y - read[i].y));
+                error = std::max(error, d);
+                moved += d > 0;
+            }
+            std::cout << "  quant   " << moved << " points moved, by at most " << std::scientific
+                      << std::setprecision(2) << error << std::fixed << std::endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "LooseQuadTree.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Box overlap and point-in-box queries on a LooseQuadTree at several
+// looseness settings, against a brute-force scan of every box.
+// Usage: bench_loose [boxes]   (default: 1000000)
+//
+// Boxes are footprint-like: most a few units across, one in a hundred up
+// to 500 units, over a 10000 x 10000 world.
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+const size_t BRUTE_QUERIES = 100;
+const size_t TREE_QUERIES = 20000;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<Rectangle> footprints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> pos(0, WORLD);
+    std::exponential_distribution<float> small(1.0f / 8.0f);
+    std::uniform_real_distribution<float> large(50, 500);
+    std::uniform_int_distribution<int> kind(0, 99);
+    std::vector<Rectangle> boxes;
+    boxes.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        bool big = kind(gen) == 0;
+        float w = big ? large(gen) : 1 + small(gen);
+        float h = big ? large(gen) : 1 + small(gen);
+        float x = std::min(pos(gen), WORLD - w);
+        float y = std::min(pos(gen), WORLD - h);
+        boxes.emplace_back(x, y, w, h);
+    }
+    return boxes;
+}
+
+std::vector<Rectangle> queryRects(size_t count, float size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD - size);
+    std::vector<Rectangle> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        rects.emplace_back(x, dist(gen), size, size);
+    }
+    return rects;
+}
+
+void report(const std::string& name, const std::string& op, size_t queries, double seconds,
+            size_t hits, double baseline) {
+    double micros = seconds * 1e6 / queries;
+    std::cout << "  " << std::left << std::setw(14) << name << std::setw(8) << op << std::right
+              << std::fixed << std::setprecision(2) << std::setw(12) << micros << " us/query"
+              << std::setw(10) << std::setprecision(1) << static_cast<double>(hits) / queries << " hits";
+    if (baseline > 0) {
+        std::cout << std::setw(10) << std::setprecision(0) << baseline / micros << "x";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::vector<Rectangle> boxes = footprints(count, SEED);
+
+    std::vector<std::pair<std::string, std::vector<Rectangle>>> sets;
+    sets.emplace_back("50x50", queryRects(TREE_QUERIES, 50, SEED + 1));
+    sets.emplace_back("500x500", queryRects(TREE_QUERIES, 500, SEED + 2));
+    std::vector<QuadPoint> probes;
+    for (const Rectangle& rect : queryRects(TREE_QUERIES, 0, SEED + 3)) {
+        probes.push_back(QuadPoint(rect.x, rect.y));
+    }
+
+    std::cout << "LooseQuadTree vs brute force, " << count << " boxes" << std::endl;
+
+    // Brute force on the first queries of each set; its cost per query
+    // does not depend on which ones
+    std::vector<double> baselines;
+    for (const auto& set : sets) {
+        size_t hits = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t q = 0; q < BRUTE_QUERIES; q++) {
+            const Rectangle& range = set.second[q];
+            for (const Rectangle& box : boxes) {
+                hits += range.intersects(box) || range.contains(box) ? 1 : 0;
+            }
+        }
+        double seconds = secondsSince(start);
+        report("brute force", set.first, BRUTE_QUERIES, seconds, hits, 0);
+        baselines.push_back(seconds * 1e6 / BRUTE_QUERIES);
+    }
+    {
+        size_t hits = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t q = 0; q < BRUTE_QUERIES; q++) {
+            for (const Rectangle& box : boxes) {
+                hits += box.contains(probes[q]) ? 1 : 0;
+            }
+        }
+        double seconds = secondsSince(start);
+        report("brute force", "point", BRUTE_QUERIES, seconds, hits, 0);
+        baselines.push_back(seconds * 1e6 / BRUTE_QUERIES);
+    }
+
+    for (float looseness : {1.0f, 1.5f, 2.0f}) {
+        LooseQuadTree tree(Rectangle(0, 0, WORLD, WORLD), looseness);
+        Clock::time_point start = Clock::now();
+        for (const Rectangle& box : boxes) {
+            tree.insert(box);
+        }
+        double buildSeconds = secondsSince(start);
+
+        std::ostringstream name;
+        name << "loose " << std::setprecision(2) << looseness;
+        std::cout << name.str() << ": build " << std::fixed << std::setprecision(1)
+                  << buildSeconds * 1000 << " ms, " << tree.nodeCount() << " nodes, "
+                  << tree.rootCount() << " boxes at the root, "
+                  << tree.memoryUsage() / (1024 * 1024) << " MB" << std::endl;
+
+        for (size_t s = 0; s < sets.size(); s++) {
+            size_t hits = 0;
+            start = Clock::now();
+            for (const Rectangle& range : sets[s].second) {
+                tree.query(range, [&hits](LooseQuadTree::Id, const Rectangle&) { hits++; });
+            }
+            report(name.str(), sets[s].first, TREE_QUERIES, secondsSince(start), hits, baselines[s]);
+        }
+        size_t hits = 0;
+        start = Clock::now();
+        for (const QuadPoint& probe : probes) {
+            tree.queryPoint(probe, [&hits](LooseQuadTree::Id, const Rectangle&) { hits++; });
+        }
+        report(name.str(), "point", TREE_QUERIES, secondsSince(start), hits, baselines.back());
+    }
+
+    return 0;
+}
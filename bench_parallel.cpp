@@ -0,0 +1,99 @@
+#include "QuadTree.h"
+#include "TaskPool.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Thread scaling of the parallel bulk build and of batched range queries.
+// Usage: bench_parallel [points] [max threads]
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<QuadPoint> uniformPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+std::vector<Rectangle> queryRects(size_t count, float size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD - size);
+    std::vector<Rectangle> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        rects.emplace_back(x, dist(gen), size, size);
+    }
+    return rects;
+}
+
+void report(unsigned threads, const std::string& op, size_t ops, double seconds, double baseline) {
+    std::cout << std::setw(7) << threads << "  " << std::left << std::setw(8) << op << std::right
+              << std::setw(14) << std::fixed << std::setprecision(1) << (ops / seconds) << " ops/s"
+              << std::setw(9) << std::setprecision(2) << (baseline / seconds) << "x" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    unsigned maxThreads = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2]))
+                                   : std::thread::hardware_concurrency();
+    if (maxThreads == 0) maxThreads = 1;
+
+    std::vector<QuadPoint> points = uniformPoints(count, SEED);
+    std::vector<Rectangle> rects = queryRects(20000, WORLD / 50.0f, SEED + 1);
+
+    std::cout << "Parallel QuadTree benchmark: " << count << " points, " << rects.size()
+              << " queries per batch, up to " << maxThreads << " threads" << std::endl;
+    std::cout << "threads  op                 throughput  speedup" << std::endl;
+
+    // Powers of two below the full thread count, then the full count,
+    // even if it is not a power of two
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < maxThreads; threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    threadCounts.push_back(maxThreads);
+
+    double buildBaseline = 0, queryBaseline = 0;
+    for (unsigned threads : threadCounts) {
+        TaskPool pool(threads);
+        QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+
+        Clock::time_point start = Clock::now();
+        tree.build(points.data(), points.size(), pool);
+        double buildSeconds = secondsSince(start);
+        if (threads == 1) buildBaseline = buildSeconds;
+        report(threads, "build", points.size(), buildSeconds, buildBaseline);
+
+        start = Clock::now();
+        std::vector<std::vector<QuadPoint>> results = tree.queryBatch(rects, pool);
+        double querySeconds = secondsSince(start);
+        if (threads == 1) queryBaseline = querySeconds;
+        report(threads, "query", rects.size(), querySeconds, queryBaseline);
+
+        if (results.empty()) std::cout << "(no queries ran)" << std::endl;
+    }
+
+    return 0;
+}
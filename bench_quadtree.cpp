@@ -0,0 +1,429 @@
+#include "QuadTree.h"
+#include "MappedQuadTree.h"
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <string>
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+
+// The pointer-based layout QuadTree used before nodes moved into an arena:
+// every subdivision makes four heap allocations and every node owns a vector.
+// Kept here so the benchmark can report both layouts side by side.
+class LegacyQuadTree {
+    static const int CAPACITY = 4;
+
+    struct QuadNode {
+        Rectangle boundary;
+        std::vector<QuadPoint> points;
+        std::unique_ptr<QuadNode> northwest, northeast, southwest, southeast;
+        bool divided;
+
+        QuadNode(const Rectangle& boundary) : boundary(boundary), divided(false) {}
+
+        bool insert(const QuadPoint& point) {
+            if (!boundary.contains(point)) return false;
+            if (points.size() < CAPACITY && !divided) {
+                points.push_back(point);
+                return true;
+            }
+            if (!divided) {
+                subdivide();
+                std::vector<QuadPoint> pointsToMove = points;
+                points.clear();
+                for (const QuadPoint& p : pointsToMove) {
+                    if (!northwest->insert(p) && !northeast->insert(p) &&
+                        !southwest->insert(p)) {
+                        southeast->insert(p);
+                    }
+                }
+            }
+            return northwest->insert(point) || northeast->insert(point) ||
+                   southwest->insert(point) || southeast->insert(point);
+        }
+
+        void subdivide() {
+            float x = boundary.x, y = boundary.y;
+            float w = boundary.width / 2.0f, h = boundary.height / 2.0f;
+            northwest = std::make_unique<QuadNode>(Rectangle(x, y, w, h));
+            northeast = std::make_unique<QuadNode>(Rectangle(x + w, y, w, h));
+            southwest = std::make_unique<QuadNode>(Rectangle(x, y + h, w, h));
+            southeast = std::make_unique<QuadNode>(Rectangle(x + w, y + h, w, h));
+            divided = true;
+        }
+
+        void query(const Rectangle& range, std::vector<QuadPoint>& result) const {
+            if (!boundary.intersects(range)) return;
+            for (const QuadPoint& point : points) {
+                if (range.contains(point)) result.push_back(point);
+            }
+            if (divided) {
+                northwest->query(range, result);
+                northeast->query(range, result);
+                southwest->query(range, result);
+                southeast->query(range, result);
+            }
+        }
+    };
+
+    std::unique_ptr<QuadNode> root;
+
+public:
+    LegacyQuadTree(const Rectangle& boundary) : root(std::make_unique<QuadNode>(boundary)) {}
+
+    bool insert(const QuadPoint& point) { return root->insert(point); }
+
+    std::vector<QuadPoint> query(const Rectangle& range) const {
+        std::vector<QuadPoint> result;
+        root->query(range, result);
+        return result;
+    }
+
+    void clear() { root = std::make_unique<QuadNode>(root->boundary); }
+};
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<QuadPoint> uniformPoints(size_t count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+std::vector<Rectangle> queryRects(size_t count, float size, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<float> dist(0, WORLD - size);
+    std::vector<Rectangle> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        rects.emplace_back(x, dist(gen), size, size);
+    }
+    return rects;
+}
+
+void report(const std::string& layout, const std::string& op, size_t ops, double seconds) {
+    std::cout << std::left << std::setw(8) << layout << std::setw(8) << op
+              << std::right << std::setw(14) << std::fixed << std::setprecision(1)
+              << (ops / seconds) << " ops/s" << std::setw(12) << std::setprecision(2)
+              << (seconds * 1e9 / ops) << " ns/op" << std::endl;
+}
+
+// Insert, query and clear throughput for one tree layout
+template <typename Tree>
+void run(const std::string& layout, const std::vector<QuadPoint>& points,
+         const std::vector<Rectangle>& rects) {
+    Tree tree(Rectangle(0, 0, WORLD, WORLD));
+
+    Clock::time_point start = Clock::now();
+    for (const QuadPoint& p : points) tree.insert(p);
+    report(layout, "insert", points.size(), secondsSince(start));
+
+    size_t found = 0;
+    start = Clock::now();
+    for (const Rectangle& r : rects) found += tree.query(r).size();
+    report(layout, "query", rects.size(), secondsSince(start));
+
+    // Clear is timed together with the refill it enables; a tree that is
+    // reused every frame pays for both.
+    const int rounds = 5;
+    start = Clock::now();
+    for (int i = 0; i < rounds; i++) {
+        tree.clear();
+        for (const QuadPoint& p : points) tree.insert(p);
+    }
+    report(layout, "refill", rounds * points.size(), secondsSince(start));
+
+    start = Clock::now();
+    tree.clear();
+    report(layout, "clear", 1, secondsSince(start));
+
+    if (found == 0) std::cout << "(no query hits)" << std::endl;
+}
+
+// Query throughput as the range grows from 0.1% to 100% of the bounds.
+// Large ranges cover whole subtrees, which the arena tree emits without
+// per-point tests and counts from cached subtree totals.
+template <typename Tree>
+void sweep(const std::string& layout, const std::vector<QuadPoint>& points) {
+    Tree tree(Rectangle(0, 0, WORLD, WORLD));
+    for (const QuadPoint& p : points) tree.insert(p);
+
+    const double fractions[] = {0.001, 0.01, 0.1, 0.5, 1.0};
+    for (double fraction : fractions) {
+        float size = WORLD * static_cast<float>(std::sqrt(fraction));
+        std::vector<Rectangle> rects = queryRects(200, size, SEED + 2);
+
+        size_t found = 0;
+        Clock::time_point start = Clock::now();
+        for (const Rectangle& r : rects) found += tree.query(r).size();
+        double seconds = secondsSince(start);
+
+        std::cout << std::left << std::setw(8) << layout << "query " << std::right
+                  << std::setw(6) << std::setprecision(1) << (fraction * 100) << "%"
+                  << std::setw(14) << std::setprecision(2) << (seconds * 1e9 / rects.size())
+                  << " ns/op" << std::setw(10) << (found / rects.size()) << " hits/op"
+                  << std::endl;
+    }
+}
+
+void sweepCount(const std::vector<QuadPoint>& points) {
+    QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+    for (const QuadPoint& p : points) tree.insert(p);
+
+    const double fractions[] = {0.001, 0.01, 0.1, 0.5, 1.0};
+    for (double fraction : fractions) {
+        float size = WORLD * static_cast<float>(std::sqrt(fraction));
+        std::vector<Rectangle> rects = queryRects(200, size, SEED + 2);
+
+        size_t found = 0;
+        Clock::time_point start = Clock::now();
+        for (const Rectangle& r : rects) found += tree.count(r);
+        double seconds = secondsSince(start);
+
+        std::cout << std::left << std::setw(8) << "arena" << "count " << std::right
+                  << std::setw(6) << std::setprecision(1) << (fraction * 100) << "%"
+                  << std::setw(14) << std::setprecision(2) << (seconds * 1e9 / rects.size())
+                  << " ns/op" << std::setw(10) << (found / rects.size()) << " hits/op"
+                  << std::endl;
+    }
+}
+
+// Bulk build against one insert() per point, with the memory each leaves
+void buildVsInsert(const std::vector<QuadPoint>& points) {
+    QuadTree incremental(Rectangle(0, 0, WORLD, WORLD));
+    Clock::time_point start = Clock::now();
+    for (const QuadPoint& p : points) incremental.insert(p);
+    report("insert", "build", points.size(), secondsSince(start));
+
+    QuadTree bulk(Rectangle(0, 0, WORLD, WORLD));
+    start = Clock::now();
+    bulk.build(points);
+    report("bulk", "build", points.size(), secondsSince(start));
+
+    std::cout << std::left << std::setw(8) << "insert" << "memory  " << std::right
+              << std::setw(14) << incremental.memoryUsage() << " bytes" << std::endl;
+    std::cout << std::left << std::setw(8) << "bulk" << "memory  " << std::right
+              << std::setw(14) << bulk.memoryUsage() << " bytes" << std::endl;
+}
+
+// Writing a snapshot and opening it, against rebuilding the tree, and
+// queries served from the mapped file against the heap tree
+void snapshot(const std::vector<QuadPoint>& points, const std::vector<Rectangle>& rects) {
+    QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+    tree.build(points);
+
+    const std::string path = "bench_quadtree.qts";
+    Clock::time_point start = Clock::now();
+    if (!tree.save(path)) {
+        std::cout << "(could not write " << path << ")" << std::endl;
+        return;
+    }
+    report("save", "write", points.size(), secondsSince(start));
+
+    MappedQuadTree mapped;
+    start = Clock::now();
+    bool opened = mapped.open(path);
+    double openSeconds = secondsSince(start);
+    std::cout << std::left << std::setw(8) << "mapped" << std::setw(8) << "open" << std::right
+              << std::setw(14) << std::fixed << std::setprecision(1) << (openSeconds * 1e6)
+              << " us total" << std::endl;
+
+    size_t found = 0;
+    start = Clock::now();
+    for (const Rectangle& r : rects) tree.query(r, [&found](const QuadPoint&) { found++; });
+    report("heap", "query", rects.size(), secondsSince(start));
+
+    start = Clock::now();
+    for (const Rectangle& r : rects) mapped.query(r, [&found](const QuadPoint&) { found++; });
+    report("mapped", "query", rects.size(), secondsSince(start));
+
+    if (!opened || found == 0) std::cout << "(snapshot not served)" << std::endl;
+    mapped.close();
+    std::remove(path.c_str());
+}
+
+// kNN and radius search against brute force and against the old workaround
+// of querying a bounding rectangle and filtering the copies it returns
+void proximity(const std::vector<QuadPoint>& points) {
+    QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+    tree.build(points);
+
+    std::vector<QuadPoint> centers = uniformPoints(500, SEED + 3);
+    const size_t k = 10;
+    const float radius = WORLD / 100.0f;
+    size_t found = 0;
+
+    Clock::time_point start = Clock::now();
+    for (const QuadPoint& c : centers) found += tree.nearest(c, k).size();
+    report("tree", "knn", centers.size(), secondsSince(start));
+
+    start = Clock::now();
+    std::vector<std::pair<float, size_t>> scored(points.size());
+    for (const QuadPoint& c : centers) {
+        for (size_t i = 0; i < points.size(); i++) scored[i] = {points[i].distanceSquared(c), i};
+        std::partial_sort(scored.begin(), scored.begin() + k, scored.end());
+        found += k;
+    }
+    report("brute", "knn", centers.size(), secondsSince(start));
+
+    // Grow a square around the center until it holds k points, then widen
+    // it to the circle through the k-th point and sort what comes back
+    start = Clock::now();
+    for (const QuadPoint& c : centers) {
+        float half = radius;
+        std::vector<QuadPoint> box;
+        for (;;) {
+            box = tree.query(Rectangle(c.x - half, c.y - half, 2 * half, 2 * half));
+            if (box.size() >= k || half > WORLD) break;
+            half *= 2;
+        }
+        auto closer = [&c](const QuadPoint& a, const QuadPoint& b) {
+            return a.distanceSquared(c) < b.distanceSquared(c);
+        };
+        std::nth_element(box.begin(), box.begin() + (k - 1), box.end(), closer);
+        float reach = std::sqrt(box[k - 1].distanceSquared(c));
+        box = tree.query(Rectangle(c.x - reach, c.y - reach, 2 * reach, 2 * reach));
+        std::partial_sort(box.begin(), box.begin() + k, box.end(), closer);
+        found += k;
+    }
+    report("rect", "knn", centers.size(), secondsSince(start));
+
+    start = Clock::now();
+    for (const QuadPoint& c : centers) found += tree.queryRadius(c, radius).size();
+    report("tree", "radius", centers.size(), secondsSince(start));
+
+    start = Clock::now();
+    for (const QuadPoint& c : centers) {
+        for (const QuadPoint& p : points) found += p.distanceSquared(c) <= radius * radius ? 1 : 0;
+    }
+    report("brute", "radius", centers.size(), secondsSince(start));
+
+    start = Clock::now();
+    for (const QuadPoint& c : centers) {
+        std::vector<QuadPoint> box = tree.query(Rectangle(c.x - radius, c.y - radius, 2 * radius, 2 * radius));
+        for (const QuadPoint& p : box) found += p.distanceSquared(c) <= radius * radius ? 1 : 0;
+    }
+    report("rect", "radius", centers.size(), secondsSince(start));
+
+    if (found == 0) std::cout << "(no proximity hits)" << std::endl;
+}
+
+// One simulation tick: every point drifts a little. Compares update() by
+// id and by position with remove() + insert() and with rebuilding the
+// whole tree.
+void churn(const std::vector<QuadPoint>& points) {
+    std::vector<QuadPoint> before = points;
+    std::vector<QuadPoint> after = points;
+    std::mt19937 gen(SEED + 4);
+    std::uniform_real_distribution<float> step(-5.0f, 5.0f);
+    for (QuadPoint& p : after) {
+        p.x = std::min(std::max(p.x + step(gen), 0.0f), WORLD - 1.0f);
+        p.y = std::min(std::max(p.y + step(gen), 0.0f), WORLD - 1.0f);
+    }
+
+    QuadTree tree(Rectangle(0, 0, WORLD, WORLD));
+    tree.build(before);
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < points.size(); i++) tree.update(static_cast<QuadTree::Id>(i), after[i]);
+    report("update#", "tick", points.size(), secondsSince(start));
+
+    tree.build(before);
+    start = Clock::now();
+    for (size_t i = 0; i < points.size(); i++) tree.update(before[i], after[i]);
+    report("update", "tick", points.size(), secondsSince(start));
+
+    tree.build(before);
+    start = Clock::now();
+    for (size_t i = 0; i < points.size(); i++) {
+        tree.remove(before[i]);
+        tree.insert(after[i]);
+    }
+    report("rm+ins", "tick", points.size(), secondsSince(start));
+
+    start = Clock::now();
+    tree.build(after);
+    report("rebuild", "tick", points.size(), secondsSince(start));
+}
+
+// Raw throughput of each range-filter kernel over one large SoA bucket
+void filterKernels(const std::vector<QuadPoint>& points) {
+    std::vector<float> xs, ys;
+    for (const QuadPoint& p : points) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+    }
+    std::vector<uint32_t> out(points.size());
+    Rectangle range(WORLD / 4, WORLD / 4, WORLD / 2, WORLD / 2);
+    uint32_t count = static_cast<uint32_t>(points.size());
+
+    const RangeFilter::Kernel kernels[] = {RangeFilter::Kernel::Scalar, RangeFilter::Kernel::SSE,
+                                           RangeFilter::Kernel::AVX2};
+    for (RangeFilter::Kernel kernel : kernels) {
+        if (!RangeFilter::supported(kernel)) continue;
+        RangeFilter::Function filter = RangeFilter::get(kernel);
+
+        const int rounds = 20;
+        size_t found = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < rounds; i++) found += filter(xs.data(), ys.data(), count, range, out.data());
+        report(RangeFilter::name(kernel), "filter", rounds * points.size(), secondsSince(start));
+        if (found == 0) std::cout << "(no filter hits)" << std::endl;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 200000;
+
+    std::vector<QuadPoint> points = uniformPoints(count, SEED);
+    std::vector<Rectangle> rects = queryRects(10000, WORLD / 100.0f, SEED + 1);
+
+    std::cout << "QuadTree benchmark: " << count << " points, "
+              << rects.size() << " queries" << std::endl;
+
+    run<LegacyQuadTree>("legacy", points, rects);
+    run<QuadTree>("arena", points, rects);
+
+    std::cout << "\nQuery area sweep" << std::endl;
+    sweep<LegacyQuadTree>("legacy", points);
+    sweep<QuadTree>("arena", points);
+    sweepCount(points);
+
+    std::cout << "\nBulk build vs incremental insert" << std::endl;
+    buildVsInsert(points);
+
+    std::cout << "\nSnapshot save and memory-mapped open" << std::endl;
+    snapshot(points, rects);
+
+    std::cout << "\nNearest-neighbour and radius search" << std::endl;
+    proximity(points);
+
+    std::cout << "\nMoving points (per point moved)" << std::endl;
+    churn(points);
+
+    std::cout << "\nRange filter kernels (active: "
+              << RangeFilter::name(RangeFilter::active()) << ")" << std::endl;
+    filterKernels(points);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+#include "QuadTree.h"
+#include "RenderBatch.h"
+#include <SDL2/SDL.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+// Frame time of drawing a whole tree (every cell outline and every point as
+// a radius 3 disc) point by point, as SDLRenderer used to, and through
+// RenderBatch. Draws with SDL's software renderer into an offscreen
+// surface, so it needs no window or GPU.
+// Usage: bench_render [max points]   (default: 1000000)
+
+namespace {
+
+const int WIDTH = 1024;
+const int HEIGHT = 768;
+const unsigned SEED = 12345;
+
+// Frames per measurement, fewer for the slow path on big trees
+const int FRAMES = 10;
+
+using Clock = std::chrono::steady_clock;
+
+// The old path: one SDL_RenderDrawRect per cell, one SDL_RenderDrawPoint
+// per disc pixel
+std::size_t drawPerPixel(SDL_Renderer* renderer, const QuadTree& tree) {
+    std::size_t calls = 0;
+    SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+    for (const Rectangle& cell : tree.getBoundaries()) {
+        SDL_Rect rect = {static_cast<int>(cell.x), static_cast<int>(cell.y), static_cast<int>(cell.width),
+                         static_cast<int>(cell.height)};
+        SDL_RenderDrawRect(renderer, &rect);
+        calls++;
+    }
+    SDL_SetRenderDrawColor(renderer, 100, 255, 100, 255);
+    const int r = 3;
+    tree.query(tree.getBoundary(), [&](const QuadPoint& point) {
+        int x = static_cast<int>(point.x);
+        int y = static_cast<int>(point.y);
+        for (int dx = -r; dx <= r; dx++) {
+            for (int dy = -r; dy <= r; dy++) {
+                if (dx * dx + dy * dy <= r * r) {
+                    SDL_RenderDrawPoint(renderer, x + dx, y + dy);
+                    calls++;
+                }
+            }
+        }
+    });
+    return calls;
+}
+
+std::size_t drawBatched(RenderBatch& batch, const QuadTree& tree) {
+    batch.resetCalls();
+    for (const Rectangle& cell : tree.getBoundaries()) {
+        batch.addCell(cell);
+    }
+    batch.drawCells(SDL_Color{255, 255, 255, 255});
+    SDL_Color color = {100, 255, 100, 255};
+    tree.query(tree.getBoundary(), [&](const QuadPoint& point) { batch.addDisc(point, 3.0f, color); });
+    batch.drawDiscs();
+    return batch.calls();
+}
+
+template <typename Draw>
+void measure(SDL_Renderer* renderer, const std::string& name, std::size_t points, int frames, Draw draw) {
+    std::size_t calls = 0;
+    Clock::time_point start = Clock::now();
+    for (int f = 0; f < frames; f++) {
+        SDL_SetRenderDrawColor(renderer, 20, 20, 30, 255);
+        SDL_RenderClear(renderer);
+        calls = draw();
+        SDL_RenderPresent(renderer);
+    }
+    double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / frames;
+    std::cout << std::setw(9) << points << "  " << std::left << std::setw(11) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(11) << ms << " ms/frame" << std::setw(12)
+              << calls << " calls" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::size_t maxPoints = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, WIDTH, HEIGHT, 32, SDL_PIXELFORMAT_ARGB8888);
+    SDL_Renderer* renderer = surface ? SDL_CreateSoftwareRenderer(surface) : nullptr;
+    if (!renderer) {
+        std::cerr << "Cannot create a software renderer: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    RenderBatch batch;
+    if (!batch.attach(renderer)) {
+        std::cerr << "Point sprite unavailable, batched discs draw as squares" << std::endl;
+    }
+
+    std::cout << "Whole-tree frame time, software renderer, " << WIDTH << "x" << HEIGHT << std::endl;
+    std::mt19937 gen(SEED);
+    std::uniform_real_distribution<float> x(0, WIDTH), y(0, HEIGHT);
+    for (std::size_t points = 10000; points <= maxPoints; points *= 10) {
+        std::vector<QuadPoint> data;
+        data.reserve(points);
+        for (std::size_t i = 0; i < points; i++) {
+            float px = x(gen);
+            data.emplace_back(px, y(gen));
+        }
+        QuadTree tree(Rectangle(0, 0, WIDTH, HEIGHT));
+        tree.build(data);
+
+        int slowFrames = points >= 1000000 ? 1 : FRAMES;
+        measure(renderer, "per-pixel", points, slowFrames, [&]() { return drawPerPixel(renderer, tree); });
+        measure(renderer, "batched", points, FRAMES, [&]() { return drawBatched(batch, tree); });
+    }
+
+    batch.detach();
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    return 0;
+}
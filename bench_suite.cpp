@@ -0,0 +1,318 @@
+#include "QuadTree.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+// Regression benchmark suite: every QuadTree operation on fixed-seed
+// workloads, written as JSON for comparison between releases.
+// Usage: bench_suite [--sizes 1000,10000,...] [--distributions uniform,...]
+//                    [--out results.json]
+//
+// Distributions: uniform; clustered (Gaussian blobs); grid (points on a
+// lattice, many exactly on split lines); duplicates (each position stored
+// about 100 times, which drives leaves into overflow). Sizes default to
+// 1K through 10M. Progress goes to stderr and the JSON to --out, or to
+// stdout without it.
+//
+// Each result has the operation, its unit (point, query, node or call),
+// ns per unit, units per second, and the process's peak resident set size
+// after the operation. On Linux the peak is reset before each workload, so
+// it covers that workload's trees rather than the whole run.
+
+namespace {
+
+const float WORLD = 10000.0f;
+const unsigned SEED = 12345;
+
+// Short operations repeat until they have run this long, or until runs
+// and their untimed setup together pass MAX_SECONDS
+const double MIN_SECONDS = 0.05;
+const double MAX_SECONDS = 1.0;
+
+// Points per insertBatch() call, like a stream arriving in chunks
+const size_t BATCH = 50000;
+
+// Query batches are sized to visit about this many points in total
+const double QUERY_BUDGET = 2e7;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+std::vector<QuadPoint> uniform(size_t count, std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(0, WORLD);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        points.emplace_back(x, dist(gen));
+    }
+    return points;
+}
+
+std::vector<QuadPoint> clustered(size_t count, std::mt19937& gen) {
+    const int blobs = 32;
+    std::vector<QuadPoint> centers = uniform(blobs, gen);
+    std::uniform_int_distribution<int> pick(0, blobs - 1);
+    std::normal_distribution<float> spread(0, WORLD / 100);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    while (points.size() < count) {
+        const QuadPoint& c = centers[pick(gen)];
+        QuadPoint p(c.x + spread(gen), c.y + spread(gen));
+        if (p.x >= 0 && p.x < WORLD && p.y >= 0 && p.y < WORLD) {
+            points.push_back(p);
+        }
+    }
+    return points;
+}
+
+std::vector<QuadPoint> grid(size_t count, std::mt19937& gen) {
+    // Power-of-two lattices put rows exactly on the tree's split lines
+    size_t side = 1;
+    while (side * side < count) {
+        side *= 2;
+    }
+    float spacing = WORLD / side;
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        points.emplace_back((i % side) * spacing, (i / side) * spacing);
+    }
+    std::shuffle(points.begin(), points.end(), gen);
+    return points;
+}
+
+std::vector<QuadPoint> duplicates(size_t count, std::mt19937& gen) {
+    std::vector<QuadPoint> positions = uniform(std::max<size_t>(count / 100, 1), gen);
+    std::uniform_int_distribution<size_t> pick(0, positions.size() - 1);
+    std::vector<QuadPoint> points;
+    points.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        points.push_back(positions[pick(gen)]);
+    }
+    return points;
+}
+
+typedef std::vector<QuadPoint> (*Generator)(size_t, std::mt19937&);
+
+struct Distribution {
+    const char* name;
+    Generator generate;
+};
+
+const Distribution DISTRIBUTIONS[] = {
+    {"uniform", uniform}, {"clustered", clustered}, {"grid", grid}, {"duplicates", duplicates}};
+
+std::vector<Rectangle> queryRects(size_t count, float size, std::mt19937& gen) {
+    std::uniform_real_distribution<float> dist(0, WORLD - size);
+    std::vector<Rectangle> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        float x = dist(gen);
+        rects.emplace_back(x, dist(gen), size, size);
+    }
+    return rects;
+}
+
+// Peak resident set size of the process in bytes
+long peakRss() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss;
+#else
+    return usage.ru_maxrss * 1024L;
+#endif
+}
+
+// Start a new peak where the kernel allows it (Linux), so each workload
+// reports its own; elsewhere the peak covers the run so far
+void resetPeakRss() {
+#ifdef __linux__
+    std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+}
+
+struct Result {
+    std::string distribution;
+    size_t points;
+    std::string operation;
+    std::string unit;
+    double units;    // Units per run
+    double seconds;  // Seconds per run
+    long peakRss;
+    std::size_t hits;
+};
+
+std::vector<Result> results;
+
+// Time body() after setup() until MIN_SECONDS have passed; setup is not timed
+void measure(const std::string& distribution, size_t points, const std::string& operation,
+             const std::string& unit, double units, const std::function<void()>& setup,
+             const std::function<void()>& body, std::size_t hits = 0) {
+    Clock::time_point begin = Clock::now();
+    double total = 0;
+    int runs = 0;
+    do {
+        setup();
+        Clock::time_point start = Clock::now();
+        body();
+        total += secondsSince(start);
+        runs++;
+    } while (total < MIN_SECONDS && secondsSince(begin) < MAX_SECONDS);
+
+    Result result{distribution, points, operation, unit, units, total / runs, peakRss(), hits};
+    results.push_back(result);
+    std::cerr << std::left << std::setw(11) << distribution << std::right << std::setw(9) << points
+              << "  " << std::left << std::setw(14) << operation << std::right << std::fixed
+              << std::setprecision(2) << std::setw(12) << result.seconds * 1e9 / units << " ns/"
+              << unit << std::endl;
+}
+
+void runWorkload(const Distribution& distribution, size_t count) {
+    resetPeakRss();
+    std::mt19937 gen(SEED + static_cast<unsigned>(count));
+    std::vector<QuadPoint> points = distribution.generate(count, gen);
+    Rectangle world(0, 0, WORLD, WORLD);
+    const std::string name = distribution.name;
+    double n = static_cast<double>(count);
+
+    std::unique_ptr<QuadTree> tree;
+    auto fresh = [&]() { tree.reset(new QuadTree(world)); };
+    auto nothing = []() {};
+
+    measure(name, count, "insert", "point", n, fresh, [&]() {
+        for (const QuadPoint& p : points) tree->insert(p);
+    });
+    measure(name, count, "insertBatch", "point", n, fresh, [&]() {
+        for (size_t i = 0; i < count; i += BATCH) {
+            tree->insertBatch(points.data() + i, std::min(BATCH, count - i));
+        }
+    });
+    measure(name, count, "build", "point", n, fresh, [&]() { tree->build(points); });
+
+    // Range queries from 0.01% to 10% of the area
+    const double fractions[] = {0.0001, 0.001, 0.01, 0.1};
+    for (double fraction : fractions) {
+        float side = WORLD * static_cast<float>(std::sqrt(fraction));
+        size_t queries = static_cast<size_t>(std::min(2000.0, std::max(10.0, QUERY_BUDGET / (n * fraction))));
+        std::vector<Rectangle> rects = queryRects(queries, side, gen);
+        std::vector<QuadPoint> buffer;
+        std::size_t hits = 0;
+        std::ostringstream operation;
+        operation << "query_" << fraction * 100 << "%";
+        measure(name, count, operation.str(), "query", static_cast<double>(queries), nothing, [&]() {
+            hits = 0;
+            for (const Rectangle& r : rects) {
+                buffer.clear();
+                tree->query(r, buffer);
+                hits += buffer.size();
+            }
+        });
+        results.back().hits = hits;
+    }
+
+    measure(name, count, "getAllPoints", "point", n, nothing, [&]() {
+        std::vector<QuadPoint> all = tree->getAllPoints();
+        if (all.size() != tree->size()) std::cerr << "(getAllPoints lost points)" << std::endl;
+    });
+    double nodes = static_cast<double>(tree->nodeCount());
+    measure(name, count, "getBoundaries", "node", nodes, nothing, [&]() {
+        std::vector<Rectangle> boundaries = tree->getBoundaries();
+        if (boundaries.empty()) std::cerr << "(no boundaries)" << std::endl;
+    });
+
+    // Clear is cheap, so each run needs a refilled tree from setup
+    measure(name, count, "clear", "call", 1, [&]() { tree->build(points); }, [&]() { tree->clear(); });
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+void writeJson(std::ostream& out) {
+    out << "{\n  \"suite\": \"quadtree\",\n  \"seed\": " << SEED << ",\n  \"results\": [\n";
+    out << std::setprecision(6);
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        double nsPerOp = r.seconds * 1e9 / r.units;
+        out << "    {\"distribution\": \"" << r.distribution << "\", \"points\": " << r.points
+            << ", \"operation\": \"" << r.operation << "\", \"unit\": \"" << r.unit
+            << "\", \"ns_per_op\": " << std::defaultfloat << nsPerOp
+            << ", \"ops_per_sec\": " << r.units / r.seconds << ", \"peak_rss_bytes\": " << r.peakRss;
+        if (r.unit == "query") {
+            out << ", \"hits\": " << r.hits;
+        }
+        out << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<size_t> sizes = {1000, 10000, 100000, 1000000, 10000000};
+    std::vector<std::string> names;
+    for (const Distribution& d : DISTRIBUTIONS) names.push_back(d.name);
+    std::string outPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--sizes" && i + 1 < argc) {
+            sizes.clear();
+            for (const std::string& size : split(argv[++i])) sizes.push_back(std::stoul(size));
+        } else if (arg == "--distributions" && i + 1 < argc) {
+            names = split(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else {
+            std::cerr << "Usage: bench_suite [--sizes 1000,10000,...] "
+                      << "[--distributions uniform,clustered,grid,duplicates] [--out file]" << std::endl;
+            return 1;
+        }
+    }
+
+    for (const std::string& name : names) {
+        const Distribution* found = nullptr;
+        for (const Distribution& d : DISTRIBUTIONS) {
+            if (name == d.name) found = &d;
+        }
+        if (!found) {
+            std::cerr << "Unknown distribution " << name << std::endl;
+            return 1;
+        }
+        for (size_t count : sizes) runWorkload(*found, count);
+    }
+
+    if (outPath.empty()) {
+        writeJson(std::cout);
+    } else {
+        std::ofstream out(outPath);
+        writeJson(out);
+        if (!out) {
+            std::cerr << "Cannot write " << outPath << std::endl;
+            return 1;
+        }
+        std::cerr << "Wrote " << results.size() << " results to " << outPath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+#include "QuadTree.h"
+#include "PointLoader.h"
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Stream a CSV or raw float32 point file into a QuadTree and report the
+// ingest rate.
+// Usage: ingest [options] file
+//   --format csv|bin      File format (default: from the extension)
+//   --bounds x y w h      Tree boundary (default: 0 0 10000 10000)
+//   --chunk bytes         Read size (default: 1 MB)
+//   --save snapshot       Write the loaded tree with QuadTree::save()
+//   --parse-only          Parse without building a tree, to time the loader
+//   --generate N          Write N uniform random points to file instead
+
+namespace {
+
+void usage() {
+    std::cerr << "Usage: ingest [--format csv|bin] [--bounds x y w h] [--chunk bytes]\n"
+              << "              [--save snapshot] [--parse-only] [--generate N] file" << std::endl;
+}
+
+bool generate(const std::string& path, PointLoader::Format format, size_t count,
+              const Rectangle& bounds) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        return false;
+    }
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<float> dx(bounds.x, bounds.x + bounds.width);
+    std::uniform_real_distribution<float> dy(bounds.y, bounds.y + bounds.height);
+    if (format == PointLoader::Format::CSV) {
+        out << "x,y\n" << std::setprecision(9);
+    }
+    for (size_t i = 0; i < count; i++) {
+        float xy[2] = {dx(gen), dy(gen)};
+        if (format == PointLoader::Format::Binary) {
+            out.write(reinterpret_cast<const char*>(xy), sizeof(xy));
+        } else {
+            out << xy[0] << ',' << xy[1] << '\n';
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    PointLoader::Format format = PointLoader::Format::Auto;
+    Rectangle bounds(0, 0, 10000, 10000);
+    size_t chunk = PointLoader::DEFAULT_CHUNK;
+    size_t generateCount = 0;
+    bool parseOnly = false;
+    std::string savePath;
+    std::string path;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--format" && i + 1 < argc) {
+            std::string name = argv[++i];
+            format = name == "bin" ? PointLoader::Format::Binary : PointLoader::Format::CSV;
+        } else if (arg == "--bounds" && i + 4 < argc) {
+            bounds = Rectangle(std::stof(argv[i + 1]), std::stof(argv[i + 2]),
+                               std::stof(argv[i + 3]), std::stof(argv[i + 4]));
+            i += 4;
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            chunk = std::stoul(argv[++i]);
+        } else if (arg == "--save" && i + 1 < argc) {
+            savePath = argv[++i];
+        } else if (arg == "--parse-only") {
+            parseOnly = true;
+        } else if (arg == "--generate" && i + 1 < argc) {
+            generateCount = std::stoul(argv[++i]);
+        } else if (!arg.empty() && arg[0] != '-' && path.empty()) {
+            path = arg;
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (path.empty()) {
+        usage();
+        return 1;
+    }
+    if (format == PointLoader::Format::Auto) {
+        format = PointLoader::detect(path);
+    }
+
+    if (generateCount > 0) {
+        if (!generate(path, format, generateCount, bounds)) {
+            std::cerr << "Cannot write " << path << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << generateCount << " points to " << path << std::endl;
+        return 0;
+    }
+
+    QuadTree tree(bounds);
+    PointLoader loader(chunk);
+    bool loaded = parseOnly ? loader.load(path, format, [](const QuadPoint*, size_t) {})
+                            : loader.load(path, format, tree);
+    if (!loaded) {
+        std::cerr << "Cannot read " << path << std::endl;
+        return 1;
+    }
+
+    const PointLoader::Stats& stats = loader.stats();
+    double seconds = stats.seconds > 0 ? stats.seconds : 1e-9;
+    std::cout << std::fixed << std::setprecision(1)
+              << "Read      " << stats.bytes / (1024.0 * 1024.0) << " MB in "
+              << seconds * 1000 << " ms (" << stats.bytes / (1024.0 * 1024.0) / seconds << " MB/s)\n"
+              << "Parsed    " << stats.points << " points (" << stats.points / seconds / 1e6
+              << " M points/s), " << stats.malformed << " malformed lines" << std::endl;
+    if (parseOnly) {
+        return 0;
+    }
+    std::cout << "Inserted  " << stats.inserted << " points, "
+              << stats.points - stats.inserted << " outside the bounds\n"
+              << "Tree      " << tree.nodeCount() << " nodes, "
+              << tree.memoryUsage() / (1024.0 * 1024.0) << " MB" << std::endl;
+
+    if (!savePath.empty()) {
+        if (!tree.save(savePath)) {
+            std::cerr << "Cannot write " << savePath << std::endl;
+            return 1;
+        }
+        std::cout << "Saved     " << savePath << std::endl;
+    }
+    return 0;
+}
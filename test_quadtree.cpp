@@ -1,6 +1,22 @@
 #include "QuadTree.h"
+#include "LinearQuadTree.h"
+#include "MappedQuadTree.h"
+#include "ConcurrentQuadTree.h"
+#include "LooseQuadTree.h"
+#include "PointLoader.h"
+#include "TaskPool.h"
+#include "TripleBuffer.h"
 #include <iostream>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
 
 int main() {
     // Create a QuadTree with a 100x100 boundary
@@ -28,6 +44,20 @@ int main() {
     assert(results.size() == 2);
     std::cout << "✓ Query test passed - found " << results.size() << " points" << std::endl;
     
+    // Test the allocation-free query variants
+    std::vector<QuadPoint> buffer(1, QuadPoint(-1, -1));
+    tree.query(queryRange, buffer);
+    assert(buffer.size() == 3);  // appends after existing contents
+    assert(tree.count(queryRange) == 2);
+    
+    int visited = 0;
+    bool completed = tree.query(boundary, [&visited](const QuadPoint&) {
+        visited++;
+        return visited < 3;
+    });
+    assert(!completed && visited == 3);
+    std::cout << "✓ Visitor, buffer and count query tests passed" << std::endl;
+    
     // Test getting all points
     std::vector<QuadPoint> allPoints = tree.getAllPoints();
     assert(allPoints.size() == 4);
@@ -37,11 +67,923 @@ int main() {
     std::vector<Rectangle> boundaries = tree.getBoundaries();
     std::cout << "✓ Tree has " << boundaries.size() << " subdivisions" << std::endl;
     
+    // Test subtree counts once the root has subdivided
+    QuadTree counted(boundary);
+    for (const QuadPoint& point : {p1, p2, p3, p4, QuadPoint(15, 15)}) {
+        assert(counted.insert(point));
+    }
+    assert(counted.size() == 5 && counted.getBoundaries().size() > 1);
+    assert(counted.count(boundary) == 5);
+    assert(counted.count(Rectangle(0, 0, 50, 50)) == 3);
+    assert(counted.query(Rectangle(0, 0, 50, 50)).size() == 3);
+    std::cout << "✓ Subtree count test passed" << std::endl;
+    
+    // Test that a bulk-loaded tree matches one built by insertion
+    std::mt19937 buildGen(11);
+    std::uniform_real_distribution<float> buildDist(0, 100);
+    std::vector<QuadPoint> bulkPoints;
+    QuadTree incremental(boundary);
+    for (int i = 0; i < 1000; i++) {
+        bulkPoints.emplace_back(buildDist(buildGen), buildDist(buildGen));
+        incremental.insert(bulkPoints.back());
+    }
+    bulkPoints.emplace_back(150, 150);  // outside the boundary, dropped
+    QuadTree bulk(boundary);
+    assert(bulk.build(bulkPoints) == 1000);
+    assert(bulk.size() == 1000);
+    assert(bulk.nodeCount() == incremental.nodeCount());
+    assert(bulk.count(Rectangle(10, 20, 30, 40)) == incremental.count(Rectangle(10, 20, 30, 40)));
+    assert(bulk.query(Rectangle(10, 20, 30, 40)).size() == incremental.query(Rectangle(10, 20, 30, 40)).size());
+    std::cout << "✓ Bulk build test passed" << std::endl;
+
+    // Test that the linear Morton tree has the same cells and answers
+    LinearQuadTree linear(boundary);
+    LinearQuadTree linearBulk(boundary);
+    for (const QuadPoint& p : bulkPoints) {
+        linear.insert(p);
+    }
+    assert(linearBulk.build(bulkPoints) == 1000 && linear.size() == 1000);
+    std::vector<Rectangle> cells = incremental.getBoundaries();
+    std::vector<Rectangle> linearCells = linear.getBoundaries();
+    assert(linearCells.size() == cells.size() && linear.nodeCount() == incremental.nodeCount());
+    for (size_t i = 0; i < cells.size(); i++) {
+        assert(linearCells[i].x == cells[i].x && linearCells[i].y == cells[i].y);
+        assert(linearCells[i].width == cells[i].width);
+    }
+    assert(linearBulk.nodeCount() == linear.nodeCount());
+    for (const Rectangle& range :
+         {Rectangle(10, 20, 30, 40), Rectangle(0, 0, 50, 50), Rectangle(62.5f, 0, 37.5f, 100)}) {
+        assert(linear.query(range).size() == incremental.count(range));
+        assert(linearBulk.count(range) == incremental.count(range));
+    }
+    assert(linear.getAllPoints().size() == 1000);
+    Rectangle region(20, 30, 15, 10);
+    Rectangle leaf = incremental.leafBoundary(bulkPoints[0]);
+    Rectangle linearLeaf = linear.leafBoundary(bulkPoints[0]);
+    assert(leaf.contains(bulkPoints[0]) && leaf.x == linearLeaf.x && leaf.width == linearLeaf.width);
+    assert(incremental.count(leaf) <= 4);
+
+    // Level-of-detail walks stop at the size limit and account for every
+    // point, either drawn or inside an aggregated cell
+    auto detail = [](const auto& tree, const Rectangle& range, float minSize) {
+        std::size_t cellCount = 0, drawn = 0, aggregated = 0;
+        tree.queryLevelOfDetail(
+            range, minSize,
+            [&](const Rectangle& cell) {
+                assert(std::max(cell.width, cell.height) >= minSize);
+                cellCount++;
+            },
+            [&](const QuadPoint& p) {
+                assert(range.contains(p));
+                drawn++;
+            },
+            [&](const Rectangle& cell, std::size_t points) {
+                assert(std::max(cell.width, cell.height) < minSize && points > 0);
+                aggregated += points;
+            });
+        return std::vector<std::size_t>{cellCount, drawn, aggregated};
+    };
+    std::vector<std::size_t> full = detail(incremental, boundary, 0.0f);
+    assert(full[0] == cells.size() && full[1] == 1000 && full[2] == 0);
+    std::vector<std::size_t> summary = detail(incremental, boundary, 10.0f);
+    assert(summary[0] < cells.size() && summary[1] + summary[2] == 1000 && summary[2] > 0);
+    assert(detail(linear, boundary, 10.0f) == summary);
+    assert(detail(linear, region, 5.0f) == detail(incremental, region, 5.0f));
+    std::cout << "✓ Linear quadtree test passed" << std::endl;
+    
+    // Test the parallel build and batched queries against the serial ones
+    TaskPool pool(4);
+    QuadTree parallel(boundary);
+    assert(parallel.build(bulkPoints.data(), bulkPoints.size(), pool) == 1000);
+    assert(parallel.nodeCount() == bulk.nodeCount());
+    std::vector<Rectangle> batch = {Rectangle(0, 0, 50, 50), Rectangle(25, 25, 10, 60), boundary};
+    std::vector<std::vector<QuadPoint>> batchResults = parallel.queryBatch(batch, pool);
+    for (size_t i = 0; i < batch.size(); i++) {
+        assert(batchResults[i].size() == bulk.count(batch[i]));
+    }
+    std::cout << "✓ Parallel build and batch query test passed" << std::endl;
+    
+    // Test radius and nearest-neighbour search against brute force
+    QuadPoint probe(40, 60);
+    size_t inRadius = 0;
+    std::vector<float> distances;
+    for (size_t i = 0; i < 1000; i++) {
+        float d = bulkPoints[i].distanceSquared(probe);
+        if (d <= 12.0f * 12.0f) inRadius++;
+        distances.push_back(d);
+    }
+    std::sort(distances.begin(), distances.end());
+    assert(bulk.queryRadius(probe, 12.0f).size() == inRadius);
+    std::vector<QuadPoint> nearest = bulk.nearest(probe, 7);
+    assert(nearest.size() == 7);
+    for (size_t i = 0; i < nearest.size(); i++) {
+        assert(nearest[i].distanceSquared(probe) == distances[i]);
+    }
+    assert(bulk.nearest(probe, 5000).size() == 1000);
+    std::vector<QuadPoint> everything = bulk.nearest(probe, SIZE_MAX);
+    assert(everything.size() == 1000 && everything.back().distanceSquared(probe) == distances.back());
+    std::cout << "✓ Radius and nearest-neighbour test passed" << std::endl;
+    
+    // Test removal and in-place updates, including merge-back
+    QuadTree moving(boundary);
+    for (int i = 0; i < 200; i++) {
+        assert(moving.insert(bulkPoints[i]));
+    }
+    assert(!moving.remove(QuadPoint(-5, -5)));
+    assert(moving.update(bulkPoints[0], QuadPoint(bulkPoints[0].x + 0.001f, bulkPoints[0].y)));
+    assert(moving.update(QuadPoint(bulkPoints[0].x + 0.001f, bulkPoints[0].y), QuadPoint(99, 1)));
+    assert(moving.count(Rectangle(98.5f, 0.5f, 1, 1)) >= 1);
+    assert(!moving.update(QuadPoint(99, 1), QuadPoint(150, 150)));
+    assert(moving.size() == 200);
+    for (int i = 0; i < 200; i++) {
+        QuadPoint target(static_cast<float>(i % 100), static_cast<float>(i / 2));
+        assert(moving.update(i == 0 ? QuadPoint(99, 1) : bulkPoints[i], target));
+    }
+    assert(moving.size() == 200 && moving.count(Rectangle(0, 0, 100, 100)) == 200);
+    for (int i = 0; i < 200; i++) {
+        assert(moving.remove(QuadPoint(static_cast<float>(i % 100), static_cast<float>(i / 2))));
+    }
+    assert(moving.size() == 0 && moving.nodeCount() == 1);
+    std::cout << "✓ Remove and update test passed" << std::endl;
+
+    // Test growing and shrinking the root around existing points
+    QuadTree rooted(boundary);
+    for (int i = 0; i < 300; i++) {
+        rooted.insert(bulkPoints[i]);
+    }
+    std::size_t rootedNodes = rooted.nodeCount();
+    assert(rooted.grow(QuadTree::NW) && rooted.grow(QuadTree::SE));
+    Rectangle grown = rooted.getBoundary();
+    assert(grown.x == -200 && grown.y == -200 && grown.width == 400 && grown.height == 400);
+    assert(rooted.size() == 300 && rooted.nodeCount() == rootedNodes + 8);
+    Rectangle window(10, 20, 30, 40);
+    std::size_t inWindow = std::count_if(bulkPoints.begin(), bulkPoints.begin() + 300,
+                                         [&window](const QuadPoint& p) { return window.contains(p); });
+    assert(rooted.count(window) == inWindow && rooted.query(window).size() == inWindow);
+    for (QuadTree::Id id = 0; id < 300; id++) {
+        assert(rooted.contains(id) && rooted.position(id) == bulkPoints[id]);
+    }
+    assert(rooted.remove(bulkPoints[5]) && rooted.insert(bulkPoints[5], 5));
+#ifdef QUADTREE_STATS
+    // The live structure counts follow the root moving up a level
+    QuadTreeStats grownStats = rooted.stats();
+    std::size_t grownLeaves = 0, grownPoints = 0, grownNodes = 0;
+    for (std::size_t count : grownStats.nodesByDepth) {
+        grownNodes += count;
+    }
+    for (size_t k = 0; k < grownStats.leavesByOccupancy.size(); k++) {
+        grownLeaves += grownStats.leavesByOccupancy[k];
+        grownPoints += k * grownStats.leavesByOccupancy[k];
+    }
+    assert(grownNodes == rooted.nodeCount() && grownPoints == 300 && grownLeaves == grownStats.leaves);
+    assert(grownStats.nodesByDepth[0] == 1 && grownStats.nodesByDepth[1] == 4 && grownStats.nodesByDepth[2] == 4);
+#endif
+    assert(!rooted.insert(QuadPoint(300, 5)));
+    rooted.setAutoExpand(true);
+    assert(rooted.insert(QuadPoint(300, 5), 1000) && rooted.getBoundary().contains(QuadPoint(300, 5)));
+    assert(!rooted.shrink(QuadTree::NW) && rooted.remove(QuadTree::Id(1000)));
+    while (rooted.getBoundary().width > 100) {
+        // Step into whichever quadrant still covers the original bounds
+        Rectangle b = rooted.getBoundary();
+        uint32_t q = (boundary.x >= b.x + b.width / 2 ? 1 : 0) + (boundary.y >= b.y + b.height / 2 ? 2 : 0);
+        assert(rooted.shrink(static_cast<QuadTree::Quadrant>(q)));
+    }
+    assert(rooted.getBoundary().x == 0 && rooted.getBoundary().width == 100);
+    assert(rooted.nodeCount() == rootedNodes && rooted.size() == 300);
+#ifdef QUADTREE_STATS
+    QuadTree reference(boundary);
+    for (int i = 0; i < 300; i++) {
+        reference.insert(bulkPoints[i]);
+    }
+    assert(rooted.stats().nodesByDepth == reference.stats().nodesByDepth);
+    assert(rooted.stats().leavesByOccupancy == reference.stats().leavesByOccupancy);
+#endif
+    assert(!rooted.shrink(QuadTree::NE) && rooted.getBoundary().width == 100);
+
+    // Shrinking frees the empty quadrants grow() left divided, and stops
+    // before an empty root gets too small to split
+    QuadTree cycled(boundary);
+    for (int i = 0; i < 100; i++) {
+        assert(cycled.grow(QuadTree::SE) && cycled.grow(QuadTree::SE) && cycled.shrink(QuadTree::NW));
+        assert(cycled.nodeCount() == 1 && cycled.getBoundaries().size() == 1);
+        assert(cycled.shrink(QuadTree::NW) && cycled.getBoundary().width == 100);
+        QuadPoint inside(cycled.getBoundary().x + 60, cycled.getBoundary().y + 70);
+        assert(cycled.insert(inside) && cycled.grow(QuadTree::NW) && cycled.grow(QuadTree::SE));
+        assert(cycled.shrink(QuadTree::SE) && cycled.shrink(QuadTree::NW) && cycled.nodeCount() == 1);
+        assert(cycled.remove(inside) && cycled.size() == 0);
+    }
+#ifdef QUADTREE_STATS
+    QuadTreeStats cycledStats = cycled.stats();
+    assert(cycledStats.nodesByDepth.size() == 1 && cycledStats.nodesByDepth[0] == 1);
+    assert(cycledStats.leaves == 1 && cycledStats.leavesByOccupancy[0] == 1);
+#endif
+    int halvings = 0;
+    while (cycled.shrink(QuadTree::NW)) {
+        halvings++;
+    }
+    Rectangle smallest = cycled.getBoundary();
+    assert(halvings > 0 && halvings < 200 && smallest.width > 0 && smallest.height > 0);
+    assert(cycled.insert(QuadPoint(smallest.x, smallest.y)) && cycled.size() == 1);
+
+    // A removal that merges above grown roots gathers their whole subtrees
+    QuadTree expanded(boundary);
+    expanded.setAutoExpand(true);
+    assert(expanded.insert(QuadPoint(10, 10)) && expanded.insert(QuadPoint(350, 350)));
+    assert(expanded.getBoundary().width == 400 && expanded.remove(QuadTree::Id(1)));
+    assert(expanded.size() == 1 && expanded.getAllPoints().size() == 1 && expanded.contains(QuadTree::Id(0)));
+    assert(expanded.nodeCount() == 1);
+    for (int i = 0; i < 5; i++) {
+        assert(expanded.insert(QuadPoint(20.0f + i * 70.0f, 30.0f + i * 60.0f)));
+    }
+    assert(expanded.size() == 6 && expanded.getAllPoints().size() == 6);
+    assert(expanded.count(expanded.getBoundary()) == 6 && expanded.contains(QuadTree::Id(0)));
+#ifdef QUADTREE_STATS
+    QuadTreeStats expandedStats = expanded.stats();
+    std::size_t expandedNodes = 0;
+    for (std::size_t n : expandedStats.nodesByDepth) {
+        expandedNodes += n;
+    }
+    assert(expandedNodes == expanded.nodeCount());
+#endif
+
+    // Shrinking loosens the depth limit, so a full overflow leaf splits on
+    // its next insert
+    QuadTree limited(Rectangle(0, 0, 128, 128), 2);
+    for (int i = 0; i < 20; i++) {
+        limited.insert(QuadPoint(1.0f + (i % 5) * 2.0f, 1.0f + (i / 5) * 2.0f));
+    }
+    assert(limited.overflowCount() == 1);
+    assert(limited.shrink(QuadTree::NW) && limited.shrink(QuadTree::NW));
+    assert(limited.getBoundary().width == 32 && limited.size() == 20);
+    assert(limited.insert(QuadPoint(3.5f, 3.5f)) && limited.size() == 21);
+    assert(limited.count(limited.getBoundary()) == 21 && limited.query(Rectangle(0, 0, 4, 4)).size() == 5);
+    for (QuadTree::Id id = 0; id < 21; id++) {
+        assert(limited.remove(id));
+    }
+    assert(limited.size() == 0 && limited.nodeCount() == 1);
+    std::cout << "✓ Grow and shrink test passed" << std::endl;
+
+    // Test runtime leaf capacity, centroid splits, lazy splitting and
+    // auto-tune against brute force
+    auto bruteCount = [&bulkPoints](const Rectangle& r) {
+        return static_cast<std::size_t>(std::count_if(bulkPoints.begin(), bulkPoints.begin() + 1000,
+                                                      [&r](const QuadPoint& p) { return r.contains(p); }));
+    };
+    Rectangle slice(15, 5, 40, 70);
+    QuadTree sized(boundary);
+    for (int i = 0; i < 1000; i++) {
+        sized.insert(bulkPoints[i]);
+    }
+    assert(!sized.setCapacity(0) && !sized.setCapacity(QuadTree::MAX_CAPACITY + 1));
+    assert(sized.getCapacity() == QuadTree::DEFAULT_CAPACITY);
+    assert(sized.remove(QuadTree::Id(7)) && sized.setCapacity(64) && sized.getCapacity() == 64);
+    assert(sized.size() == 999 && sized.nodeCount() < incremental.nodeCount() && !sized.contains(7));
+    for (QuadTree::Id id = 0; id < 1000; id++) {
+        assert(id == 7 || sized.position(id) == bulkPoints[id]);
+    }
+    assert(sized.insert(bulkPoints[7], 7) && sized.count(slice) == bruteCount(slice));
+    assert(sized.query(slice).size() == bruteCount(slice) && sized.nearestIds(bulkPoints[9], 1)[0] == 9);
+#ifdef QUADTREE_STATS
+    QuadTreeStats sizedStats = sized.stats();
+    std::size_t sizedPoints = 0;
+    for (size_t k = 0; k < sizedStats.leavesByOccupancy.size(); k++) {
+        sizedPoints += k * sizedStats.leavesByOccupancy[k];
+    }
+    assert(sizedStats.leavesByOccupancy.size() == 66 && sizedPoints == 1000);
+#endif
+    for (QuadTree::Id id = 0; id < 1000; id++) {
+        assert(sized.remove(id));
+    }
+    assert(sized.size() == 0 && sized.nodeCount() == 1);
+
+    // A tight cluster in a corner: halving needs levels of empty cells to
+    // reach it, centroid splits go straight to it
+    std::mt19937 clusterGen(5);
+    std::normal_distribution<float> clusterDist(2.0f, 0.5f);
+    std::vector<QuadPoint> corner;
+    QuadTree halved(boundary);
+    QuadTree centered(boundary);
+    centered.setSplitRule(QuadTree::SPLIT_CENTROID);
+    for (int i = 0; i < 500; i++) {
+        QuadPoint p(std::max(0.0f, clusterDist(clusterGen)), std::max(0.0f, clusterDist(clusterGen)));
+        corner.push_back(p);
+        assert(halved.insert(p) && centered.insert(p));
+    }
+    assert(centered.nodeCount() < halved.nodeCount());
+    QuadTree centeredBulk(boundary);
+    centeredBulk.setSplitRule(QuadTree::SPLIT_CENTROID);
+    centeredBulk.build(corner);
+    for (const Rectangle& r : {Rectangle(1, 1, 2, 2), Rectangle(0, 2, 5, 0.5f), boundary}) {
+        assert(centered.count(r) == halved.count(r) && centeredBulk.count(r) == halved.count(r));
+        assert(centered.query(r).size() == halved.count(r));
+    }
+    for (QuadTree::Id id = 0; id < 500; id++) {
+        assert(centered.remove(id));
+    }
+    assert(centered.size() == 0 && centered.nodeCount() == 1);
+    QuadTree wideSerial(boundary);
+    QuadTree wideParallel(boundary);
+    for (QuadTree* wide : {&wideSerial, &wideParallel}) {
+        wide->setCapacity(16);
+        wide->setSplitRule(QuadTree::SPLIT_CENTROID);
+    }
+    assert(wideSerial.build(bulkPoints) == 1000);
+    assert(wideParallel.build(bulkPoints.data(), bulkPoints.size(), pool) == 1000);
+    assert(wideParallel.nodeCount() == wideSerial.nodeCount() && wideParallel.count(slice) == bruteCount(slice));
+
+    // Lazy leaves fill past the capacity until queries make them split
+    QuadTree lazy(boundary);
+    lazy.setLazySplit(true);
+    for (int i = 0; i < 1000; i++) {
+        lazy.insert(bulkPoints[i]);
+    }
+    std::size_t flatNodes = lazy.nodeCount();
+    assert(flatNodes < incremental.nodeCount() && lazy.overflowCount() > 0);
+    assert(lazy.refine() == 0 && lazy.count(slice) == bruteCount(slice));
+    for (int i = 0; i < 4; i++) {
+        assert(lazy.query(slice).size() == bruteCount(slice));
+    }
+    assert(lazy.refine() > 0 && lazy.nodeCount() > flatNodes && lazy.query(slice).size() == bruteCount(slice));
+    lazy.setLazySplit(false);
+    assert(lazy.overflowCount() == 0 && lazy.nodeCount() == incremental.nodeCount());
+
+    // Leaves a queried split reinserts into still get heat slots
+    QuadTree heated(boundary);
+    heated.setLazySplit(true);
+    for (int i = 0; i < 200; i++) {
+        heated.insert(bulkPoints[i]);
+    }
+    for (int i = 0; i < 5; i++) {
+        heated.query(slice);
+    }
+    heated.insert(bulkPoints[200]);
+    for (int i = 0; i < 30; i++) {
+        heated.insert(QuadPoint(99.5f + (i % 6) * 0.05f, 99.5f + (i / 6) * 0.05f));
+    }
+    Rectangle heatedRange(99.6f, 99.6f, 0.3f, 0.3f);
+    std::size_t heatedCount = 0;
+    for (const QuadPoint& point : heated.getAllPoints()) {
+        heatedCount += heatedRange.contains(point) ? 1 : 0;
+    }
+    assert(heated.size() == 231 && heated.query(heatedRange).size() == heatedCount);
+    assert(heated.query(slice).size() == heated.count(slice));
+
+    // Auto-tune: large leaves for inserts alone, smaller as queries dominate
+    QuadTree tuned(boundary);
+    tuned.setAutoTune(true);
+    std::uniform_real_distribution<float> tuneDist(0, 100);
+    for (int i = 0; i < 5000; i++) {
+        tuned.insert(QuadPoint(tuneDist(buildGen), tuneDist(buildGen)));
+    }
+    assert(tuned.getCapacity() == 256 && tuned.size() == 5000);
+    for (int i = 0; i < 5000; i++) {
+        for (int q = 0; q < 9; q++) {
+            tuned.count(slice);
+            tuned.query(Rectangle(static_cast<float>(q * 10), 50, 2, 2), [](const QuadPoint&) { return false; });
+        }
+        tuned.insert(QuadPoint(tuneDist(buildGen), tuneDist(buildGen)));
+    }
+    assert(tuned.getCapacity() == 64 && tuned.size() == 10000 && tuned.contains(0) && tuned.contains(9999));
+    std::cout << "✓ Leaf capacity and split policy test passed" << std::endl;
+
+    // Test that batches build the same tree as inserting point by point,
+    // including leaves the batch overflows and leaves at the depth limit
+    QuadTree batched(boundary, 3);
+    QuadTree single(boundary, 3);
+    for (QuadTree* tree : {&batched, &single}) {
+        tree->insert(QuadPoint(1, 1));
+    }
+    std::vector<QuadPoint> stream(bulkPoints.begin(), bulkPoints.begin() + 1000);
+    stream.insert(stream.end(), 40, QuadPoint(1, 1));
+    stream.emplace_back(150, 150);  // outside the boundary, skipped
+    for (const QuadPoint& p : stream) {
+        single.insert(p);
+    }
+    assert(batched.insertBatch(stream.data(), 7) == 7 && batched.insertBatch(nullptr, 0) == 0);
+    assert(batched.insertBatch(stream.data() + 7, 500) == 500);
+    assert(batched.insertBatch(stream.data() + 507, stream.size() - 507) == stream.size() - 508);
+    assert(batched.size() == 1041 && batched.nodeCount() == single.nodeCount());
+    assert(batched.overflowCount() == single.overflowCount() && batched.overflowCount() > 0);
+    for (QuadTree::Id id = 0; id < 1041; id++) {
+        assert(batched.position(id) == single.position(id));
+    }
+    assert(batched.count(slice) == single.count(slice) && batched.query(leaf).size() == single.count(leaf));
+#ifdef QUADTREE_STATS
+    assert(batched.stats().leavesByOccupancy == single.stats().leavesByOccupancy);
+    assert(batched.stats().nodesByDepth == single.stats().nodesByDepth);
+#endif
+    QuadTree expanding(boundary);
+    expanding.setAutoExpand(true);
+    assert(expanding.insertBatch({QuadPoint(5, 5), QuadPoint(-50, 250), QuadPoint(99, 0)}) == 3);
+    assert(expanding.getBoundary().contains(QuadPoint(-50, 250)) && expanding.position(1).x == -50);
+    LinearQuadTree linearBatched(boundary);
+    linearBatched.insert(bulkPoints[0]);
+    assert(linearBatched.insertBatch(bulkPoints.data() + 1, 600) == 600);
+    assert(linearBatched.insertBatch(bulkPoints.data() + 601, 400) == 399);
+    assert(linearBatched.nodeCount() == linear.nodeCount() && linearBatched.getAllPoints() == linear.getAllPoints());
+    std::cout << "✓ Batch insert test passed" << std::endl;
+
+    // Test that quantized storage keeps the same cells and reads points
+    // back to within a grid cell, for half the memory
+    LinearQuadTree quantized(boundary, LinearQuadTree::DEFAULT_MAX_DEPTH, LinearQuadTree::STORAGE_QUANTIZED);
+    LinearQuadTree quantizedBulk(boundary, LinearQuadTree::DEFAULT_MAX_DEPTH, LinearQuadTree::STORAGE_QUANTIZED);
+    quantized.insert(bulkPoints[0]);
+    assert(quantized.insertBatch(bulkPoints.data() + 1, 500) == 500);
+    for (int i = 501; i < 1000; i++) {
+        assert(quantized.insert(bulkPoints[i]));
+    }
+    assert(!quantized.insert(bulkPoints[1000]) && quantizedBulk.build(bulkPoints) == 1000);
+    assert(quantized.getStorage() == LinearQuadTree::STORAGE_QUANTIZED && quantized.size() == 1000);
+    assert(quantized.nodeCount() == linear.nodeCount() && quantizedBulk.nodeCount() == linear.nodeCount());
+    auto sameCell = [](const Rectangle& a, const Rectangle& b) {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    };
+    std::vector<Rectangle> quantizedCells = quantized.getBoundaries();
+    assert(std::equal(quantizedCells.begin(), quantizedCells.end(), linearCells.begin(), sameCell));
+    std::vector<QuadPoint> exact = linear.getAllPoints();
+    std::vector<QuadPoint> readBack = quantized.getAllPoints();
+    const float gridStep = 100.0f / 4294967296.0f;
+    for (size_t i = 0; i < exact.size(); i++) {
+        assert(std::fabs(readBack[i].x - exact[i].x) <= gridStep);
+        assert(std::fabs(readBack[i].y - exact[i].y) <= gridStep);
+        assert(exact[i].x < 0.5f || exact[i].y < 0.5f || readBack[i] == exact[i]);
+        assert(sameCell(quantized.leafBoundary(readBack[i]), linear.leafBoundary(exact[i])));
+    }
+    for (const Rectangle& range : {Rectangle(10, 20, 30, 40), Rectangle(0, 0, 50, 50), slice, leaf}) {
+        assert(quantized.count(range) == linear.count(range) && quantizedBulk.count(range) == linear.count(range));
+        assert(quantized.query(range).size() == linear.count(range));
+    }
+    assert(detail(quantized, region, 5.0f) == detail(linear, region, 5.0f));
+    assert(linearBulk.memoryUsage() - quantizedBulk.memoryUsage() == 1000 * 2 * sizeof(float));
+    // Near the origin floats are finer than the grid, so a point on a range
+    // edge can read back just outside it. Queries decide on the points as
+    // they read back, and float storage on the points as inserted.
+    std::vector<QuadPoint> nearOrigin;
+    std::uniform_real_distribution<float> nearDist(0.0f, 0.01f);
+    for (int i = 0; i < 200; i++) {
+        nearOrigin.emplace_back(nearDist(buildGen), nearDist(buildGen));
+    }
+    LinearQuadTree nearFloat(boundary);
+    LinearQuadTree nearQuantized(boundary, LinearQuadTree::DEFAULT_MAX_DEPTH, LinearQuadTree::STORAGE_QUANTIZED);
+    assert(nearFloat.build(nearOrigin) == 200 && nearQuantized.build(nearOrigin) == 200);
+    std::vector<QuadPoint> nearExact = nearFloat.getAllPoints();
+    std::vector<QuadPoint> nearReadBack = nearQuantized.getAllPoints();
+    auto inside = [](const std::vector<QuadPoint>& points, const Rectangle& range) {
+        return static_cast<std::size_t>(std::count_if(points.begin(), points.end(), [&range](const QuadPoint& p) {
+            return range.contains(p);
+        }));
+    };
+    std::size_t edgeDifferences = 0;
+    for (int i = 0; i + 1 < 200; i += 2) {
+        // Edges on inserted points, and on the points as they read back
+        for (const std::vector<QuadPoint>* edges : {&nearExact, &nearReadBack}) {
+            const QuadPoint& low = (*edges)[i];
+            const QuadPoint& high = (*edges)[i + 1];
+            Rectangle range(std::min(low.x, high.x), std::min(low.y, high.y), std::fabs(high.x - low.x),
+                            std::fabs(high.y - low.y));
+            std::size_t expected = inside(nearExact, range);
+            std::size_t readBackExpected = inside(nearReadBack, range);
+            assert(nearFloat.query(range).size() == expected && nearFloat.count(range) == expected);
+            assert(nearQuantized.query(range).size() == readBackExpected);
+            assert(nearQuantized.count(range) == readBackExpected);
+            edgeDifferences += expected != readBackExpected ? 1 : 0;
+        }
+    }
+    assert(edgeDifferences > 0);
+    std::cout << "✓ Quantized storage test passed" << std::endl;
+
+    // Test stable ids: duplicates at one position stay distinguishable
+    QuadTree tagged(boundary);
+    assert(tagged.insert(QuadPoint(5, 5), 7));
+    assert(tagged.insert(QuadPoint(5, 5), 3));
+    assert(!tagged.insert(QuadPoint(6, 6), 7));
+    for (QuadTree::Id id = 10; id < 60; id++) {
+        assert(tagged.insert(QuadPoint(static_cast<float>(id), 50), id));
+    }
+    std::vector<QuadTree::Id> taggedIds = tagged.queryIds(Rectangle(0, 0, 10, 10));
+    std::sort(taggedIds.begin(), taggedIds.end());
+    assert(taggedIds.size() == 2 && taggedIds[0] == 3 && taggedIds[1] == 7);
+    assert(tagged.update(3, QuadPoint(80, 80)));
+    assert(tagged.position(3).x == 80 && tagged.position(7).x == 5);
+    assert(tagged.nearestIds(QuadPoint(79, 79), 1)[0] == 3);
+    assert(tagged.remove(7) && !tagged.contains(7) && !tagged.remove(7));
+    for (QuadTree::Id id = 10; id < 60; id++) {
+        assert(tagged.update(id, QuadPoint(static_cast<float>(id), 90)));
+        assert(tagged.position(id).y == 90);
+    }
+    assert(tagged.size() == 51 && tagged.count(Rectangle(0, 85, 100, 10)) == 50);
+    assert(!tagged.insert(QuadPoint(5, 5), 0xFFFFFFFEu) && tagged.size() == 51);
+    assert(tagged.insert(QuadPoint(5, 5), QuadTree::ID_HEADROOM) && tagged.remove(QuadTree::ID_HEADROOM));
+    std::vector<QuadTree::Id> bulkIds = bulk.queryIds(Rectangle(10, 20, 30, 40));
+    for (QuadTree::Id id : bulkIds) {
+        assert(Rectangle(10, 20, 30, 40).contains(bulkPoints[id]));
+        assert(bulk.position(id).x == bulkPoints[id].x);
+    }
+    assert(parallel.position(bulkIds[0]).y == bulkPoints[bulkIds[0]].y);
+    std::cout << "✓ Stable id test passed" << std::endl;
+
+    // Test that a saved snapshot serves the same answers from the mapping
+    const char* snapshotPath = "test_quadtree.qts";
+    assert(tagged.save(snapshotPath));
+    MappedQuadTree mapped;
+    assert(mapped.open(snapshotPath) && mapped.verify());
+    assert(mapped.size() == tagged.size() && mapped.nodeCount() == tagged.nodeCount());
+    assert(mapped.getBoundaries().size() == tagged.getBoundaries().size());
+    assert(mapped.count(Rectangle(0, 85, 100, 10)) == 50);
+    std::vector<QuadTree::Id> mappedIds = mapped.queryIds(Rectangle(70, 70, 20, 20));
+    assert(mappedIds.size() == 1 && mappedIds[0] == 3);
+    assert(bulk.save(snapshotPath) && mapped.open(snapshotPath) && mapped.verify());
+    for (const Rectangle& range : batch) {
+        assert(mapped.query(range).size() == bulk.count(range) && mapped.count(range) == bulk.count(range));
+    }
+    assert(mapped.getAllPoints().size() == 1000);
+    mapped.close();
+    {
+        // A truncated file is refused rather than read past its end
+        std::ofstream truncated(snapshotPath, std::ios::binary | std::ios::trunc);
+        truncated << "QTSNAP";
+    }
+    MappedQuadTree broken;
+    assert(!broken.open(snapshotPath) && !broken.isOpen() && broken.count(boundary) == 0);
+    {
+        // A lone root claiming children is refused by verify() without
+        // reading past the node array
+        QuadTree lone(boundary);
+        lone.insert(QuadPoint(1, 1));
+        assert(lone.save(snapshotPath));
+        std::fstream corrupt(snapshotPath, std::ios::binary | std::ios::in | std::ios::out);
+        QuadTreeSnapshot::Header header;
+        corrupt.read(reinterpret_cast<char*>(&header), sizeof(header));
+        assert(header.nodeCount == 1);
+        QuadTreeSnapshot::Node root;
+        corrupt.seekg(static_cast<std::streamoff>(header.nodesOffset));
+        corrupt.read(reinterpret_cast<char*>(&root), sizeof(root));
+        root.firstChild = 1;
+        corrupt.seekp(static_cast<std::streamoff>(header.nodesOffset));
+        corrupt.write(reinterpret_cast<const char*>(&root), sizeof(root));
+    }
+    assert(broken.open(snapshotPath) && !broken.verify());
+    broken.close();
+    {
+        // Two nodes sharing a block, with totals that still add up, are
+        // refused too: the block would sit at two depths and its points
+        // would be returned twice
+        QuadTree twins(boundary);
+        for (float dx : {0.0f, 50.0f}) {
+            for (const QuadPoint& p : {QuadPoint(10, 10), QuadPoint(30, 10), QuadPoint(10, 30), QuadPoint(30, 30),
+                                       QuadPoint(12, 12)}) {
+                twins.insert(QuadPoint(p.x + dx, p.y));
+            }
+        }
+        assert(twins.save(snapshotPath) && mapped.open(snapshotPath) && mapped.verify());
+        mapped.close();
+        std::fstream corrupt(snapshotPath, std::ios::binary | std::ios::in | std::ios::out);
+        QuadTreeSnapshot::Header header;
+        corrupt.read(reinterpret_cast<char*>(&header), sizeof(header));
+        assert(header.nodeCount == 13);
+        QuadTreeSnapshot::Node northEast;
+        std::streamoff offset = static_cast<std::streamoff>(header.nodesOffset + 2 * sizeof(northEast));
+        corrupt.seekg(offset);
+        corrupt.read(reinterpret_cast<char*>(&northEast), sizeof(northEast));
+        assert(northEast.firstChild == 9);
+        northEast.firstChild = 5;
+        corrupt.seekp(offset);
+        corrupt.write(reinterpret_cast<const char*>(&northEast), sizeof(northEast));
+    }
+    assert(broken.open(snapshotPath) && !broken.verify());
+    broken.close();
+    std::remove(snapshotPath);
+    std::cout << "✓ Snapshot test passed" << std::endl;
+
+    // Test that duplicate points overflow at the depth limit instead of
+    // subdividing without end
+    QuadTree clustered(boundary, 6);
+    std::vector<QuadPoint> cluster(100, QuadPoint(33.3f, 66.6f));
+    for (const QuadPoint& p : cluster) {
+        assert(clustered.insert(p));
+    }
+    assert(clustered.size() == 100 && clustered.nodeCount() <= 1 + 4 * 6);
+    assert(clustered.overflowCount() == 1);
+    assert(clustered.count(Rectangle(33, 66, 1, 1)) == 100);
+    assert(clustered.query(Rectangle(33, 66, 1, 1)).size() == 100);
+    assert(clustered.nearest(QuadPoint(0, 0), 3).size() == 3);
+    LinearQuadTree linearCluster(boundary, 6);
+    assert(linearCluster.build(cluster) == 100 && linearCluster.nodeCount() == clustered.nodeCount());
+    assert(linearCluster.count(Rectangle(33, 66, 1, 1)) == 100);
+    // Away from the origin, halving stops moving the split line before
+    // level 32; both trees stop splitting there and keep the same cells
+    Rectangle offset(1000, 1000, 100, 100);
+    std::vector<QuadPoint> offsetCluster(100, QuadPoint(1033.3f, 1066.6f));
+    QuadTree deepCluster(offset, 32);
+    LinearQuadTree linearDeep(offset, 32);
+    assert(deepCluster.build(offsetCluster) == 100 && linearDeep.build(offsetCluster) == 100);
+    std::vector<Rectangle> deepCells = deepCluster.getBoundaries();
+    std::vector<Rectangle> linearDeepCells = linearDeep.getBoundaries();
+    assert(deepCells.size() == linearDeepCells.size() && linearDeep.nodeCount() == deepCluster.nodeCount());
+    for (std::size_t i = 0; i < deepCells.size(); i++) {
+        assert(linearDeepCells[i].x == deepCells[i].x && linearDeepCells[i].y == deepCells[i].y);
+        assert(linearDeepCells[i].width == deepCells[i].width && linearDeepCells[i].width > 0);
+    }
+    Rectangle deepLeaf = linearDeep.leafBoundary(offsetCluster[0]);
+    assert(!(deepLeaf.x + deepLeaf.width / 2.0f > deepLeaf.x) || !(deepLeaf.y + deepLeaf.height / 2.0f > deepLeaf.y));
+    assert(linearDeep.count(Rectangle(1033, 1066, 1, 1)) == 100 && linearDeep.query(offset).size() == 100);
+    QuadTree clusteredBulk(boundary, 6);
+    assert(clusteredBulk.build(cluster) == 100);
+    assert(clusteredBulk.nodeCount() == clustered.nodeCount() && clusteredBulk.overflowCount() == 1);
+    assert(clusteredBulk.build(cluster.data(), cluster.size(), pool) == 100);
+    assert(clusteredBulk.overflowCount() == 1 && clusteredBulk.count(boundary) == 100);
+    for (QuadTree::Id id = 0; id < 98; id++) {
+        assert(clustered.remove(id));
+    }
+    assert(clustered.overflowCount() == 0 && clustered.position(99).x == 33.3f);
+    QuadTree coarse(boundary, QuadTree::DEFAULT_MAX_DEPTH, 10.0f);
+    for (const QuadPoint& p : bulkPoints) {
+        coarse.insert(p);
+    }
+    for (const Rectangle& cell : coarse.getBoundaries()) {
+        assert(cell.width >= 10.0f);
+    }
+    assert(coarse.count(boundary) == 1000 && coarse.overflowCount() > 0);
+    std::cout << "✓ Depth limit and overflow test passed" << std::endl;
+
+    // Test streaming ingestion with a chunk far smaller than the file, so
+    // lines and float pairs straddle chunk boundaries
+    const char* csvPath = "test_quadtree.csv";
+    const char* binPath = "test_quadtree.bin";
+    {
+        std::ofstream csv(csvPath, std::ios::binary);
+        csv << "x,y\r\n10,10\r\n 20.5 , 30.25,extra\n\nbad,1\n";
+        csv << std::string(100, '7') << ",1\n";
+        for (int i = 0; i < 40; i++) {
+            csv << i * 2.5f << ";" << 99 - i << "\n";
+        }
+        csv << "150,150\n-1e1,5";
+        std::ofstream bin(binPath, std::ios::binary);
+        bin.write(reinterpret_cast<const char*>(bulkPoints.data()), bulkPoints.size() * sizeof(QuadPoint));
+    }
+    assert(PointLoader::detect(binPath) == PointLoader::Format::Binary);
+    assert(PointLoader::detect(csvPath) == PointLoader::Format::CSV);
+    PointLoader loader(64);
+    std::vector<QuadPoint> streamed;
+    assert(loader.load(csvPath, PointLoader::Format::Auto, [&streamed](const QuadPoint* points, size_t n) {
+        streamed.insert(streamed.end(), points, points + n);
+    }));
+    assert(loader.stats().points == 44 && loader.stats().malformed == 3);
+    assert(streamed[1].x == 20.5f && streamed[1].y == 30.25f && streamed[41].x == 97.5f);
+    assert(streamed[42].x == 150 && streamed[43].x == -10 && streamed[43].y == 5);
+    QuadTree ingested(boundary);
+    assert(loader.load(csvPath, PointLoader::Format::CSV, ingested));
+    assert(loader.stats().inserted == 42 && ingested.size() == 42);
+    QuadTree ingestedBin(boundary);
+    assert(loader.load(binPath, PointLoader::Format::Auto, ingestedBin));
+    assert(loader.stats().bytes == bulkPoints.size() * sizeof(QuadPoint));
+    assert(ingestedBin.size() == 1000 && ingestedBin.count(batch[0]) == bulk.count(batch[0]));
+    assert(!loader.load("missing.csv", PointLoader::Format::CSV, ingested));
+    // A directory opens but cannot be read, which is not an empty file
+    assert(!loader.load(".", PointLoader::Format::CSV, ingested));
+    // A throwing sink stops the reader, which is then waiting for buffers
+    bool thrown = false;
+    try {
+        loader.load(csvPath, PointLoader::Format::CSV, [](const QuadPoint*, size_t) {
+            throw std::runtime_error("sink failed");
+        });
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown && loader.load(csvPath, PointLoader::Format::CSV, ingested));
+    std::remove(csvPath);
+    std::remove(binPath);
+    std::cout << "✓ Streaming loader test passed" << std::endl;
+
+    // Test that the copy-on-write tree matches QuadTree, and that readers
+    // see whole versions while a writer inserts and removes
+    ConcurrentQuadTree concurrent(boundary);
+    for (size_t i = 0; i < 1000; i += 100) {
+        assert(concurrent.insert(bulkPoints.data() + i, 100) == 100);
+    }
+    assert(!concurrent.insert(QuadPoint(150, 150)) && concurrent.size() == 1000);
+    assert(concurrent.snapshot().getBoundaries().size() == incremental.getBoundaries().size());
+    for (const Rectangle& range : batch) {
+        assert(concurrent.count(range) == bulk.count(range) && concurrent.query(range).size() == bulk.count(range));
+    }
+    {
+        // A snapshot keeps its version, and the nodes it reaches, alive
+        ConcurrentQuadTree::Snapshot before = concurrent.snapshot();
+        for (size_t i = 0; i < 500; i++) {
+            assert(concurrent.remove(bulkPoints[i]));
+        }
+        assert(!concurrent.remove(bulkPoints[0]));
+        assert(before.size() == 1000 && before.query(boundary).size() == 1000);
+        assert(concurrent.size() == 500 && concurrent.retiredCount() > 0);
+    }
+    concurrent.reclaim();
+    assert(concurrent.retiredCount() == 0);
+
+    std::atomic<bool> churning(true);
+    std::atomic<int> torn(0);
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 3; r++) {
+        readers.emplace_back([&concurrent, &churning, &torn, &boundary]() {
+            uint64_t seen = 0;
+            while (churning.load()) {
+                ConcurrentQuadTree::Snapshot view = concurrent.snapshot();
+                size_t n = view.size();
+                if (view.version() < seen || view.count(boundary) != n || view.query(boundary).size() != n) {
+                    torn++;
+                }
+                seen = view.version();
+            }
+        });
+    }
+    for (int round = 0; round < 2000; round++) {
+        const QuadPoint* chunk = bulkPoints.data() + (round % 100) * 5;
+        concurrent.insert(chunk, 5);
+        for (int i = 0; i < 5; i++) {
+            assert(concurrent.remove(chunk[i]));
+        }
+    }
+    {
+        // More snapshots than epoch slots still hold their versions
+        std::vector<ConcurrentQuadTree::Snapshot> pinned;
+        pinned.reserve(ConcurrentQuadTree::MAX_READERS + 8);
+        for (int i = 0; i < ConcurrentQuadTree::MAX_READERS + 8; i++) {
+            pinned.push_back(concurrent.snapshot());
+        }
+        concurrent.clear();
+        assert(pinned.back().size() == 500 && concurrent.size() == 0);
+    }
+    churning = false;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    concurrent.reclaim();
+    assert(torn.load() == 0 && concurrent.retiredCount() == 0);
+    std::cout << "✓ Concurrent quadtree test passed" << std::endl;
+
+    // Test that the loose tree answers box overlap and point queries like a
+    // brute-force scan, at both looseness settings
+    std::mt19937 boxGen(21);
+    std::uniform_real_distribution<float> boxPos(0, 95);
+    std::uniform_real_distribution<float> boxSize(0.1f, 5);
+    std::vector<Rectangle> boxes;
+    for (int i = 0; i < 500; i++) {
+        boxes.emplace_back(boxPos(boxGen), boxPos(boxGen), boxSize(boxGen), boxSize(boxGen));
+    }
+    boxes.emplace_back(49, 49, 2, 2);  // straddles the root's split lines
+    auto overlapping = [&boxes](const Rectangle& range, const std::vector<bool>& live) {
+        std::vector<LooseQuadTree::Id> ids;
+        for (LooseQuadTree::Id id = 0; id < boxes.size(); id++) {
+            if (live[id] && (range.intersects(boxes[id]) || range.contains(boxes[id]))) {
+                ids.push_back(id);
+            }
+        }
+        return ids;
+    };
+    for (float looseness : {1.0f, 2.0f}) {
+        LooseQuadTree regions(boundary, looseness);
+        std::vector<bool> live(boxes.size(), true);
+        for (const Rectangle& box : boxes) {
+            assert(regions.insert(box));
+        }
+        assert(!regions.insert(Rectangle(-80, 10, 5, 5)) && regions.size() == boxes.size());
+        assert(regions.nodeCount() > 1);
+        for (int i = 0; i < 250; i += 2) {
+            assert(regions.remove(i));
+            live[i] = false;
+        }
+        for (int i = 1; i < 100; i += 2) {
+            boxes[i].x = 95 - boxes[i].x;
+            assert(regions.update(i, boxes[i]) && regions.getBox(i).x == boxes[i].x);
+        }
+        assert(!regions.remove(0) && regions.size() == boxes.size() - 125);
+        for (const Rectangle& range : batch) {
+            std::vector<LooseQuadTree::Id> ids = regions.query(range);
+            std::sort(ids.begin(), ids.end());
+            assert(ids == overlapping(range, live) && regions.count(range) == ids.size());
+        }
+        for (float p = 0.5f; p < 100; p += 7.3f) {
+            QuadPoint point(p, 100 - p);
+            std::vector<LooseQuadTree::Id> ids = regions.queryPoint(point);
+            size_t expected = 0;
+            for (LooseQuadTree::Id id = 0; id < boxes.size(); id++) {
+                expected += live[id] && boxes[id].contains(point) ? 1 : 0;
+            }
+            assert(ids.size() == expected);
+        }
+        for (LooseQuadTree::Id id = 0; id < boxes.size(); id++) {
+            regions.remove(id);
+        }
+        assert(regions.size() == 0 && regions.nodeCount() == 1);
+        assert(!regions.insert(boxes[0], 0xFFFFFFFEu) && regions.size() == 0);
+    }
+    std::cout << "✓ Loose quadtree test passed" << std::endl;
+
+    // Test that the stats kept up to date through inserts, builds and
+    // merge-backs agree with a count taken from the tree itself
+    {
+        QuadTree watched(boundary);
+        for (size_t i = 0; i < 1000; i++) {
+            watched.insert(bulkPoints[i]);
+        }
+        for (QuadTree::Id id = 0; id < 1000; id += 3) {
+            watched.remove(id);
+        }
+        QuadTreeStats stats = watched.stats();
+        assert(stats.points == watched.size() && stats.nodes == watched.nodeCount());
+#ifdef QUADTREE_STATS
+        std::vector<size_t> depths;
+        for (const Rectangle& cell : watched.getBoundaries()) {
+            size_t depth = static_cast<size_t>(std::lround(std::log2(100.0f / cell.width)));
+            depths.resize(std::max(depths.size(), depth + 1), 0);
+            depths[depth]++;
+        }
+        assert(stats.enabled && stats.nodesByDepth == depths);
+        assert(stats.leaves * 4 == stats.nodes * 3 + 1);
+        size_t stored = 0;
+        for (size_t k = 0; k < stats.leavesByOccupancy.size(); k++) {
+            stored += k * stats.leavesByOccupancy[k];
+        }
+        assert(stored == stats.points && stats.leavesByOccupancy.back() == 0);
+        assert(stats.insertLatency.count() == 1000);
+
+        QuadTree inserted(boundary), built(boundary), builtParallel(boundary);
+        for (size_t i = 0; i < 1000; i++) {
+            inserted.insert(bulkPoints[i]);
+        }
+        built.build(bulkPoints);
+        builtParallel.build(bulkPoints.data(), bulkPoints.size(), pool);
+        for (const QuadTree* other : {&built, &builtParallel}) {
+            assert(other->stats().nodesByDepth == inserted.stats().nodesByDepth);
+            assert(other->stats().leavesByOccupancy == inserted.stats().leavesByOccupancy);
+        }
+
+        watched.resetStats();
+        std::vector<QuadPoint> found = watched.query(Rectangle(10, 20, 30, 40));
+        stats = watched.stats();
+        assert(stats.queries == 1 && stats.pointsReturned == found.size());
+        assert(stats.nodesVisited > 0 && stats.queryLatency.count() == 1);
+        assert(stats.insertLatency.count() == 0);
+        for (uint64_t ns : {0ull, 31ull, 32ull, 1000ull, 123456789ull}) {
+            int bucket = LatencyHistogram::bucketFor(ns);
+            assert(LatencyHistogram::bucketLow(bucket) <= ns && ns <= LatencyHistogram::bucketHigh(bucket));
+        }
+#else
+        assert(!stats.enabled && stats.nodesByDepth.empty());
+#endif
+    }
+    std::cout << "✓ Stats test passed" << std::endl;
+
+    // Test that a triple buffer reader only ever moves forward and ends on
+    // the last value published, while the writer never waits for it
+    {
+        TripleBuffer<std::vector<int>> buffer;
+        assert(!buffer.update() && buffer.read().empty());
+        const int rounds = 100000;
+        std::thread writer([&buffer]() {
+            for (int i = 1; i <= rounds; i++) {
+                std::vector<int>& slot = buffer.write();
+                slot.assign(4, i);
+                buffer.publish();
+            }
+        });
+        int seen = 0;
+        while (seen < rounds) {
+            if (buffer.update()) {
+                const std::vector<int>& value = buffer.read();
+                assert(value.size() == 4 && value[0] == value[3] && value[0] > seen);
+                seen = value[0];
+            }
+        }
+        writer.join();
+        assert(!buffer.update() && buffer.read()[0] == rounds);
+    }
+    std::cout << "✓ Triple buffer test passed" << std::endl;
+
     // Test clear functionality
     tree.clear();
     assert(tree.getAllPoints().size() == 0);
     std::cout << "✓ Clear test passed" << std::endl;
     
+    // Test that every SIMD range filter matches the scalar one, including
+    // points sitting exactly on the range edges
+    std::mt19937 gen(7);
+    std::uniform_int_distribution<int> coord(0, 20);
+    std::vector<float> xs, ys;
+    for (int i = 0; i < 203; i++) {
+        xs.push_back(static_cast<float>(coord(gen)));
+        ys.push_back(static_cast<float>(coord(gen)));
+    }
+    Rectangle filterRange(5, 5, 10, 10);
+    std::vector<uint32_t> expected(xs.size()), actual(xs.size());
+    uint32_t expectedCount = RangeFilter::scalar(xs.data(), ys.data(), xs.size(), filterRange, expected.data());
+    for (RangeFilter::Kernel kernel : {RangeFilter::Kernel::SSE, RangeFilter::Kernel::AVX2}) {
+        if (!RangeFilter::supported(kernel)) continue;
+        uint32_t found = RangeFilter::get(kernel)(xs.data(), ys.data(), xs.size(), filterRange, actual.data());
+        assert(found == expectedCount);
+        assert(std::equal(expected.begin(), expected.begin() + found, actual.begin()));
+    }
+    std::cout << "✓ Range filter test passed (" << RangeFilter::name(RangeFilter::active()) << ")" << std::endl;
+    
     std::cout << "\n🎉 All QuadTree tests passed!" << std::endl;
     std::cout << "The QuadTree implementation is working correctly." << std::endl;
     